@@ -12,22 +12,13 @@
 
 #include "constants/constants.h"
 #include "packet_node.h"
+#include "version_cache.h"
 
 int main() {
-    FILE *fp = fopen( "/home/mitchell/Documents/mc_dbg/proto/packets/1.21.4.proto", "r" );
-
-    fseek( fp, 0, SEEK_END );
-    size_t len = ftell( fp );
-    fseek( fp, 0, SEEK_SET );
-
-    char *buffer = malloc( len + 1 );
-    fread( buffer, len, 1, fp );
-    buffer[len] = '\0';
-    fclose( fp );
-
-    // printf("%s\n", buffer);
-
-    create_version_serde( buffer );
+    VersionSerde *version = load_version_serde_cached( "/home/mitchell/Documents/mc_dbg/proto/packets/1.21.4.proto",
+                                                       "/home/mitchell/Documents/mc_dbg/proto/packets/1.21.4.proto.cache" );
+    if ( !version )
+        exit_on_error();
 
 
     //    printf(": %llu\n", *OBJ_version_info);
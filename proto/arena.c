@@ -0,0 +1,44 @@
+#include "arena.h"
+
+static struct ArenaChunk *new_chunk(size_t alloc) {
+    struct ArenaChunk *chunk = malloc(sizeof(struct ArenaChunk) + alloc);
+    chunk->next = NULL;
+    chunk->alloc = alloc;
+    chunk->used = 0;
+    return chunk;
+}
+
+struct Arena *arena_create(size_t chunk_size) {
+    struct Arena *arena = malloc(sizeof(struct Arena));
+    arena->chunk_size = chunk_size ? chunk_size : DEFAULT_ARENA_CHUNK_SIZE;
+    arena->first = new_chunk(arena->chunk_size);
+    arena->current = arena->first;
+    return arena;
+}
+
+void arena_free(struct Arena *arena) {
+    struct ArenaChunk *chunk = arena->first;
+    while (chunk) {
+        struct ArenaChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(arena);
+}
+
+// Size is already rounded up by arena_alloc
+void *_arena_alloc_slow(struct Arena *arena, size_t size) {
+    struct ArenaChunk *current = arena->current;
+
+    // Chunks left over from before a reset get reused first. Their used
+    // counter is stale, as resetting only touches the first chunk.
+    struct ArenaChunk *next = current->next;
+    if (!next || next->alloc < size) {
+        next = new_chunk(size > arena->chunk_size ? size : arena->chunk_size);
+        next->next = current->next;
+        current->next = next;
+    }
+    next->used = size;
+    arena->current = next;
+    return next->data;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+  Bump allocator, for things that all die at the same time. Like every node of
+  a decoded packet. Nothing allocated from an arena is freed on its own, the
+  whole arena is reset (or freed) in one go instead.
+
+  Resetting keeps every chunk around, so an arena reused across packets stops
+  touching malloc once it has grown to fit the largest of them.
+*/
+
+#define DEFAULT_ARENA_CHUNK_SIZE (64 * 1024)
+
+struct ArenaChunk {
+    struct ArenaChunk *next;
+    size_t alloc;
+    size_t used;
+    char data[];
+};
+
+struct Arena {
+    struct ArenaChunk *first;
+    struct ArenaChunk *current;
+    size_t chunk_size;
+};
+
+// chunk_size of 0 means DEFAULT_ARENA_CHUNK_SIZE
+struct Arena *arena_create(size_t chunk_size);
+void arena_free(struct Arena *arena);
+
+void *_arena_alloc_slow(struct Arena *arena, size_t size);
+
+// Memory is NOT zeroed, and is aligned to 8 bytes
+static __always_inline void *arena_alloc(struct Arena *arena, size_t size) {
+    size = (size + 7) & ~(size_t) 7;
+    struct ArenaChunk *chunk = arena->current;
+    if (__builtin_expect(chunk->used + size <= chunk->alloc, 1)) {
+        void *ret = chunk->data + chunk->used;
+        chunk->used += size;
+        return ret;
+    }
+    return _arena_alloc_slow(arena, size);
+}
+
+// Invalidates everything allocated from the arena. O(1).
+static __always_inline void arena_reset(struct Arena *arena) {
+    arena->current = arena->first;
+    arena->first->used = 0;
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include <endian.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "arena.h"
+#include "datatypes.h"
+#include "error_handling.h"
+#include "framing.h"
+#include "packet_node.h"
+
+/*
+  What the code in generated_packets.h is built out of, not meant to be used
+  by hand. The macros expect the same locals as the generated decoders: p, the
+  position in the packet, and end, where the packet ends.
+*/
+
+// Fails with a truncated error on field NAME, unless NEEDED more bytes are left
+#define _GEN_NEED(NEEDED, NAME)                                                                                                            \
+    if (__builtin_expect((size_t) (end - p) < (size_t) (NEEDED), 0)) {                                                                     \
+        SET_DECODE_ERROR(DECODE_ERROR_TRUNCATED, NAME, p, 0, 0);                                                                           \
+        return -1;                                                                                                                         \
+    }
+
+#define _GEN_READ_VAR_STYLE(OUT, BITS, NAME)                                                                                               \
+    {                                                                                                                                      \
+        uint64_t _value;                                                                                                                   \
+        enum DecodeError _error = decode_var_style(&p, end, BITS, &_value);                                                                \
+        if (__builtin_expect(_error, 0)) {                                                                                                 \
+            SET_DECODE_ERROR(_error, NAME, p, 0, 0);                                                                                       \
+            return -1;                                                                                                                     \
+        }                                                                                                                                  \
+        OUT = _value;                                                                                                                      \
+    }
+
+// Same check the interpreter does for containers with a max length
+#define _GEN_CHECK_LENGTH(SIZE, MAX, NAME)                                                                                                 \
+    if (__builtin_expect((SIZE) > (MAX), 0)) {                                                                                             \
+        SET_DECODE_ERROR(DECODE_ERROR_TOO_LONG, NAME, p, MAX, SIZE);                                                                       \
+        return -1;                                                                                                                         \
+    }
+
+#define _GEN_CHECK_COUNT(COUNT, NAME)                                                                                                      \
+    if (__builtin_expect((COUNT) > MAX_DECODED_LIST_SIZE, 0)) {                                                                            \
+        SET_DECODE_ERROR(DECODE_ERROR_TOO_MANY_ELEMENTS, NAME, p, COUNT, MAX_DECODED_LIST_SIZE);                                           \
+        return -1;                                                                                                                         \
+    }
+
+// Big endian loads and stores. Stores return the end of what was written.
+static __always_inline uint8_t _gen_load8(const char *p) { return *(const uint8_t *) p; }
+static __always_inline uint16_t _gen_load16(const char *p) {
+    uint16_t raw;
+    memcpy(&raw, p, sizeof(raw));
+    return be16toh(raw);
+}
+static __always_inline uint32_t _gen_load32(const char *p) {
+    uint32_t raw;
+    memcpy(&raw, p, sizeof(raw));
+    return be32toh(raw);
+}
+static __always_inline uint64_t _gen_load64(const char *p) {
+    uint64_t raw;
+    memcpy(&raw, p, sizeof(raw));
+    return be64toh(raw);
+}
+static __always_inline struct MC_uuid _gen_load_uuid(const char *p) {
+    // Most significant half comes first
+    return (struct MC_uuid) {.uuid_high = _gen_load64(p), .uuid_low = _gen_load64(p + 8)};
+}
+
+static __always_inline char *_gen_store8(char *out, uint8_t value) {
+    *out = value;
+    return out + 1;
+}
+static __always_inline char *_gen_store16(char *out, uint16_t value) {
+    value = htobe16(value);
+    memcpy(out, &value, sizeof(value));
+    return out + sizeof(value);
+}
+static __always_inline char *_gen_store32(char *out, uint32_t value) {
+    value = htobe32(value);
+    memcpy(out, &value, sizeof(value));
+    return out + sizeof(value);
+}
+static __always_inline char *_gen_store64(char *out, uint64_t value) {
+    value = htobe64(value);
+    memcpy(out, &value, sizeof(value));
+    return out + sizeof(value);
+}
+static __always_inline char *_gen_store_uuid(char *out, struct MC_uuid value) {
+    return _gen_store64(_gen_store64(out, value.uuid_high), value.uuid_low);
+}
+
+static __always_inline char *_gen_store_bytes(char *out, struct PacketBufferView view) {
+    memcpy(out, view.data, view.size);
+    return out + view.size;
+}
+
+// Same error as serialize_packet gives for containers over their max length
+static __always_inline int _gen_check_encode_length(size_t size, long long max, const char *name) {
+    if (size > (size_t) max) {
+        SET_ERROR_STATE(ERROR_API_USAGE, "\"%s\" of max size %lld had size of %zu", name, max, size);
+        return -1;
+    }
+    return 0;
+}
+
+// Returns: non zero if the decoder stopped short of the end of the packet (and sets error state)
+static __always_inline int _gen_check_trailing(const char *buffer, const char *p, const char *end) {
+    if (p != end) {
+        SET_DECODE_ERROR(DECODE_ERROR_TRAILING_BYTES, NULL, p, end - p, 0);
+        set_decode_error_origin(buffer);
+        return -1;
+    }
+    return 0;
+}
+
+// Allocates a frame like serialize_packet does, and writes everything before the fields.
+// Returns: NULL if it does not fit in a frame (and sets error state), otherwise out is where the fields go
+static inline struct CombinedDataSegment *_gen_begin_frame(int id, const char *name, int64_t fields_size, char **out) {
+    if (fields_size < 0)
+        return NULL;
+    size_t body_size = varStyleSize(id) + fields_size;
+    if (body_size > MAX_FRAME_SIZE) {
+        SET_ERROR_STATE(ERROR_API_USAGE, "Packet \"%s\" does not fit in a frame: %zu", name, body_size);
+        return NULL;
+    }
+    size_t size = varStyleSize(body_size) + body_size;
+
+    // Slack at the end, so every varint can be a single wide store
+    struct CombinedDataSegment *combined = malloc(sizeof(struct CombinedDataSegment) + size + sizeof(uint64_t));
+    combined->size = size;
+    *out = putVarStyleWide(putVarStyleWide(combined->data, body_size), id);
+    return combined;
+}
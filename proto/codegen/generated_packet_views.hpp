@@ -0,0 +1,255 @@
+#pragma once
+ // DO NOT EDIT!!!
+ // This file is automatically generated by packet_gen.c from 1.21.4.proto, see README.md
+
+#include "packet_view.hpp"
+
+namespace packets {
+
+constexpr int protocol_number = 769;
+
+namespace handshake_c2s {
+
+struct handshake {
+    static constexpr int _id = 0x00;
+    static constexpr const char *_name = "handshake";
+
+    struct protocol_version : packet_view::Field<handshake, 0, packet_view::VarInt> {
+        static constexpr const char *_name = "protocol version";
+    };
+    struct server_address : packet_view::Field<handshake, 1, packet_view::PrefixedBytes<255>> {
+        static constexpr const char *_name = "server address";
+    };
+    struct port : packet_view::Field<handshake, 2, packet_view::Fixed<uint16_t>> {
+        static constexpr const char *_name = "port";
+    };
+    struct next_state : packet_view::Field<handshake, 3, packet_view::VarInt> {
+        static constexpr const char *_name = "next state";
+    };
+
+    using _fields = packet_view::FieldList<protocol_version, server_address, port, next_state>;
+};
+
+} // namespace handshake_c2s
+
+namespace status_s2c {
+
+struct status_response {
+    static constexpr int _id = 0x00;
+    static constexpr const char *_name = "status response";
+
+    struct json : packet_view::Field<status_response, 0, packet_view::PrefixedBytes<32767>> {
+        static constexpr const char *_name = "json";
+    };
+
+    using _fields = packet_view::FieldList<json>;
+};
+
+struct pong_response {
+    static constexpr int _id = 0x01;
+    static constexpr const char *_name = "pong response";
+
+    struct timestamp : packet_view::Field<pong_response, 0, packet_view::Fixed<int64_t>> {
+        static constexpr const char *_name = "timestamp";
+    };
+
+    using _fields = packet_view::FieldList<timestamp>;
+};
+
+} // namespace status_s2c
+
+namespace status_c2s {
+
+struct status_request {
+    static constexpr int _id = 0x00;
+    static constexpr const char *_name = "status request";
+
+    using _fields = packet_view::FieldList<>;
+};
+
+struct ping_request {
+    static constexpr int _id = 0x01;
+    static constexpr const char *_name = "ping request";
+
+    struct timestamp : packet_view::Field<ping_request, 0, packet_view::Fixed<int64_t>> {
+        static constexpr const char *_name = "timestamp";
+    };
+
+    using _fields = packet_view::FieldList<timestamp>;
+};
+
+} // namespace status_c2s
+
+namespace login_s2c {
+
+struct disconnect {
+    static constexpr int _id = 0x00;
+    static constexpr const char *_name = "disconnect";
+
+    struct reason : packet_view::Field<disconnect, 0, packet_view::PrefixedBytes<packet_view::NO_MAX_LENGTH>> {
+        static constexpr const char *_name = "reason";
+    };
+
+    using _fields = packet_view::FieldList<reason>;
+};
+
+struct encryption_request {
+    static constexpr int _id = 0x01;
+    static constexpr const char *_name = "encryption request";
+
+    struct server_id : packet_view::Field<encryption_request, 0, packet_view::PrefixedBytes<20>> {
+        static constexpr const char *_name = "server id";
+    };
+    struct public_key : packet_view::Field<encryption_request, 1, packet_view::PrefixedBytes<packet_view::NO_MAX_LENGTH>> {
+        static constexpr const char *_name = "public key";
+    };
+    struct verify_token : packet_view::Field<encryption_request, 2, packet_view::PrefixedBytes<packet_view::NO_MAX_LENGTH>> {
+        static constexpr const char *_name = "verify token";
+    };
+    struct should_authenticate : packet_view::Field<encryption_request, 3, packet_view::Fixed<bool>> {
+        static constexpr const char *_name = "should authenticate";
+    };
+
+    using _fields = packet_view::FieldList<server_id, public_key, verify_token, should_authenticate>;
+};
+
+struct login_success_properties {
+    struct name : packet_view::Field<login_success_properties, 0, packet_view::PrefixedBytes<64>> {
+        static constexpr const char *_name = "name";
+    };
+    struct value : packet_view::Field<login_success_properties, 1, packet_view::PrefixedBytes<packet_view::NO_MAX_LENGTH>> {
+        static constexpr const char *_name = "value";
+    };
+    struct signature : packet_view::Field<login_success_properties, 2, packet_view::Optional<packet_view::PrefixedBytes<packet_view::NO_MAX_LENGTH>>> {
+        static constexpr const char *_name = "signature";
+    };
+
+    using _fields = packet_view::FieldList<name, value, signature>;
+};
+
+struct login_success {
+    static constexpr int _id = 0x02;
+    static constexpr const char *_name = "login success";
+
+    struct uuid : packet_view::Field<login_success, 0, packet_view::Fixed<packet_view::Uuid>> {
+        static constexpr const char *_name = "uuid";
+    };
+    struct username : packet_view::Field<login_success, 1, packet_view::PrefixedBytes<16>> {
+        static constexpr const char *_name = "username";
+    };
+    struct properties : packet_view::Field<login_success, 2, packet_view::Array<login_success_properties>> {
+        static constexpr const char *_name = "properties";
+    };
+
+    using _fields = packet_view::FieldList<uuid, username, properties>;
+};
+
+struct set_compression {
+    static constexpr int _id = 0x03;
+    static constexpr const char *_name = "set compression";
+
+    struct threshold : packet_view::Field<set_compression, 0, packet_view::VarInt> {
+        static constexpr const char *_name = "threshold";
+    };
+
+    using _fields = packet_view::FieldList<threshold>;
+};
+
+struct custom_query {
+    static constexpr int _id = 0x04;
+    static constexpr const char *_name = "custom query";
+
+    struct message_id : packet_view::Field<custom_query, 0, packet_view::VarInt> {
+        static constexpr const char *_name = "message id";
+    };
+    struct channel : packet_view::Field<custom_query, 1, packet_view::PrefixedBytes<packet_view::NO_MAX_LENGTH>> {
+        static constexpr const char *_name = "channel";
+    };
+    struct data : packet_view::Field<custom_query, 2, packet_view::RemainingBytes<packet_view::NO_MAX_LENGTH>> {
+        static constexpr const char *_name = "data";
+    };
+
+    using _fields = packet_view::FieldList<message_id, channel, data>;
+};
+
+struct cookie_request {
+    static constexpr int _id = 0x05;
+    static constexpr const char *_name = "cookie request";
+
+    struct key : packet_view::Field<cookie_request, 0, packet_view::PrefixedBytes<packet_view::NO_MAX_LENGTH>> {
+        static constexpr const char *_name = "key";
+    };
+
+    using _fields = packet_view::FieldList<key>;
+};
+
+} // namespace login_s2c
+
+namespace login_c2s {
+
+struct login_start {
+    static constexpr int _id = 0x00;
+    static constexpr const char *_name = "login start";
+
+    struct name : packet_view::Field<login_start, 0, packet_view::PrefixedBytes<16>> {
+        static constexpr const char *_name = "name";
+    };
+    struct uuid : packet_view::Field<login_start, 1, packet_view::Fixed<packet_view::Uuid>> {
+        static constexpr const char *_name = "uuid";
+    };
+
+    using _fields = packet_view::FieldList<name, uuid>;
+};
+
+struct encryption_response {
+    static constexpr int _id = 0x01;
+    static constexpr const char *_name = "encryption response";
+
+    struct shared_secret : packet_view::Field<encryption_response, 0, packet_view::PrefixedBytes<packet_view::NO_MAX_LENGTH>> {
+        static constexpr const char *_name = "shared secret";
+    };
+    struct verify_token : packet_view::Field<encryption_response, 1, packet_view::PrefixedBytes<packet_view::NO_MAX_LENGTH>> {
+        static constexpr const char *_name = "verify token";
+    };
+
+    using _fields = packet_view::FieldList<shared_secret, verify_token>;
+};
+
+struct custom_query_answer {
+    static constexpr int _id = 0x02;
+    static constexpr const char *_name = "custom query answer";
+
+    struct message_id : packet_view::Field<custom_query_answer, 0, packet_view::VarInt> {
+        static constexpr const char *_name = "message id";
+    };
+    struct data : packet_view::Field<custom_query_answer, 1, packet_view::RemainingBytes<packet_view::NO_MAX_LENGTH>> {
+        static constexpr const char *_name = "data";
+    };
+
+    using _fields = packet_view::FieldList<message_id, data>;
+};
+
+struct login_acknowledged {
+    static constexpr int _id = 0x03;
+    static constexpr const char *_name = "login acknowledged";
+
+    using _fields = packet_view::FieldList<>;
+};
+
+struct cookie_response {
+    static constexpr int _id = 0x04;
+    static constexpr const char *_name = "cookie response";
+
+    struct key : packet_view::Field<cookie_response, 0, packet_view::PrefixedBytes<packet_view::NO_MAX_LENGTH>> {
+        static constexpr const char *_name = "key";
+    };
+    struct payload : packet_view::Field<cookie_response, 1, packet_view::Optional<packet_view::PrefixedBytes<packet_view::NO_MAX_LENGTH>>> {
+        static constexpr const char *_name = "payload";
+    };
+
+    using _fields = packet_view::FieldList<key, payload>;
+};
+
+} // namespace login_c2s
+
+} // namespace packets
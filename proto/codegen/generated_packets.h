@@ -0,0 +1,1016 @@
+#pragma once
+ // DO NOT EDIT!!!
+ // This file is automatically generated by packet_gen.c from 1.21.4.proto, see README.md
+
+#include "codegen.h"
+
+#define GENERATED_PROTOCOL_NUMBER 769
+
+
+// handshake_c2s: packet 0x00 "handshake"
+#define HANDSHAKE_C2S_HANDSHAKE_ID 0x00
+
+struct handshake_c2s_handshake {
+    int32_t protocol_version;
+    struct PacketBufferView server_address;
+    uint16_t port;
+    int32_t next_state;
+};
+
+static __always_inline int _decode_handshake_c2s_handshake(struct handshake_c2s_handshake *out, const char **buffer, const char *end, struct Arena *arena) {
+    const char *p = *buffer;
+    (void) arena;
+    _GEN_READ_VAR_STYLE(out->protocol_version, 32, "protocol version");
+    {
+        uint32_t size;
+        _GEN_READ_VAR_STYLE(size, 32, "server address");
+        _GEN_CHECK_LENGTH(size, 255u, "server address");
+        _GEN_NEED(size, "server address");
+        out->server_address = (struct PacketBufferView) {.data = p, .size = size};
+        p += size;
+    }
+    _GEN_NEED(2, "port");
+    out->port = (uint16_t) _gen_load16(p + 0);
+    p += 2;
+    _GEN_READ_VAR_STYLE(out->next_state, 32, "next state");
+    *buffer = p;
+    return 0;
+}
+
+static __always_inline int64_t _encoded_size_handshake_c2s_handshake(const struct handshake_c2s_handshake *in) {
+    int64_t size = 0;
+    size += varStyleSize((uint32_t) in->protocol_version);
+    if (_gen_check_encode_length(in->server_address.size, 255, "server address"))
+        return -1;
+    size += varStyleSize(in->server_address.size) + in->server_address.size;
+    size += varStyleSize((uint32_t) in->next_state);
+    return size + 2;
+}
+
+static __always_inline char *_encode_handshake_c2s_handshake(const struct handshake_c2s_handshake *in, char *out) {
+    out = putVarStyleWide(out, (uint32_t) in->protocol_version);
+    out = putVarStyleWide(out, in->server_address.size);
+    out = _gen_store_bytes(out, in->server_address);
+    out = _gen_store16(out, in->port);
+    out = putVarStyleWide(out, (uint32_t) in->next_state);
+    return out;
+}
+
+static inline int decode_handshake_c2s_handshake(struct handshake_c2s_handshake *out, const char *buffer, size_t size, struct Arena *arena) {
+    const char *p = buffer;
+    if (_decode_handshake_c2s_handshake(out, &p, buffer + size, arena)) {
+        set_decode_error_origin(buffer);
+        return -1;
+    }
+    return _gen_check_trailing(buffer, p, buffer + size);
+}
+static inline int64_t encoded_size_handshake_c2s_handshake(const struct handshake_c2s_handshake *in) { return _encoded_size_handshake_c2s_handshake(in); }
+static inline char *encode_handshake_c2s_handshake(const struct handshake_c2s_handshake *in, char *out) { return _encode_handshake_c2s_handshake(in, out); }
+static inline struct CombinedDataSegment *serialize_handshake_c2s_handshake(const struct handshake_c2s_handshake *in) {
+    char *out;
+    struct CombinedDataSegment *combined = _gen_begin_frame(HANDSHAKE_C2S_HANDSHAKE_ID, "handshake", _encoded_size_handshake_c2s_handshake(in), &out);
+    if (combined)
+        _encode_handshake_c2s_handshake(in, out);
+    return combined;
+}
+
+
+// status_s2c: packet 0x00 "status response"
+#define STATUS_S2C_STATUS_RESPONSE_ID 0x00
+
+struct status_s2c_status_response {
+    struct PacketBufferView json;
+};
+
+static __always_inline int _decode_status_s2c_status_response(struct status_s2c_status_response *out, const char **buffer, const char *end, struct Arena *arena) {
+    const char *p = *buffer;
+    (void) arena;
+    {
+        uint32_t size;
+        _GEN_READ_VAR_STYLE(size, 32, "json");
+        _GEN_CHECK_LENGTH(size, 32767u, "json");
+        _GEN_NEED(size, "json");
+        out->json = (struct PacketBufferView) {.data = p, .size = size};
+        p += size;
+    }
+    *buffer = p;
+    return 0;
+}
+
+static __always_inline int64_t _encoded_size_status_s2c_status_response(const struct status_s2c_status_response *in) {
+    int64_t size = 0;
+    if (_gen_check_encode_length(in->json.size, 32767, "json"))
+        return -1;
+    size += varStyleSize(in->json.size) + in->json.size;
+    return size + 0;
+}
+
+static __always_inline char *_encode_status_s2c_status_response(const struct status_s2c_status_response *in, char *out) {
+    out = putVarStyleWide(out, in->json.size);
+    out = _gen_store_bytes(out, in->json);
+    return out;
+}
+
+static inline int decode_status_s2c_status_response(struct status_s2c_status_response *out, const char *buffer, size_t size, struct Arena *arena) {
+    const char *p = buffer;
+    if (_decode_status_s2c_status_response(out, &p, buffer + size, arena)) {
+        set_decode_error_origin(buffer);
+        return -1;
+    }
+    return _gen_check_trailing(buffer, p, buffer + size);
+}
+static inline int64_t encoded_size_status_s2c_status_response(const struct status_s2c_status_response *in) { return _encoded_size_status_s2c_status_response(in); }
+static inline char *encode_status_s2c_status_response(const struct status_s2c_status_response *in, char *out) { return _encode_status_s2c_status_response(in, out); }
+static inline struct CombinedDataSegment *serialize_status_s2c_status_response(const struct status_s2c_status_response *in) {
+    char *out;
+    struct CombinedDataSegment *combined = _gen_begin_frame(STATUS_S2C_STATUS_RESPONSE_ID, "status response", _encoded_size_status_s2c_status_response(in), &out);
+    if (combined)
+        _encode_status_s2c_status_response(in, out);
+    return combined;
+}
+
+
+// status_s2c: packet 0x01 "pong response"
+#define STATUS_S2C_PONG_RESPONSE_ID 0x01
+
+struct status_s2c_pong_response {
+    int64_t timestamp;
+};
+
+static __always_inline int _decode_status_s2c_pong_response(struct status_s2c_pong_response *out, const char **buffer, const char *end, struct Arena *arena) {
+    const char *p = *buffer;
+    (void) arena;
+    _GEN_NEED(8, "timestamp");
+    out->timestamp = (int64_t) _gen_load64(p + 0);
+    p += 8;
+    *buffer = p;
+    return 0;
+}
+
+static __always_inline int64_t _encoded_size_status_s2c_pong_response(const struct status_s2c_pong_response *in) {
+    int64_t size = 0;
+    (void) in;
+    return size + 8;
+}
+
+static __always_inline char *_encode_status_s2c_pong_response(const struct status_s2c_pong_response *in, char *out) {
+    out = _gen_store64(out, in->timestamp);
+    return out;
+}
+
+static inline int decode_status_s2c_pong_response(struct status_s2c_pong_response *out, const char *buffer, size_t size, struct Arena *arena) {
+    const char *p = buffer;
+    if (_decode_status_s2c_pong_response(out, &p, buffer + size, arena)) {
+        set_decode_error_origin(buffer);
+        return -1;
+    }
+    return _gen_check_trailing(buffer, p, buffer + size);
+}
+static inline int64_t encoded_size_status_s2c_pong_response(const struct status_s2c_pong_response *in) { return _encoded_size_status_s2c_pong_response(in); }
+static inline char *encode_status_s2c_pong_response(const struct status_s2c_pong_response *in, char *out) { return _encode_status_s2c_pong_response(in, out); }
+static inline struct CombinedDataSegment *serialize_status_s2c_pong_response(const struct status_s2c_pong_response *in) {
+    char *out;
+    struct CombinedDataSegment *combined = _gen_begin_frame(STATUS_S2C_PONG_RESPONSE_ID, "pong response", _encoded_size_status_s2c_pong_response(in), &out);
+    if (combined)
+        _encode_status_s2c_pong_response(in, out);
+    return combined;
+}
+
+
+// status_c2s: packet 0x00 "status request"
+#define STATUS_C2S_STATUS_REQUEST_ID 0x00
+
+struct status_c2s_status_request {
+    char _empty;
+};
+
+static __always_inline int _decode_status_c2s_status_request(struct status_c2s_status_request *out, const char **buffer, const char *end, struct Arena *arena) {
+    const char *p = *buffer;
+    (void) out, (void) end;
+    (void) arena;
+    *buffer = p;
+    return 0;
+}
+
+static __always_inline int64_t _encoded_size_status_c2s_status_request(const struct status_c2s_status_request *in) {
+    int64_t size = 0;
+    (void) in;
+    return size + 0;
+}
+
+static __always_inline char *_encode_status_c2s_status_request(const struct status_c2s_status_request *in, char *out) {
+    (void) in;
+    return out;
+}
+
+static inline int decode_status_c2s_status_request(struct status_c2s_status_request *out, const char *buffer, size_t size, struct Arena *arena) {
+    const char *p = buffer;
+    if (_decode_status_c2s_status_request(out, &p, buffer + size, arena)) {
+        set_decode_error_origin(buffer);
+        return -1;
+    }
+    return _gen_check_trailing(buffer, p, buffer + size);
+}
+static inline int64_t encoded_size_status_c2s_status_request(const struct status_c2s_status_request *in) { return _encoded_size_status_c2s_status_request(in); }
+static inline char *encode_status_c2s_status_request(const struct status_c2s_status_request *in, char *out) { return _encode_status_c2s_status_request(in, out); }
+static inline struct CombinedDataSegment *serialize_status_c2s_status_request(const struct status_c2s_status_request *in) {
+    char *out;
+    struct CombinedDataSegment *combined = _gen_begin_frame(STATUS_C2S_STATUS_REQUEST_ID, "status request", _encoded_size_status_c2s_status_request(in), &out);
+    if (combined)
+        _encode_status_c2s_status_request(in, out);
+    return combined;
+}
+
+
+// status_c2s: packet 0x01 "ping request"
+#define STATUS_C2S_PING_REQUEST_ID 0x01
+
+struct status_c2s_ping_request {
+    int64_t timestamp;
+};
+
+static __always_inline int _decode_status_c2s_ping_request(struct status_c2s_ping_request *out, const char **buffer, const char *end, struct Arena *arena) {
+    const char *p = *buffer;
+    (void) arena;
+    _GEN_NEED(8, "timestamp");
+    out->timestamp = (int64_t) _gen_load64(p + 0);
+    p += 8;
+    *buffer = p;
+    return 0;
+}
+
+static __always_inline int64_t _encoded_size_status_c2s_ping_request(const struct status_c2s_ping_request *in) {
+    int64_t size = 0;
+    (void) in;
+    return size + 8;
+}
+
+static __always_inline char *_encode_status_c2s_ping_request(const struct status_c2s_ping_request *in, char *out) {
+    out = _gen_store64(out, in->timestamp);
+    return out;
+}
+
+static inline int decode_status_c2s_ping_request(struct status_c2s_ping_request *out, const char *buffer, size_t size, struct Arena *arena) {
+    const char *p = buffer;
+    if (_decode_status_c2s_ping_request(out, &p, buffer + size, arena)) {
+        set_decode_error_origin(buffer);
+        return -1;
+    }
+    return _gen_check_trailing(buffer, p, buffer + size);
+}
+static inline int64_t encoded_size_status_c2s_ping_request(const struct status_c2s_ping_request *in) { return _encoded_size_status_c2s_ping_request(in); }
+static inline char *encode_status_c2s_ping_request(const struct status_c2s_ping_request *in, char *out) { return _encode_status_c2s_ping_request(in, out); }
+static inline struct CombinedDataSegment *serialize_status_c2s_ping_request(const struct status_c2s_ping_request *in) {
+    char *out;
+    struct CombinedDataSegment *combined = _gen_begin_frame(STATUS_C2S_PING_REQUEST_ID, "ping request", _encoded_size_status_c2s_ping_request(in), &out);
+    if (combined)
+        _encode_status_c2s_ping_request(in, out);
+    return combined;
+}
+
+
+// login_s2c: packet 0x00 "disconnect"
+#define LOGIN_S2C_DISCONNECT_ID 0x00
+
+struct login_s2c_disconnect {
+    struct PacketBufferView reason;
+};
+
+static __always_inline int _decode_login_s2c_disconnect(struct login_s2c_disconnect *out, const char **buffer, const char *end, struct Arena *arena) {
+    const char *p = *buffer;
+    (void) arena;
+    {
+        uint32_t size;
+        _GEN_READ_VAR_STYLE(size, 32, "reason");
+        _GEN_NEED(size, "reason");
+        out->reason = (struct PacketBufferView) {.data = p, .size = size};
+        p += size;
+    }
+    *buffer = p;
+    return 0;
+}
+
+static __always_inline int64_t _encoded_size_login_s2c_disconnect(const struct login_s2c_disconnect *in) {
+    int64_t size = 0;
+    size += varStyleSize(in->reason.size) + in->reason.size;
+    return size + 0;
+}
+
+static __always_inline char *_encode_login_s2c_disconnect(const struct login_s2c_disconnect *in, char *out) {
+    out = putVarStyleWide(out, in->reason.size);
+    out = _gen_store_bytes(out, in->reason);
+    return out;
+}
+
+static inline int decode_login_s2c_disconnect(struct login_s2c_disconnect *out, const char *buffer, size_t size, struct Arena *arena) {
+    const char *p = buffer;
+    if (_decode_login_s2c_disconnect(out, &p, buffer + size, arena)) {
+        set_decode_error_origin(buffer);
+        return -1;
+    }
+    return _gen_check_trailing(buffer, p, buffer + size);
+}
+static inline int64_t encoded_size_login_s2c_disconnect(const struct login_s2c_disconnect *in) { return _encoded_size_login_s2c_disconnect(in); }
+static inline char *encode_login_s2c_disconnect(const struct login_s2c_disconnect *in, char *out) { return _encode_login_s2c_disconnect(in, out); }
+static inline struct CombinedDataSegment *serialize_login_s2c_disconnect(const struct login_s2c_disconnect *in) {
+    char *out;
+    struct CombinedDataSegment *combined = _gen_begin_frame(LOGIN_S2C_DISCONNECT_ID, "disconnect", _encoded_size_login_s2c_disconnect(in), &out);
+    if (combined)
+        _encode_login_s2c_disconnect(in, out);
+    return combined;
+}
+
+
+// login_s2c: packet 0x01 "encryption request"
+#define LOGIN_S2C_ENCRYPTION_REQUEST_ID 0x01
+
+struct login_s2c_encryption_request {
+    struct PacketBufferView server_id;
+    struct PacketBufferView public_key;
+    struct PacketBufferView verify_token;
+    bool should_authenticate;
+};
+
+static __always_inline int _decode_login_s2c_encryption_request(struct login_s2c_encryption_request *out, const char **buffer, const char *end, struct Arena *arena) {
+    const char *p = *buffer;
+    (void) arena;
+    {
+        uint32_t size;
+        _GEN_READ_VAR_STYLE(size, 32, "server id");
+        _GEN_CHECK_LENGTH(size, 20u, "server id");
+        _GEN_NEED(size, "server id");
+        out->server_id = (struct PacketBufferView) {.data = p, .size = size};
+        p += size;
+    }
+    {
+        uint32_t size;
+        _GEN_READ_VAR_STYLE(size, 32, "public key");
+        _GEN_NEED(size, "public key");
+        out->public_key = (struct PacketBufferView) {.data = p, .size = size};
+        p += size;
+    }
+    {
+        uint32_t size;
+        _GEN_READ_VAR_STYLE(size, 32, "verify token");
+        _GEN_NEED(size, "verify token");
+        out->verify_token = (struct PacketBufferView) {.data = p, .size = size};
+        p += size;
+    }
+    _GEN_NEED(1, "should authenticate");
+    out->should_authenticate = _gen_load8(p + 0) != 0;
+    p += 1;
+    *buffer = p;
+    return 0;
+}
+
+static __always_inline int64_t _encoded_size_login_s2c_encryption_request(const struct login_s2c_encryption_request *in) {
+    int64_t size = 0;
+    if (_gen_check_encode_length(in->server_id.size, 20, "server id"))
+        return -1;
+    size += varStyleSize(in->server_id.size) + in->server_id.size;
+    size += varStyleSize(in->public_key.size) + in->public_key.size;
+    size += varStyleSize(in->verify_token.size) + in->verify_token.size;
+    return size + 1;
+}
+
+static __always_inline char *_encode_login_s2c_encryption_request(const struct login_s2c_encryption_request *in, char *out) {
+    out = putVarStyleWide(out, in->server_id.size);
+    out = _gen_store_bytes(out, in->server_id);
+    out = putVarStyleWide(out, in->public_key.size);
+    out = _gen_store_bytes(out, in->public_key);
+    out = putVarStyleWide(out, in->verify_token.size);
+    out = _gen_store_bytes(out, in->verify_token);
+    out = _gen_store8(out, in->should_authenticate);
+    return out;
+}
+
+static inline int decode_login_s2c_encryption_request(struct login_s2c_encryption_request *out, const char *buffer, size_t size, struct Arena *arena) {
+    const char *p = buffer;
+    if (_decode_login_s2c_encryption_request(out, &p, buffer + size, arena)) {
+        set_decode_error_origin(buffer);
+        return -1;
+    }
+    return _gen_check_trailing(buffer, p, buffer + size);
+}
+static inline int64_t encoded_size_login_s2c_encryption_request(const struct login_s2c_encryption_request *in) { return _encoded_size_login_s2c_encryption_request(in); }
+static inline char *encode_login_s2c_encryption_request(const struct login_s2c_encryption_request *in, char *out) { return _encode_login_s2c_encryption_request(in, out); }
+static inline struct CombinedDataSegment *serialize_login_s2c_encryption_request(const struct login_s2c_encryption_request *in) {
+    char *out;
+    struct CombinedDataSegment *combined = _gen_begin_frame(LOGIN_S2C_ENCRYPTION_REQUEST_ID, "encryption request", _encoded_size_login_s2c_encryption_request(in), &out);
+    if (combined)
+        _encode_login_s2c_encryption_request(in, out);
+    return combined;
+}
+
+
+// login_s2c: packet 0x02 "login success"
+#define LOGIN_S2C_LOGIN_SUCCESS_ID 0x02
+
+struct login_s2c_login_success_properties {
+    struct PacketBufferView name;
+    struct PacketBufferView value;
+    bool has_signature;
+    struct PacketBufferView signature;
+};
+
+static __always_inline int _decode_login_s2c_login_success_properties(struct login_s2c_login_success_properties *out, const char **buffer, const char *end, struct Arena *arena) {
+    const char *p = *buffer;
+    (void) arena;
+    {
+        uint32_t size;
+        _GEN_READ_VAR_STYLE(size, 32, "name");
+        _GEN_CHECK_LENGTH(size, 64u, "name");
+        _GEN_NEED(size, "name");
+        out->name = (struct PacketBufferView) {.data = p, .size = size};
+        p += size;
+    }
+    {
+        uint32_t size;
+        _GEN_READ_VAR_STYLE(size, 32, "value");
+        _GEN_NEED(size, "value");
+        out->value = (struct PacketBufferView) {.data = p, .size = size};
+        p += size;
+    }
+    _GEN_NEED(1, "signature");
+    out->has_signature = *(p++) != 0;
+    if (out->has_signature) {
+        {
+            uint32_t size;
+            _GEN_READ_VAR_STYLE(size, 32, "signature");
+            _GEN_NEED(size, "signature");
+            out->signature = (struct PacketBufferView) {.data = p, .size = size};
+            p += size;
+        }
+    }
+    *buffer = p;
+    return 0;
+}
+
+static __always_inline int64_t _encoded_size_login_s2c_login_success_properties(const struct login_s2c_login_success_properties *in) {
+    int64_t size = 0;
+    if (_gen_check_encode_length(in->name.size, 64, "name"))
+        return -1;
+    size += varStyleSize(in->name.size) + in->name.size;
+    size += varStyleSize(in->value.size) + in->value.size;
+    if (in->has_signature) {
+        size += varStyleSize(in->signature.size) + in->signature.size;
+    }
+    return size + 1;
+}
+
+static __always_inline char *_encode_login_s2c_login_success_properties(const struct login_s2c_login_success_properties *in, char *out) {
+    out = putVarStyleWide(out, in->name.size);
+    out = _gen_store_bytes(out, in->name);
+    out = putVarStyleWide(out, in->value.size);
+    out = _gen_store_bytes(out, in->value);
+    *(out++) = in->has_signature;
+    if (in->has_signature) {
+        out = putVarStyleWide(out, in->signature.size);
+        out = _gen_store_bytes(out, in->signature);
+    }
+    return out;
+}
+
+struct login_s2c_login_success {
+    struct MC_uuid uuid;
+    struct PacketBufferView username;
+    uint32_t properties_count;
+    struct login_s2c_login_success_properties *properties;
+};
+
+static __always_inline int _decode_login_s2c_login_success(struct login_s2c_login_success *out, const char **buffer, const char *end, struct Arena *arena) {
+    const char *p = *buffer;
+    _GEN_NEED(16, "uuid");
+    out->uuid = _gen_load_uuid(p + 0);
+    p += 16;
+    {
+        uint32_t size;
+        _GEN_READ_VAR_STYLE(size, 32, "username");
+        _GEN_CHECK_LENGTH(size, 16u, "username");
+        _GEN_NEED(size, "username");
+        out->username = (struct PacketBufferView) {.data = p, .size = size};
+        p += size;
+    }
+    {
+        uint32_t count;
+        _GEN_READ_VAR_STYLE(count, 32, "properties");
+        _GEN_CHECK_COUNT(count, "properties");
+        if (__builtin_expect((size_t) (end - p) / 3 < count, 0)) {
+            struct login_s2c_login_success_properties scratch;
+            for (uint32_t i = 0; i < count; i++) {
+                if (_decode_login_s2c_login_success_properties(&scratch, &p, end, arena))
+                    return -1;
+            }
+        }
+        out->properties_count = count;
+        out->properties = count ? arena_alloc(arena, count * sizeof(*out->properties)) : NULL;
+        for (uint32_t i = 0; i < count; i++) {
+            if (_decode_login_s2c_login_success_properties(&out->properties[i], &p, end, arena))
+                return -1;
+        }
+    }
+    *buffer = p;
+    return 0;
+}
+
+static __always_inline int64_t _encoded_size_login_s2c_login_success(const struct login_s2c_login_success *in) {
+    int64_t size = 0;
+    if (_gen_check_encode_length(in->username.size, 16, "username"))
+        return -1;
+    size += varStyleSize(in->username.size) + in->username.size;
+    size += varStyleSize(in->properties_count);
+    for (uint32_t i = 0; i < in->properties_count; i++) {
+        int64_t element = _encoded_size_login_s2c_login_success_properties(&in->properties[i]);
+        if (element < 0)
+            return -1;
+        size += element;
+    }
+    return size + 16;
+}
+
+static __always_inline char *_encode_login_s2c_login_success(const struct login_s2c_login_success *in, char *out) {
+    out = _gen_store_uuid(out, in->uuid);
+    out = putVarStyleWide(out, in->username.size);
+    out = _gen_store_bytes(out, in->username);
+    out = putVarStyleWide(out, in->properties_count);
+    for (uint32_t i = 0; i < in->properties_count; i++)
+        out = _encode_login_s2c_login_success_properties(&in->properties[i], out);
+    return out;
+}
+
+static inline int decode_login_s2c_login_success(struct login_s2c_login_success *out, const char *buffer, size_t size, struct Arena *arena) {
+    const char *p = buffer;
+    if (_decode_login_s2c_login_success(out, &p, buffer + size, arena)) {
+        set_decode_error_origin(buffer);
+        return -1;
+    }
+    return _gen_check_trailing(buffer, p, buffer + size);
+}
+static inline int64_t encoded_size_login_s2c_login_success(const struct login_s2c_login_success *in) { return _encoded_size_login_s2c_login_success(in); }
+static inline char *encode_login_s2c_login_success(const struct login_s2c_login_success *in, char *out) { return _encode_login_s2c_login_success(in, out); }
+static inline struct CombinedDataSegment *serialize_login_s2c_login_success(const struct login_s2c_login_success *in) {
+    char *out;
+    struct CombinedDataSegment *combined = _gen_begin_frame(LOGIN_S2C_LOGIN_SUCCESS_ID, "login success", _encoded_size_login_s2c_login_success(in), &out);
+    if (combined)
+        _encode_login_s2c_login_success(in, out);
+    return combined;
+}
+
+
+// login_s2c: packet 0x03 "set compression"
+#define LOGIN_S2C_SET_COMPRESSION_ID 0x03
+
+struct login_s2c_set_compression {
+    int32_t threshold;
+};
+
+static __always_inline int _decode_login_s2c_set_compression(struct login_s2c_set_compression *out, const char **buffer, const char *end, struct Arena *arena) {
+    const char *p = *buffer;
+    (void) arena;
+    _GEN_READ_VAR_STYLE(out->threshold, 32, "threshold");
+    *buffer = p;
+    return 0;
+}
+
+static __always_inline int64_t _encoded_size_login_s2c_set_compression(const struct login_s2c_set_compression *in) {
+    int64_t size = 0;
+    size += varStyleSize((uint32_t) in->threshold);
+    return size + 0;
+}
+
+static __always_inline char *_encode_login_s2c_set_compression(const struct login_s2c_set_compression *in, char *out) {
+    out = putVarStyleWide(out, (uint32_t) in->threshold);
+    return out;
+}
+
+static inline int decode_login_s2c_set_compression(struct login_s2c_set_compression *out, const char *buffer, size_t size, struct Arena *arena) {
+    const char *p = buffer;
+    if (_decode_login_s2c_set_compression(out, &p, buffer + size, arena)) {
+        set_decode_error_origin(buffer);
+        return -1;
+    }
+    return _gen_check_trailing(buffer, p, buffer + size);
+}
+static inline int64_t encoded_size_login_s2c_set_compression(const struct login_s2c_set_compression *in) { return _encoded_size_login_s2c_set_compression(in); }
+static inline char *encode_login_s2c_set_compression(const struct login_s2c_set_compression *in, char *out) { return _encode_login_s2c_set_compression(in, out); }
+static inline struct CombinedDataSegment *serialize_login_s2c_set_compression(const struct login_s2c_set_compression *in) {
+    char *out;
+    struct CombinedDataSegment *combined = _gen_begin_frame(LOGIN_S2C_SET_COMPRESSION_ID, "set compression", _encoded_size_login_s2c_set_compression(in), &out);
+    if (combined)
+        _encode_login_s2c_set_compression(in, out);
+    return combined;
+}
+
+
+// login_s2c: packet 0x04 "custom query"
+#define LOGIN_S2C_CUSTOM_QUERY_ID 0x04
+
+struct login_s2c_custom_query {
+    int32_t message_id;
+    struct PacketBufferView channel;
+    struct PacketBufferView data;
+};
+
+static __always_inline int _decode_login_s2c_custom_query(struct login_s2c_custom_query *out, const char **buffer, const char *end, struct Arena *arena) {
+    const char *p = *buffer;
+    (void) arena;
+    _GEN_READ_VAR_STYLE(out->message_id, 32, "message id");
+    {
+        uint32_t size;
+        _GEN_READ_VAR_STYLE(size, 32, "channel");
+        _GEN_NEED(size, "channel");
+        out->channel = (struct PacketBufferView) {.data = p, .size = size};
+        p += size;
+    }
+    {
+        size_t size = end - p;
+        _GEN_NEED(size, "data");
+        out->data = (struct PacketBufferView) {.data = p, .size = size};
+        p += size;
+    }
+    *buffer = p;
+    return 0;
+}
+
+static __always_inline int64_t _encoded_size_login_s2c_custom_query(const struct login_s2c_custom_query *in) {
+    int64_t size = 0;
+    size += varStyleSize((uint32_t) in->message_id);
+    size += varStyleSize(in->channel.size) + in->channel.size;
+    size += in->data.size;
+    return size + 0;
+}
+
+static __always_inline char *_encode_login_s2c_custom_query(const struct login_s2c_custom_query *in, char *out) {
+    out = putVarStyleWide(out, (uint32_t) in->message_id);
+    out = putVarStyleWide(out, in->channel.size);
+    out = _gen_store_bytes(out, in->channel);
+    out = _gen_store_bytes(out, in->data);
+    return out;
+}
+
+static inline int decode_login_s2c_custom_query(struct login_s2c_custom_query *out, const char *buffer, size_t size, struct Arena *arena) {
+    const char *p = buffer;
+    if (_decode_login_s2c_custom_query(out, &p, buffer + size, arena)) {
+        set_decode_error_origin(buffer);
+        return -1;
+    }
+    return _gen_check_trailing(buffer, p, buffer + size);
+}
+static inline int64_t encoded_size_login_s2c_custom_query(const struct login_s2c_custom_query *in) { return _encoded_size_login_s2c_custom_query(in); }
+static inline char *encode_login_s2c_custom_query(const struct login_s2c_custom_query *in, char *out) { return _encode_login_s2c_custom_query(in, out); }
+static inline struct CombinedDataSegment *serialize_login_s2c_custom_query(const struct login_s2c_custom_query *in) {
+    char *out;
+    struct CombinedDataSegment *combined = _gen_begin_frame(LOGIN_S2C_CUSTOM_QUERY_ID, "custom query", _encoded_size_login_s2c_custom_query(in), &out);
+    if (combined)
+        _encode_login_s2c_custom_query(in, out);
+    return combined;
+}
+
+
+// login_s2c: packet 0x05 "cookie request"
+#define LOGIN_S2C_COOKIE_REQUEST_ID 0x05
+
+struct login_s2c_cookie_request {
+    struct PacketBufferView key;
+};
+
+static __always_inline int _decode_login_s2c_cookie_request(struct login_s2c_cookie_request *out, const char **buffer, const char *end, struct Arena *arena) {
+    const char *p = *buffer;
+    (void) arena;
+    {
+        uint32_t size;
+        _GEN_READ_VAR_STYLE(size, 32, "key");
+        _GEN_NEED(size, "key");
+        out->key = (struct PacketBufferView) {.data = p, .size = size};
+        p += size;
+    }
+    *buffer = p;
+    return 0;
+}
+
+static __always_inline int64_t _encoded_size_login_s2c_cookie_request(const struct login_s2c_cookie_request *in) {
+    int64_t size = 0;
+    size += varStyleSize(in->key.size) + in->key.size;
+    return size + 0;
+}
+
+static __always_inline char *_encode_login_s2c_cookie_request(const struct login_s2c_cookie_request *in, char *out) {
+    out = putVarStyleWide(out, in->key.size);
+    out = _gen_store_bytes(out, in->key);
+    return out;
+}
+
+static inline int decode_login_s2c_cookie_request(struct login_s2c_cookie_request *out, const char *buffer, size_t size, struct Arena *arena) {
+    const char *p = buffer;
+    if (_decode_login_s2c_cookie_request(out, &p, buffer + size, arena)) {
+        set_decode_error_origin(buffer);
+        return -1;
+    }
+    return _gen_check_trailing(buffer, p, buffer + size);
+}
+static inline int64_t encoded_size_login_s2c_cookie_request(const struct login_s2c_cookie_request *in) { return _encoded_size_login_s2c_cookie_request(in); }
+static inline char *encode_login_s2c_cookie_request(const struct login_s2c_cookie_request *in, char *out) { return _encode_login_s2c_cookie_request(in, out); }
+static inline struct CombinedDataSegment *serialize_login_s2c_cookie_request(const struct login_s2c_cookie_request *in) {
+    char *out;
+    struct CombinedDataSegment *combined = _gen_begin_frame(LOGIN_S2C_COOKIE_REQUEST_ID, "cookie request", _encoded_size_login_s2c_cookie_request(in), &out);
+    if (combined)
+        _encode_login_s2c_cookie_request(in, out);
+    return combined;
+}
+
+
+// login_c2s: packet 0x00 "login start"
+#define LOGIN_C2S_LOGIN_START_ID 0x00
+
+struct login_c2s_login_start {
+    struct PacketBufferView name;
+    struct MC_uuid uuid;
+};
+
+static __always_inline int _decode_login_c2s_login_start(struct login_c2s_login_start *out, const char **buffer, const char *end, struct Arena *arena) {
+    const char *p = *buffer;
+    (void) arena;
+    {
+        uint32_t size;
+        _GEN_READ_VAR_STYLE(size, 32, "name");
+        _GEN_CHECK_LENGTH(size, 16u, "name");
+        _GEN_NEED(size, "name");
+        out->name = (struct PacketBufferView) {.data = p, .size = size};
+        p += size;
+    }
+    _GEN_NEED(16, "uuid");
+    out->uuid = _gen_load_uuid(p + 0);
+    p += 16;
+    *buffer = p;
+    return 0;
+}
+
+static __always_inline int64_t _encoded_size_login_c2s_login_start(const struct login_c2s_login_start *in) {
+    int64_t size = 0;
+    if (_gen_check_encode_length(in->name.size, 16, "name"))
+        return -1;
+    size += varStyleSize(in->name.size) + in->name.size;
+    return size + 16;
+}
+
+static __always_inline char *_encode_login_c2s_login_start(const struct login_c2s_login_start *in, char *out) {
+    out = putVarStyleWide(out, in->name.size);
+    out = _gen_store_bytes(out, in->name);
+    out = _gen_store_uuid(out, in->uuid);
+    return out;
+}
+
+static inline int decode_login_c2s_login_start(struct login_c2s_login_start *out, const char *buffer, size_t size, struct Arena *arena) {
+    const char *p = buffer;
+    if (_decode_login_c2s_login_start(out, &p, buffer + size, arena)) {
+        set_decode_error_origin(buffer);
+        return -1;
+    }
+    return _gen_check_trailing(buffer, p, buffer + size);
+}
+static inline int64_t encoded_size_login_c2s_login_start(const struct login_c2s_login_start *in) { return _encoded_size_login_c2s_login_start(in); }
+static inline char *encode_login_c2s_login_start(const struct login_c2s_login_start *in, char *out) { return _encode_login_c2s_login_start(in, out); }
+static inline struct CombinedDataSegment *serialize_login_c2s_login_start(const struct login_c2s_login_start *in) {
+    char *out;
+    struct CombinedDataSegment *combined = _gen_begin_frame(LOGIN_C2S_LOGIN_START_ID, "login start", _encoded_size_login_c2s_login_start(in), &out);
+    if (combined)
+        _encode_login_c2s_login_start(in, out);
+    return combined;
+}
+
+
+// login_c2s: packet 0x01 "encryption response"
+#define LOGIN_C2S_ENCRYPTION_RESPONSE_ID 0x01
+
+struct login_c2s_encryption_response {
+    struct PacketBufferView shared_secret;
+    struct PacketBufferView verify_token;
+};
+
+static __always_inline int _decode_login_c2s_encryption_response(struct login_c2s_encryption_response *out, const char **buffer, const char *end, struct Arena *arena) {
+    const char *p = *buffer;
+    (void) arena;
+    {
+        uint32_t size;
+        _GEN_READ_VAR_STYLE(size, 32, "shared secret");
+        _GEN_NEED(size, "shared secret");
+        out->shared_secret = (struct PacketBufferView) {.data = p, .size = size};
+        p += size;
+    }
+    {
+        uint32_t size;
+        _GEN_READ_VAR_STYLE(size, 32, "verify token");
+        _GEN_NEED(size, "verify token");
+        out->verify_token = (struct PacketBufferView) {.data = p, .size = size};
+        p += size;
+    }
+    *buffer = p;
+    return 0;
+}
+
+static __always_inline int64_t _encoded_size_login_c2s_encryption_response(const struct login_c2s_encryption_response *in) {
+    int64_t size = 0;
+    size += varStyleSize(in->shared_secret.size) + in->shared_secret.size;
+    size += varStyleSize(in->verify_token.size) + in->verify_token.size;
+    return size + 0;
+}
+
+static __always_inline char *_encode_login_c2s_encryption_response(const struct login_c2s_encryption_response *in, char *out) {
+    out = putVarStyleWide(out, in->shared_secret.size);
+    out = _gen_store_bytes(out, in->shared_secret);
+    out = putVarStyleWide(out, in->verify_token.size);
+    out = _gen_store_bytes(out, in->verify_token);
+    return out;
+}
+
+static inline int decode_login_c2s_encryption_response(struct login_c2s_encryption_response *out, const char *buffer, size_t size, struct Arena *arena) {
+    const char *p = buffer;
+    if (_decode_login_c2s_encryption_response(out, &p, buffer + size, arena)) {
+        set_decode_error_origin(buffer);
+        return -1;
+    }
+    return _gen_check_trailing(buffer, p, buffer + size);
+}
+static inline int64_t encoded_size_login_c2s_encryption_response(const struct login_c2s_encryption_response *in) { return _encoded_size_login_c2s_encryption_response(in); }
+static inline char *encode_login_c2s_encryption_response(const struct login_c2s_encryption_response *in, char *out) { return _encode_login_c2s_encryption_response(in, out); }
+static inline struct CombinedDataSegment *serialize_login_c2s_encryption_response(const struct login_c2s_encryption_response *in) {
+    char *out;
+    struct CombinedDataSegment *combined = _gen_begin_frame(LOGIN_C2S_ENCRYPTION_RESPONSE_ID, "encryption response", _encoded_size_login_c2s_encryption_response(in), &out);
+    if (combined)
+        _encode_login_c2s_encryption_response(in, out);
+    return combined;
+}
+
+
+// login_c2s: packet 0x02 "custom query answer"
+#define LOGIN_C2S_CUSTOM_QUERY_ANSWER_ID 0x02
+
+struct login_c2s_custom_query_answer {
+    int32_t message_id;
+    struct PacketBufferView data;
+};
+
+static __always_inline int _decode_login_c2s_custom_query_answer(struct login_c2s_custom_query_answer *out, const char **buffer, const char *end, struct Arena *arena) {
+    const char *p = *buffer;
+    (void) arena;
+    _GEN_READ_VAR_STYLE(out->message_id, 32, "message id");
+    {
+        size_t size = end - p;
+        _GEN_NEED(size, "data");
+        out->data = (struct PacketBufferView) {.data = p, .size = size};
+        p += size;
+    }
+    *buffer = p;
+    return 0;
+}
+
+static __always_inline int64_t _encoded_size_login_c2s_custom_query_answer(const struct login_c2s_custom_query_answer *in) {
+    int64_t size = 0;
+    size += varStyleSize((uint32_t) in->message_id);
+    size += in->data.size;
+    return size + 0;
+}
+
+static __always_inline char *_encode_login_c2s_custom_query_answer(const struct login_c2s_custom_query_answer *in, char *out) {
+    out = putVarStyleWide(out, (uint32_t) in->message_id);
+    out = _gen_store_bytes(out, in->data);
+    return out;
+}
+
+static inline int decode_login_c2s_custom_query_answer(struct login_c2s_custom_query_answer *out, const char *buffer, size_t size, struct Arena *arena) {
+    const char *p = buffer;
+    if (_decode_login_c2s_custom_query_answer(out, &p, buffer + size, arena)) {
+        set_decode_error_origin(buffer);
+        return -1;
+    }
+    return _gen_check_trailing(buffer, p, buffer + size);
+}
+static inline int64_t encoded_size_login_c2s_custom_query_answer(const struct login_c2s_custom_query_answer *in) { return _encoded_size_login_c2s_custom_query_answer(in); }
+static inline char *encode_login_c2s_custom_query_answer(const struct login_c2s_custom_query_answer *in, char *out) { return _encode_login_c2s_custom_query_answer(in, out); }
+static inline struct CombinedDataSegment *serialize_login_c2s_custom_query_answer(const struct login_c2s_custom_query_answer *in) {
+    char *out;
+    struct CombinedDataSegment *combined = _gen_begin_frame(LOGIN_C2S_CUSTOM_QUERY_ANSWER_ID, "custom query answer", _encoded_size_login_c2s_custom_query_answer(in), &out);
+    if (combined)
+        _encode_login_c2s_custom_query_answer(in, out);
+    return combined;
+}
+
+
+// login_c2s: packet 0x03 "login acknowledged"
+#define LOGIN_C2S_LOGIN_ACKNOWLEDGED_ID 0x03
+
+struct login_c2s_login_acknowledged {
+    char _empty;
+};
+
+static __always_inline int _decode_login_c2s_login_acknowledged(struct login_c2s_login_acknowledged *out, const char **buffer, const char *end, struct Arena *arena) {
+    const char *p = *buffer;
+    (void) out, (void) end;
+    (void) arena;
+    *buffer = p;
+    return 0;
+}
+
+static __always_inline int64_t _encoded_size_login_c2s_login_acknowledged(const struct login_c2s_login_acknowledged *in) {
+    int64_t size = 0;
+    (void) in;
+    return size + 0;
+}
+
+static __always_inline char *_encode_login_c2s_login_acknowledged(const struct login_c2s_login_acknowledged *in, char *out) {
+    (void) in;
+    return out;
+}
+
+static inline int decode_login_c2s_login_acknowledged(struct login_c2s_login_acknowledged *out, const char *buffer, size_t size, struct Arena *arena) {
+    const char *p = buffer;
+    if (_decode_login_c2s_login_acknowledged(out, &p, buffer + size, arena)) {
+        set_decode_error_origin(buffer);
+        return -1;
+    }
+    return _gen_check_trailing(buffer, p, buffer + size);
+}
+static inline int64_t encoded_size_login_c2s_login_acknowledged(const struct login_c2s_login_acknowledged *in) { return _encoded_size_login_c2s_login_acknowledged(in); }
+static inline char *encode_login_c2s_login_acknowledged(const struct login_c2s_login_acknowledged *in, char *out) { return _encode_login_c2s_login_acknowledged(in, out); }
+static inline struct CombinedDataSegment *serialize_login_c2s_login_acknowledged(const struct login_c2s_login_acknowledged *in) {
+    char *out;
+    struct CombinedDataSegment *combined = _gen_begin_frame(LOGIN_C2S_LOGIN_ACKNOWLEDGED_ID, "login acknowledged", _encoded_size_login_c2s_login_acknowledged(in), &out);
+    if (combined)
+        _encode_login_c2s_login_acknowledged(in, out);
+    return combined;
+}
+
+
+// login_c2s: packet 0x04 "cookie response"
+#define LOGIN_C2S_COOKIE_RESPONSE_ID 0x04
+
+struct login_c2s_cookie_response {
+    struct PacketBufferView key;
+    bool has_payload;
+    struct PacketBufferView payload;
+};
+
+static __always_inline int _decode_login_c2s_cookie_response(struct login_c2s_cookie_response *out, const char **buffer, const char *end, struct Arena *arena) {
+    const char *p = *buffer;
+    (void) arena;
+    {
+        uint32_t size;
+        _GEN_READ_VAR_STYLE(size, 32, "key");
+        _GEN_NEED(size, "key");
+        out->key = (struct PacketBufferView) {.data = p, .size = size};
+        p += size;
+    }
+    _GEN_NEED(1, "payload");
+    out->has_payload = *(p++) != 0;
+    if (out->has_payload) {
+        {
+            uint32_t size;
+            _GEN_READ_VAR_STYLE(size, 32, "payload");
+            _GEN_NEED(size, "payload");
+            out->payload = (struct PacketBufferView) {.data = p, .size = size};
+            p += size;
+        }
+    }
+    *buffer = p;
+    return 0;
+}
+
+static __always_inline int64_t _encoded_size_login_c2s_cookie_response(const struct login_c2s_cookie_response *in) {
+    int64_t size = 0;
+    size += varStyleSize(in->key.size) + in->key.size;
+    if (in->has_payload) {
+        size += varStyleSize(in->payload.size) + in->payload.size;
+    }
+    return size + 1;
+}
+
+static __always_inline char *_encode_login_c2s_cookie_response(const struct login_c2s_cookie_response *in, char *out) {
+    out = putVarStyleWide(out, in->key.size);
+    out = _gen_store_bytes(out, in->key);
+    *(out++) = in->has_payload;
+    if (in->has_payload) {
+        out = putVarStyleWide(out, in->payload.size);
+        out = _gen_store_bytes(out, in->payload);
+    }
+    return out;
+}
+
+static inline int decode_login_c2s_cookie_response(struct login_c2s_cookie_response *out, const char *buffer, size_t size, struct Arena *arena) {
+    const char *p = buffer;
+    if (_decode_login_c2s_cookie_response(out, &p, buffer + size, arena)) {
+        set_decode_error_origin(buffer);
+        return -1;
+    }
+    return _gen_check_trailing(buffer, p, buffer + size);
+}
+static inline int64_t encoded_size_login_c2s_cookie_response(const struct login_c2s_cookie_response *in) { return _encoded_size_login_c2s_cookie_response(in); }
+static inline char *encode_login_c2s_cookie_response(const struct login_c2s_cookie_response *in, char *out) { return _encode_login_c2s_cookie_response(in, out); }
+static inline struct CombinedDataSegment *serialize_login_c2s_cookie_response(const struct login_c2s_cookie_response *in) {
+    char *out;
+    struct CombinedDataSegment *combined = _gen_begin_frame(LOGIN_C2S_COOKIE_RESPONSE_ID, "cookie response", _encoded_size_login_c2s_cookie_response(in), &out);
+    if (combined)
+        _encode_login_c2s_cookie_response(in, out);
+    return combined;
+}
+
+
@@ -0,0 +1,752 @@
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "error_handling.h"
+#include "serde.h"
+
+/*
+  Turns every packet of a .proto file into plain C: a struct for its fields,
+  and a decoder and encoder written out field by field. Optionally also into
+  C++ types describing each packet, for packet_view.hpp. Works off the
+  compiled plans, so it agrees with the interpreter on what is valid, and on
+  the errors it gives.
+
+  Usage: gen.a <file.proto> <output.h> [<output.hpp>]
+*/
+
+#define MAX_C_NAME 256
+
+struct Generator {
+    FILE *out;
+    int indent;
+    // Every type emitted so far, in the scope the next one is emitted to
+    char **types;
+    int type_count;
+};
+
+// Prints a line of C. Lines starting with } are dedented, ones ending with { indent the next ones.
+static void emit(struct Generator *gen, const char *format, ...) {
+    if (format[0] == '}')
+        gen->indent--;
+    if (format[0])
+        fprintf(gen->out, "%*s", gen->indent * 4, "");
+    va_list args;
+    va_start(args, format);
+    vfprintf(gen->out, format, args);
+    va_end(args);
+    fputc('\n', gen->out);
+    if (format[0] && format[strlen(format) - 1] == '{')
+        gen->indent++;
+}
+
+static void fail(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+    exit(-1);
+}
+
+// Bundle types are named after their packet and field, so two different ones can end up with the same name.
+// Like packet "a" with field "b", and packet "a b".
+static void claim_type(struct Generator *gen, const char *type) {
+    for (int i = 0; i < gen->type_count; i++) {
+        if (strcmp(gen->types[i], type) == 0)
+            fail("There are two types named %s, rename one of the packets or fields", type);
+    }
+    gen->types = realloc(gen->types, (gen->type_count + 1) * sizeof(char *));
+    gen->types[gen->type_count++] = strdup(type);
+}
+
+// Forgets the types claimed so far, for the next scope
+static void reset_types(struct Generator *gen) {
+    for (int i = 0; i < gen->type_count; i++)
+        free(gen->types[i]);
+    gen->type_count = 0;
+}
+
+// Names are used in both the C and the C++ output, so neither language's keywords can be one
+static const char *const KEYWORDS[] = {
+        "auto",     "break",     "case",          "char",        "const",        "continue",         "default",    "do",
+        "double",   "else",      "enum",          "extern",      "float",        "for",              "goto",       "if",
+        "inline",   "int",       "long",          "register",    "restrict",     "return",           "short",      "signed",
+        "sizeof",   "static",    "struct",        "switch",      "typedef",      "union",            "unsigned",   "void",
+        "volatile", "while",     "bool",          "true",        "false",        "and",              "asm",        "catch",
+        "class",    "constexpr", "delete",        "explicit",    "export",       "friend",           "mutable",    "namespace",
+        "new",      "noexcept",  "not",           "operator",    "or",           "private",          "protected",  "public",
+        "template", "this",      "throw",         "try",         "typename",     "using",            "virtual",    "xor",
+        "nullptr",  "decltype",  "static_assert", "static_cast", "dynamic_cast", "reinterpret_cast", "const_cast", "typeid",
+        "alignas",  "alignof",   "thread_local",  "wchar_t",     "char8_t",      "char16_t",         "char32_t",   "concept",
+        "requires", "co_await",  "co_yield",      "co_return",   "consteval",    "constinit",        "bitand",     "bitor",
+        "compl",    "not_eq",    "and_eq",        "or_eq",       "xor_eq",       NULL,
+};
+
+// "server address" becomes server_address
+static void c_name(char *dst, const char *name) {
+    size_t len = 0;
+    if (isdigit((unsigned char) name[0]))
+        dst[len++] = '_';
+    for (; *name && len < MAX_C_NAME - 2; name++)
+        dst[len++] = isalnum((unsigned char) *name) ? tolower((unsigned char) *name) : '_';
+    if (!len)
+        dst[len++] = '_';
+    dst[len] = 0;
+    for (int i = 0; KEYWORDS[i]; i++) {
+        if (strcmp(dst, KEYWORDS[i]) == 0) {
+            dst[len++] = '_';
+            dst[len] = 0;
+        }
+    }
+}
+
+#define C_STRING_SIZE (4 * MAX_C_NAME + 3)
+
+// Quoted, escaped C string literal of str. Only good until the next call.
+static const char *c_string(const char *str) {
+    static char buffer[C_STRING_SIZE];
+    size_t len = 0;
+    buffer[len++] = '"';
+    for (; *str && len < sizeof(buffer) - 6; str++) {
+        unsigned char c = *str;
+        if (c == '"' || c == '\\')
+            len += sprintf(buffer + len, "\\%c", c);
+        else if (isprint(c))
+            buffer[len++] = c;
+        else
+            len += sprintf(buffer + len, "\\%03o", c);
+    }
+    buffer[len++] = '"';
+    buffer[len] = 0;
+    return buffer;
+}
+
+static bool is_fixed_width(const struct PlanOp *op) { return op->opcode <= PO_UUID; }
+
+static const char *value_type(const struct PlanOp *op) {
+    static const char *const TYPES[] = {
+            [PO_BOOLEAN] = "bool",     [PO_BYTE] = "int8_t",    [PO_UBYTE] = "uint8_t",  [PO_SHORT] = "int16_t",
+            [PO_USHORT] = "uint16_t",  [PO_INT] = "int32_t",    [PO_UINT] = "uint32_t",  [PO_LONG] = "int64_t",
+            [PO_ULONG] = "uint64_t",   [PO_UUID] = "struct MC_uuid", [PO_VARINT] = "int32_t", [PO_VARLONG] = "int64_t",
+    };
+    return TYPES[op->opcode];
+}
+
+// Smallest amount of bytes a plan takes up on the wire
+static size_t plan_min_size(const struct DecodePlan *plan) {
+    size_t size = 0;
+    for (uint32_t i = 0; i < plan->op_count; i++) {
+        const struct PlanOp *op = &plan->ops[i];
+        size += is_fixed_width(op) ? op->width : op->opcode == PO_REMAINING_BYTES ? 0 : 1;
+    }
+    return size;
+}
+
+static void gen_plan(struct Generator *gen, const struct DecodePlan *plan, const char *type);
+
+// Whether decoding the op allocates, or hands the arena down to a bundle that might
+static bool op_uses_arena(const struct PlanOp *op) {
+    if (op->opcode == PO_OPTIONAL)
+        return op_uses_arena(plan_op_sub_plan(op)->ops);
+    return op->opcode == PO_OPTIONAL_BUNDLE || op->opcode == PO_PREFIXED_ARRAY || op->opcode == PO_PACKED_ARRAY;
+}
+
+// Types of the bundles inside of a field come first
+static void gen_nested(struct Generator *gen, const struct PlanOp *op, const char *type, const char *field) {
+    char nested[2 * MAX_C_NAME + 1];
+    snprintf(nested, sizeof(nested), "%s_%s", type, field);
+    if (op->opcode == PO_OPTIONAL)
+        gen_nested(gen, plan_op_sub_plan(op)->ops, type, field);
+    // The element of a packed array gets a bundle of its own too, for its name
+    else if (op->opcode == PO_OPTIONAL_BUNDLE || op->opcode == PO_PREFIXED_ARRAY || op->opcode == PO_PACKED_ARRAY)
+        gen_plan(gen, plan_op_sub_plan(op), nested);
+}
+
+static void gen_declare(struct Generator *gen, const struct PlanOp *op, const char *type, const char *field) {
+    switch (op->opcode) {
+        case PO_STRING:
+        case PO_PREFIXED_BYTE_ARRAY:
+        case PO_REMAINING_BYTES:
+            emit(gen, "struct PacketBufferView %s;", field);
+            break;
+        case PO_OPTIONAL:
+            emit(gen, "bool has_%s;", field);
+            gen_declare(gen, plan_op_sub_plan(op)->ops, type, field);
+            break;
+        case PO_OPTIONAL_BUNDLE:
+            emit(gen, "bool has_%s;", field);
+            emit(gen, "struct %s_%s %s;", type, field, field);
+            break;
+        case PO_PREFIXED_ARRAY:
+            emit(gen, "uint32_t %s_count;", field);
+            emit(gen, "struct %s_%s *%s;", type, field, field);
+            break;
+        case PO_PACKED_ARRAY:
+            emit(gen, "uint32_t %s_count;", field);
+            emit(gen, "%s *%s;", value_type(plan_op_sub_plan(op)->ops), field);
+            break;
+        default:
+            emit(gen, "%s %s;", value_type(op), field);
+    }
+}
+
+// Read of a fixed width value at p + offset, no bounds check
+static void gen_load(struct Generator *gen, const struct PlanOp *op, const char *lvalue, const char *offset) {
+    if (op->opcode == PO_UUID)
+        emit(gen, "%s = _gen_load_uuid(p + %s);", lvalue, offset);
+    else if (op->opcode == PO_BOOLEAN)
+        emit(gen, "%s = _gen_load8(p + %s) != 0;", lvalue, offset);
+    else
+        emit(gen, "%s = (%s) _gen_load%d(p + %s);", lvalue, value_type(op), op->width * 8, offset);
+}
+
+static void gen_decode_value(struct Generator *gen, const struct PlanOp *op, const char *lvalue) {
+    if (is_fixed_width(op)) {
+        emit(gen, "_GEN_NEED(%d, %s);", op->width, c_string(plan_op_name(op)));
+        gen_load(gen, op, lvalue, "0");
+        emit(gen, "p += %d;", op->width);
+    } else {
+        emit(gen, "_GEN_READ_VAR_STYLE(%s, %d, %s);", lvalue, op->opcode == PO_VARINT ? 32 : 64, c_string(plan_op_name(op)));
+    }
+}
+
+static void gen_decode_op(struct Generator *gen, const struct PlanOp *op, const char *type, const char *field) {
+    char name[C_STRING_SIZE];
+    strcpy(name, c_string(plan_op_name(op)));
+    char lvalue[MAX_C_NAME + 8];
+    snprintf(lvalue, sizeof(lvalue), "out->%s", field);
+
+    switch (op->opcode) {
+        case PO_STRING:
+        case PO_PREFIXED_BYTE_ARRAY:
+        case PO_REMAINING_BYTES:
+            emit(gen, "{");
+            if (op->opcode == PO_REMAINING_BYTES) {
+                emit(gen, "size_t size = end - p;");
+            } else {
+                emit(gen, "uint32_t size;");
+                emit(gen, "_GEN_READ_VAR_STYLE(size, 32, %s);", name);
+            }
+            if (op->max_length != PLAN_NO_MAX_LENGTH)
+                emit(gen, "_GEN_CHECK_LENGTH(size, %lldu, %s);", (long long) op->max_length, name);
+            emit(gen, "_GEN_NEED(size, %s);", name);
+            emit(gen, "%s = (struct PacketBufferView) {.data = p, .size = size};", lvalue);
+            emit(gen, "p += size;");
+            emit(gen, "}");
+            break;
+        case PO_OPTIONAL:
+        case PO_OPTIONAL_BUNDLE:
+            emit(gen, "_GEN_NEED(1, %s);", name);
+            emit(gen, "out->has_%s = *(p++) != 0;", field);
+            emit(gen, "if (out->has_%s) {", field);
+            if (op->opcode == PO_OPTIONAL)
+                gen_decode_op(gen, plan_op_sub_plan(op)->ops, type, field);
+            else
+                emit(gen, "if (_decode_%s_%s(&%s, &p, end, arena))", type, field, lvalue);
+            if (op->opcode == PO_OPTIONAL_BUNDLE)
+                emit(gen, "    return -1;");
+            emit(gen, "}");
+            break;
+        case PO_PREFIXED_ARRAY:
+        case PO_PACKED_ARRAY: {
+            const struct DecodePlan *sub = plan_op_sub_plan(op);
+            const struct PlanOp *element = sub->ops;
+            emit(gen, "{");
+            emit(gen, "uint32_t count;");
+            emit(gen, "_GEN_READ_VAR_STYLE(count, 32, %s);", name);
+            emit(gen, "_GEN_CHECK_COUNT(count, %s);", name);
+
+            // Fails up front if the elements can't all fit, rather than allocating for them first
+            if (op->opcode == PO_PACKED_ARRAY && element->width) {
+                emit(gen, "if (__builtin_expect((size_t) (end - p) / %d < count, 0)) {", element->width);
+                emit(gen, "SET_DECODE_ERROR(DECODE_ERROR_TRUNCATED, %s, p + (end - p) / %d * %d, 0, 0);", c_string(plan_op_name(element)),
+                     element->width, element->width);
+                emit(gen, "return -1;");
+                emit(gen, "}");
+            } else if (op->opcode == PO_PREFIXED_ARRAY && plan_min_size(sub)) {
+                // Where exactly it fails depends on the elements, so they are decoded one by one into a throwaway
+                emit(gen, "if (__builtin_expect((size_t) (end - p) / %zu < count, 0)) {", plan_min_size(sub));
+                emit(gen, "struct %s_%s scratch;", type, field);
+                emit(gen, "for (uint32_t i = 0; i < count; i++) {");
+                emit(gen, "if (_decode_%s_%s(&scratch, &p, end, arena))", type, field);
+                emit(gen, "    return -1;");
+                emit(gen, "}");
+                emit(gen, "}");
+            }
+            emit(gen, "%s_count = count;", lvalue);
+            emit(gen, "%s = count ? arena_alloc(arena, count * sizeof(*%s)) : NULL;", lvalue, lvalue);
+            if (op->opcode == PO_PACKED_ARRAY && element->width) {
+                // Bounds are already checked, so this is a plain byte swapping loop
+                emit(gen, "for (uint32_t i = 0; i < count; i++)");
+                gen->indent++;
+                char offset[32];
+                snprintf(offset, sizeof(offset), "i * %d", element->width);
+                char element_lvalue[MAX_C_NAME + 16];
+                snprintf(element_lvalue, sizeof(element_lvalue), "%s[i]", lvalue);
+                gen_load(gen, element, element_lvalue, offset);
+                gen->indent--;
+                emit(gen, "p += (size_t) count * %d;", element->width);
+            } else if (op->opcode == PO_PACKED_ARRAY) {
+                char element_lvalue[MAX_C_NAME + 16];
+                snprintf(element_lvalue, sizeof(element_lvalue), "%s[i]", lvalue);
+                emit(gen, "for (uint32_t i = 0; i < count; i++) {");
+                gen_decode_value(gen, element, element_lvalue);
+                emit(gen, "}");
+            } else {
+                emit(gen, "for (uint32_t i = 0; i < count; i++) {");
+                emit(gen, "if (_decode_%s_%s(&%s[i], &p, end, arena))", type, field, lvalue);
+                emit(gen, "    return -1;");
+                emit(gen, "}");
+            }
+            emit(gen, "}");
+            break;
+        }
+        default:
+            gen_decode_value(gen, op, lvalue);
+    }
+}
+
+// A run of fixed width fields is checked once, then read without any checks.
+// Returns: how many ops the run was
+static uint32_t gen_decode_fixed_run(struct Generator *gen, const struct DecodePlan *plan, uint32_t start, char fields[][MAX_C_NAME]) {
+    uint32_t end = start;
+    int total = 0;
+    while (end < plan->op_count && is_fixed_width(&plan->ops[end]))
+        total += plan->ops[end++].width;
+
+    // The slow path works out which field it was that got cut off
+    emit(gen, "if (__builtin_expect(end - p < %d, 0)) {", total);
+    int offset = 0;
+    for (uint32_t i = start; i < end; i++) {
+        const struct PlanOp *op = &plan->ops[i];
+        if (i + 1 == end) {
+            emit(gen, "SET_DECODE_ERROR(DECODE_ERROR_TRUNCATED, %s, p + %d, 0, 0);", c_string(plan_op_name(op)), offset);
+        } else {
+            emit(gen, "if (end - p < %d) {", offset + op->width);
+            emit(gen, "SET_DECODE_ERROR(DECODE_ERROR_TRUNCATED, %s, p + %d, 0, 0);", c_string(plan_op_name(op)), offset);
+            emit(gen, "return -1;");
+            emit(gen, "}");
+        }
+        offset += op->width;
+    }
+    emit(gen, "return -1;");
+    emit(gen, "}");
+
+    offset = 0;
+    for (uint32_t i = start; i < end; i++) {
+        char lvalue[MAX_C_NAME + 8], at[16];
+        snprintf(lvalue, sizeof(lvalue), "out->%s", fields[i]);
+        snprintf(at, sizeof(at), "%d", offset);
+        gen_load(gen, &plan->ops[i], lvalue, at);
+        offset += plan->ops[i].width;
+    }
+    emit(gen, "p += %d;", total);
+    return end - start;
+}
+
+// Adds the size of a field to size, known constant parts are added to fixed instead
+static void gen_size_op(struct Generator *gen, const struct PlanOp *op, const char *type, const char *field, int *fixed) {
+    char name[C_STRING_SIZE];
+    strcpy(name, c_string(plan_op_name(op)));
+    switch (op->opcode) {
+        case PO_VARINT:
+            emit(gen, "size += varStyleSize((uint32_t) in->%s);", field);
+            break;
+        case PO_VARLONG:
+            emit(gen, "size += varStyleSize((uint64_t) in->%s);", field);
+            break;
+        case PO_STRING:
+        case PO_PREFIXED_BYTE_ARRAY:
+        case PO_REMAINING_BYTES:
+            if (op->max_length != PLAN_NO_MAX_LENGTH) {
+                emit(gen, "if (_gen_check_encode_length(in->%s.size, %lld, %s))", field, (long long) op->max_length, name);
+                emit(gen, "    return -1;");
+            }
+            if (op->opcode == PO_REMAINING_BYTES)
+                emit(gen, "size += in->%s.size;", field);
+            else
+                emit(gen, "size += varStyleSize(in->%s.size) + in->%s.size;", field, field);
+            break;
+        case PO_OPTIONAL: {
+            (*fixed)++;
+            int inner = 0;
+            emit(gen, "if (in->has_%s) {", field);
+            gen_size_op(gen, plan_op_sub_plan(op)->ops, type, field, &inner);
+            if (inner)
+                emit(gen, "size += %d;", inner);
+            emit(gen, "}");
+            break;
+        }
+        case PO_OPTIONAL_BUNDLE:
+            (*fixed)++;
+            emit(gen, "if (in->has_%s) {", field);
+            emit(gen, "int64_t bundle = _encoded_size_%s_%s(&in->%s);", type, field, field);
+            emit(gen, "if (bundle < 0)");
+            emit(gen, "    return -1;");
+            emit(gen, "size += bundle;");
+            emit(gen, "}");
+            break;
+        case PO_PREFIXED_ARRAY:
+            emit(gen, "size += varStyleSize(in->%s_count);", field);
+            emit(gen, "for (uint32_t i = 0; i < in->%s_count; i++) {", field);
+            emit(gen, "int64_t element = _encoded_size_%s_%s(&in->%s[i]);", type, field, field);
+            emit(gen, "if (element < 0)");
+            emit(gen, "    return -1;");
+            emit(gen, "size += element;");
+            emit(gen, "}");
+            break;
+        case PO_PACKED_ARRAY: {
+            const struct PlanOp *element = plan_op_sub_plan(op)->ops;
+            emit(gen, "size += varStyleSize(in->%s_count);", field);
+            if (element->width) {
+                emit(gen, "size += (int64_t) in->%s_count * %d;", field, element->width);
+            } else {
+                emit(gen, "for (uint32_t i = 0; i < in->%s_count; i++)", field);
+                emit(gen, "    size += varStyleSize((%s) in->%s[i]);", element->opcode == PO_VARINT ? "uint32_t" : "uint64_t", field);
+            }
+            break;
+        }
+        default:
+            *fixed += op->width;
+    }
+}
+
+static void gen_encode_value(struct Generator *gen, const struct PlanOp *op, const char *value) {
+    if (op->opcode == PO_UUID)
+        emit(gen, "out = _gen_store_uuid(out, %s);", value);
+    else if (op->opcode == PO_VARINT)
+        emit(gen, "out = putVarStyleWide(out, (uint32_t) %s);", value);
+    else if (op->opcode == PO_VARLONG)
+        emit(gen, "out = putVarStyleWide(out, (uint64_t) %s);", value);
+    else
+        emit(gen, "out = _gen_store%d(out, %s);", op->width * 8, value);
+}
+
+static void gen_encode_op(struct Generator *gen, const struct PlanOp *op, const char *type, const char *field) {
+    char value[MAX_C_NAME + 8];
+    snprintf(value, sizeof(value), "in->%s", field);
+    switch (op->opcode) {
+        case PO_STRING:
+        case PO_PREFIXED_BYTE_ARRAY:
+        case PO_REMAINING_BYTES:
+            if (op->opcode != PO_REMAINING_BYTES)
+                emit(gen, "out = putVarStyleWide(out, %s.size);", value);
+            emit(gen, "out = _gen_store_bytes(out, %s);", value);
+            break;
+        case PO_OPTIONAL:
+            emit(gen, "*(out++) = in->has_%s;", field);
+            emit(gen, "if (in->has_%s) {", field);
+            gen_encode_op(gen, plan_op_sub_plan(op)->ops, type, field);
+            emit(gen, "}");
+            break;
+        case PO_OPTIONAL_BUNDLE:
+            emit(gen, "*(out++) = in->has_%s;", field);
+            emit(gen, "if (in->has_%s)", field);
+            emit(gen, "    out = _encode_%s_%s(&%s, out);", type, field, value);
+            break;
+        case PO_PREFIXED_ARRAY:
+            emit(gen, "out = putVarStyleWide(out, in->%s_count);", field);
+            emit(gen, "for (uint32_t i = 0; i < in->%s_count; i++)", field);
+            emit(gen, "    out = _encode_%s_%s(&%s[i], out);", type, field, value);
+            break;
+        case PO_PACKED_ARRAY: {
+            char element[MAX_C_NAME + 16];
+            snprintf(element, sizeof(element), "%s[i]", value);
+            emit(gen, "out = putVarStyleWide(out, in->%s_count);", field);
+            emit(gen, "for (uint32_t i = 0; i < in->%s_count; i++)", field);
+            gen->indent++;
+            gen_encode_value(gen, plan_op_sub_plan(op)->ops, element);
+            gen->indent--;
+            break;
+        }
+        default:
+            gen_encode_value(gen, op, value);
+    }
+}
+
+// Struct, decoder, and encoder for a bundle, after the ones of every bundle inside of it
+static void gen_plan(struct Generator *gen, const struct DecodePlan *plan, const char *type) {
+    claim_type(gen, type);
+    char(*fields)[MAX_C_NAME] = calloc(plan->op_count + 1, MAX_C_NAME);
+    for (uint32_t i = 0; i < plan->op_count; i++) {
+        c_name(fields[i], plan_op_name(&plan->ops[i]));
+        for (uint32_t j = 0; j < i; j++) {
+            if (strcmp(fields[i], fields[j]) == 0)
+                fail("Fields \"%s\" and \"%s\" of %s are both named %s in C", plan_op_name(&plan->ops[i]), plan_op_name(&plan->ops[j]),
+                     type, fields[i]);
+        }
+        gen_nested(gen, &plan->ops[i], type, fields[i]);
+    }
+
+    emit(gen, "struct %s {", type);
+    for (uint32_t i = 0; i < plan->op_count; i++)
+        gen_declare(gen, &plan->ops[i], type, fields[i]);
+    if (!plan->op_count)
+        emit(gen, "char _empty;");
+    emit(gen, "};");
+    emit(gen, "");
+
+    emit(gen, "static __always_inline int _decode_%s(struct %s *out, const char **buffer, const char *end, struct Arena *arena) {", type,
+         type);
+    emit(gen, "const char *p = *buffer;");
+    bool uses_arena = false, all_fixed = true;
+    for (uint32_t i = 0; i < plan->op_count; i++) {
+        uses_arena |= op_uses_arena(&plan->ops[i]);
+        all_fixed &= is_fixed_width(&plan->ops[i]);
+    }
+    if (!plan->op_count)
+        emit(gen, "(void) out, (void) end;");
+    if (!uses_arena)
+        emit(gen, "(void) arena;");
+    for (uint32_t i = 0; i < plan->op_count;) {
+        if (is_fixed_width(&plan->ops[i]) && i + 1 < plan->op_count && is_fixed_width(&plan->ops[i + 1])) {
+            i += gen_decode_fixed_run(gen, plan, i, fields);
+        } else {
+            gen_decode_op(gen, &plan->ops[i], type, fields[i]);
+            i++;
+        }
+    }
+    emit(gen, "*buffer = p;");
+    emit(gen, "return 0;");
+    emit(gen, "}");
+    emit(gen, "");
+
+    emit(gen, "static __always_inline int64_t _encoded_size_%s(const struct %s *in) {", type, type);
+    emit(gen, "int64_t size = 0;");
+    if (all_fixed)
+        emit(gen, "(void) in;");
+    int fixed = 0;
+    for (uint32_t i = 0; i < plan->op_count; i++)
+        gen_size_op(gen, &plan->ops[i], type, fields[i], &fixed);
+    emit(gen, "return size + %d;", fixed);
+    emit(gen, "}");
+    emit(gen, "");
+
+    emit(gen, "static __always_inline char *_encode_%s(const struct %s *in, char *out) {", type, type);
+    if (!plan->op_count)
+        emit(gen, "(void) in;");
+    for (uint32_t i = 0; i < plan->op_count; i++)
+        gen_encode_op(gen, &plan->ops[i], type, fields[i]);
+    emit(gen, "return out;");
+    emit(gen, "}");
+    emit(gen, "");
+    free(fields);
+}
+
+static void gen_packet(struct Generator *gen, const NameSpaceSerde *namespace, const struct PacketDeclaration *packet) {
+    char ns[MAX_C_NAME], name[MAX_C_NAME], type[2 * MAX_C_NAME + 1];
+    c_name(ns, namespace->name);
+    c_name(name, packet->name);
+    snprintf(type, sizeof(type), "%s_%s", ns, name);
+
+    emit(gen, "// %s: packet 0x%02x \"%s\"", namespace->name, packet->id, packet->name);
+    char upper[sizeof(type)];
+    for (size_t i = 0; i <= strlen(type); i++)
+        upper[i] = toupper((unsigned char) type[i]);
+    emit(gen, "#define %s_ID 0x%02x", upper, packet->id);
+    emit(gen, "");
+    gen_plan(gen, packet->plan, type);
+
+    emit(gen, "static inline int decode_%s(struct %s *out, const char *buffer, size_t size, struct Arena *arena) {", type, type);
+    emit(gen, "const char *p = buffer;");
+    emit(gen, "if (_decode_%s(out, &p, buffer + size, arena)) {", type);
+    emit(gen, "set_decode_error_origin(buffer);");
+    emit(gen, "return -1;");
+    emit(gen, "}");
+    emit(gen, "return _gen_check_trailing(buffer, p, buffer + size);");
+    emit(gen, "}");
+    emit(gen, "static inline int64_t encoded_size_%s(const struct %s *in) { return _encoded_size_%s(in); }", type, type, type);
+    emit(gen, "static inline char *encode_%s(const struct %s *in, char *out) { return _encode_%s(in, out); }", type, type, type);
+    emit(gen, "static inline struct CombinedDataSegment *serialize_%s(const struct %s *in) {", type, type);
+    emit(gen, "char *out;");
+    emit(gen, "struct CombinedDataSegment *combined = _gen_begin_frame(%s_ID, %s, _encoded_size_%s(in), &out);", upper,
+         c_string(packet->name), type);
+    emit(gen, "if (combined)");
+    emit(gen, "    _encode_%s(in, out);", type);
+    emit(gen, "return combined;");
+    emit(gen, "}");
+    emit(gen, "");
+    emit(gen, "");
+}
+
+// The packet_view.hpp kind of a field
+static void view_kind(char *dst, size_t size, const struct PlanOp *op, const char *type, const char *field) {
+    static const char *const FIXED[] = {
+            [PO_BOOLEAN] = "bool",           [PO_BYTE] = "int8_t",            [PO_UBYTE] = "uint8_t",          [PO_SHORT] = "int16_t",
+            [PO_USHORT] = "uint16_t",        [PO_INT] = "int32_t",            [PO_UINT] = "uint32_t",          [PO_LONG] = "int64_t",
+            [PO_ULONG] = "uint64_t",         [PO_UUID] = "packet_view::Uuid",
+    };
+    char inner[1024];
+    switch (op->opcode) {
+        case PO_VARINT:
+            snprintf(dst, size, "packet_view::VarInt");
+            break;
+        case PO_VARLONG:
+            snprintf(dst, size, "packet_view::VarLong");
+            break;
+        case PO_STRING:
+        case PO_PREFIXED_BYTE_ARRAY:
+        case PO_REMAINING_BYTES:
+            snprintf(inner, sizeof(inner), "%lld", (long long) op->max_length);
+            snprintf(dst, size, "packet_view::%s<%s>", op->opcode == PO_REMAINING_BYTES ? "RemainingBytes" : "PrefixedBytes",
+                     op->max_length == PLAN_NO_MAX_LENGTH ? "packet_view::NO_MAX_LENGTH" : inner);
+            break;
+        case PO_OPTIONAL:
+            view_kind(inner, sizeof(inner), plan_op_sub_plan(op)->ops, type, field);
+            snprintf(dst, size, "packet_view::Optional<%s>", inner);
+            break;
+        case PO_OPTIONAL_BUNDLE:
+            snprintf(dst, size, "packet_view::OptionalBundle<%s_%s>", type, field);
+            break;
+        case PO_PREFIXED_ARRAY:
+            snprintf(dst, size, "packet_view::Array<%s_%s>", type, field);
+            break;
+        case PO_PACKED_ARRAY:
+            snprintf(dst, size, "packet_view::PackedArray<%s_%s>", type, field);
+            break;
+        default:
+            snprintf(dst, size, "packet_view::Fixed<%s>", FIXED[op->opcode]);
+    }
+}
+
+static void gen_view_plan(struct Generator *gen, const struct DecodePlan *plan, const char *type, const struct PacketDeclaration *packet);
+
+static void gen_view_nested(struct Generator *gen, const struct PlanOp *op, const char *type, const char *field) {
+    char nested[2 * MAX_C_NAME + 1];
+    snprintf(nested, sizeof(nested), "%s_%s", type, field);
+    if (op->opcode == PO_OPTIONAL)
+        gen_view_nested(gen, plan_op_sub_plan(op)->ops, type, field);
+    // The element of a packed array gets a bundle of its own too, for its name
+    else if (op->opcode == PO_OPTIONAL_BUNDLE || op->opcode == PO_PREFIXED_ARRAY || op->opcode == PO_PACKED_ARRAY)
+        gen_view_plan(gen, plan_op_sub_plan(op), nested, NULL);
+}
+
+// Description of a bundle (a packet if packet is set), after the ones of every bundle inside of it
+static void gen_view_plan(struct Generator *gen, const struct DecodePlan *plan, const char *type, const struct PacketDeclaration *packet) {
+    claim_type(gen, type);
+    char(*fields)[MAX_C_NAME] = calloc(plan->op_count + 1, MAX_C_NAME);
+    for (uint32_t i = 0; i < plan->op_count; i++) {
+        c_name(fields[i], plan_op_name(&plan->ops[i]));
+        // Members of the description itself
+        if (strcmp(fields[i], "_id") == 0 || strcmp(fields[i], "_name") == 0 || strcmp(fields[i], "_fields") == 0)
+            fail("Field \"%s\" of %s is named %s in C++, which is reserved", plan_op_name(&plan->ops[i]), type, fields[i]);
+        // Would be a member named after its class
+        if (strcmp(fields[i], type) == 0)
+            fail("Field \"%s\" of %s has the name of its type in C++", plan_op_name(&plan->ops[i]), type);
+        gen_view_nested(gen, &plan->ops[i], type, fields[i]);
+    }
+
+    emit(gen, "struct %s {", type);
+    if (packet) {
+        emit(gen, "static constexpr int _id = 0x%02x;", packet->id);
+        emit(gen, "static constexpr const char *_name = %s;", c_string(packet->name));
+        emit(gen, "");
+    }
+    for (uint32_t i = 0; i < plan->op_count; i++) {
+        char kind[1024];
+        view_kind(kind, sizeof(kind), &plan->ops[i], type, fields[i]);
+        emit(gen, "struct %s : packet_view::Field<%s, %u, %s> {", fields[i], type, i, kind);
+        emit(gen, "static constexpr const char *_name = %s;", c_string(plan_op_name(&plan->ops[i])));
+        emit(gen, "};");
+    }
+    if (plan->op_count)
+        emit(gen, "");
+    fprintf(gen->out, "%*susing _fields = packet_view::FieldList<", gen->indent * 4, "");
+    for (uint32_t i = 0; i < plan->op_count; i++)
+        fprintf(gen->out, "%s%s", i ? ", " : "", fields[i]);
+    fprintf(gen->out, ">;\n");
+    emit(gen, "};");
+    emit(gen, "");
+    free(fields);
+}
+
+static void gen_view_packets(struct Generator *gen, VersionSerde *version, const char *source) {
+    emit(gen, "#pragma once");
+    emit(gen, " // DO NOT EDIT!!!");
+    emit(gen, " // This file is automatically generated by packet_gen.c from %s, see README.md", source);
+    emit(gen, "");
+    emit(gen, "#include \"packet_view.hpp\"");
+    emit(gen, "");
+    // Namespaces don't indent what is in them
+    emit(gen, "namespace packets {");
+    gen->indent--;
+    emit(gen, "");
+    emit(gen, "constexpr int protocol_number = %d;", version->protocol_number);
+    emit(gen, "");
+    for (int ns = 0; ns < MAX_NAMESPACES && version->namespaces[ns]; ns++) {
+        char name[MAX_C_NAME];
+        c_name(name, version->namespaces[ns]->name);
+        if (strcmp(name, "protocol_number") == 0)
+            fail("Namespace \"%s\" is named protocol_number in C++, which is reserved", version->namespaces[ns]->name);
+        emit(gen, "namespace %s {", name);
+        gen->indent--;
+        // Each namespace has its own types
+        reset_types(gen);
+        emit(gen, "");
+        for (int id = 0; id < 256; id++) {
+            const struct PacketDeclaration *packet = &version->namespaces[ns]->packets[id];
+            if (!packet->plan)
+                continue;
+            char type[MAX_C_NAME];
+            c_name(type, packet->name);
+            // Would hide packets::protocol_number within the namespace
+            if (strcmp(type, "protocol_number") == 0)
+                fail("Packet \"%s\" is named protocol_number in C++, which is reserved", packet->name);
+            gen_view_plan(gen, packet->plan, type, packet);
+        }
+        gen->indent++;
+        emit(gen, "} // namespace %s", name);
+        emit(gen, "");
+    }
+    gen->indent++;
+    emit(gen, "} // namespace packets");
+    reset_types(gen);
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3 && argc != 4)
+        fail("Usage: %s <file.proto> <output.h> [<output.hpp>]", argv[0]);
+    VersionSerde *version = load_version_serde(argv[1]);
+    if (!version)
+        exit_on_error();
+
+    struct Generator gen = {.out = fopen(argv[2], "w")};
+    if (!gen.out)
+        fail("Cannot write %s", argv[2]);
+    const char *source = strrchr(argv[1], '/') ? strrchr(argv[1], '/') + 1 : argv[1];
+    emit(&gen, "#pragma once");
+    emit(&gen, " // DO NOT EDIT!!!");
+    emit(&gen, " // This file is automatically generated by packet_gen.c from %s, see README.md", source);
+    emit(&gen, "");
+    emit(&gen, "#include \"codegen.h\"");
+    emit(&gen, "");
+    emit(&gen, "#define GENERATED_PROTOCOL_NUMBER %d", version->protocol_number);
+    emit(&gen, "");
+    emit(&gen, "");
+
+    for (int ns = 0; ns < MAX_NAMESPACES && version->namespaces[ns]; ns++) {
+        for (int id = 0; id < 256; id++) {
+            const struct PacketDeclaration *packet = &version->namespaces[ns]->packets[id];
+            if (packet->plan)
+                gen_packet(&gen, version->namespaces[ns], packet);
+        }
+    }
+    if (fclose(gen.out) != 0)
+        fail("Cannot write %s", argv[2]);
+    reset_types(&gen);
+    free(gen.types);
+
+    if (argc == 4) {
+        struct Generator views = {.out = fopen(argv[3], "w")};
+        if (!views.out)
+            fail("Cannot write %s", argv[3]);
+        gen_view_packets(&views, version, source);
+        free(views.types);
+        if (fclose(views.out) != 0)
+            fail("Cannot write %s", argv[3]);
+    }
+    return 0;
+}
@@ -0,0 +1,484 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+extern "C" {
+#include "datatypes.h"
+#include "error_handling.h"
+}
+
+/*
+  Typed, read only views over packets, for C++. generated_packet_views.hpp
+  describes every packet of the proto file as a type, with a tag type per
+  field, so that
+
+      PacketView<packets::login_s2c::set_compression> view(buffer, size);
+      int32_t threshold;
+      if (!view.get<packets::login_s2c::set_compression::threshold>(threshold))
+          ...
+
+  is checked at compile time (a field of another packet does not compile) and
+  reads straight from the buffer, nothing is allocated or copied. Strings and
+  byte arrays come out as string_views into it, so it must outlive the view.
+
+  Fields up to the first variable length one are at constexpr offsets. The
+  rest are found like a LazyPacket finds them: the first access scans up to
+  the field, noting down where every field it passes starts, later accesses
+  pick up from there. Whatever a get scans over is checked, and on failure
+  it returns false and sets the same decode error deserialize_packet would.
+  validate does the same for the whole packet, and checks for trailing bytes.
+
+  Bundles inside of a packet (optional bundles, array elements) are views of
+  their own. By the time one is handed out it has been scanned in full.
+*/
+
+namespace packet_view {
+
+struct Uuid {
+    // Most significant half comes first
+    uint64_t high;
+    uint64_t low;
+};
+
+// Used as the max length of containers that have none
+constexpr int64_t NO_MAX_LENGTH = -1;
+
+namespace detail {
+
+template <typename T> inline T load(const char *p) {
+    if constexpr (std::is_same<T, bool>::value) {
+        return *p != 0;
+    } else if constexpr (std::is_same<T, Uuid>::value) {
+        return Uuid {load<uint64_t>(p), load<uint64_t>(p + 8)};
+    } else {
+        std::make_unsigned_t<T> raw;
+        memcpy(&raw, p, sizeof(raw));
+        if constexpr (sizeof(T) == 2)
+            raw = be16toh(raw);
+        else if constexpr (sizeof(T) == 4)
+            raw = be32toh(raw);
+        else if constexpr (sizeof(T) == 8)
+            raw = be64toh(raw);
+        return static_cast<T>(raw);
+    }
+}
+
+inline bool need(const char *p, const char *end, size_t size, const char *name) {
+    if (__builtin_expect(static_cast<size_t>(end - p) < size, 0)) {
+        SET_DECODE_ERROR(DECODE_ERROR_TRUNCATED, name, p, 0, 0);
+        return false;
+    }
+    return true;
+}
+
+inline bool read_var(const char *&p, const char *end, int bits, uint64_t &out, const char *name) {
+    enum DecodeError error = decode_var_style(&p, end, bits, &out);
+    if (__builtin_expect(error, 0)) {
+        SET_DECODE_ERROR(error, name, p, 0, 0);
+        return false;
+    }
+    return true;
+}
+
+// MAX_DECODED_LIST_SIZE, packet_node.h is C only
+constexpr uint64_t MAX_LIST_SIZE = 1 << 21;
+
+// Count of an array, with the same limit deserialize_packet has
+inline bool read_count(const char *&p, const char *end, uint64_t &count, const char *name) {
+    if (!read_var(p, end, 32, count, name))
+        return false;
+    if (__builtin_expect(count > MAX_LIST_SIZE, 0)) {
+        SET_DECODE_ERROR(DECODE_ERROR_TOO_MANY_ELEMENTS, name, p, count, MAX_LIST_SIZE);
+        return false;
+    }
+    return true;
+}
+
+using SkipFunction = bool (*)(const char *&p, const char *end);
+
+template <typename F> bool skip_field(const char *&p, const char *end) { return F::_kind::skip(p, end, F::_name); }
+
+} // namespace detail
+
+/*
+  Kinds of fields. Every kind has a value_type, a width (0 if it varies),
+  skip, which moves past the field checking it on the way, and read, which
+  gets the value of a field skip has already said yes to.
+*/
+
+template <typename T> struct Fixed {
+    using value_type = T;
+    static constexpr size_t width = std::is_same<T, Uuid>::value ? 16 : sizeof(T);
+
+    static bool skip(const char *&p, const char *end, const char *name) {
+        if (!detail::need(p, end, width, name))
+            return false;
+        p += width;
+        return true;
+    }
+    static value_type read(const char *p, const char *, const char *) { return detail::load<T>(p); }
+};
+
+template <typename T, int Bits> struct Var {
+    using value_type = T;
+    static constexpr size_t width = 0;
+
+    static bool skip(const char *&p, const char *end, const char *name) {
+        uint64_t ignored;
+        return detail::read_var(p, end, Bits, ignored, name);
+    }
+    static value_type read(const char *p, const char *end, const char *) {
+        uint64_t value;
+        readVarStyle(&p, end, Bits, &value);
+        return static_cast<T>(value);
+    }
+};
+using VarInt = Var<int32_t, 32>;
+using VarLong = Var<int64_t, 64>;
+
+template <int64_t Max> struct PrefixedBytes {
+    using value_type = std::string_view;
+    static constexpr size_t width = 0;
+
+    static bool skip(const char *&p, const char *end, const char *name) {
+        uint64_t size;
+        if (!detail::read_var(p, end, 32, size, name))
+            return false;
+        if (Max != NO_MAX_LENGTH && size > static_cast<uint64_t>(Max)) {
+            SET_DECODE_ERROR(DECODE_ERROR_TOO_LONG, name, p, Max, size);
+            return false;
+        }
+        if (!detail::need(p, end, size, name))
+            return false;
+        p += size;
+        return true;
+    }
+    static value_type read(const char *p, const char *end, const char *) {
+        uint64_t size;
+        readVarStyle(&p, end, 32, &size);
+        return std::string_view(p, end - p);
+    }
+};
+
+template <int64_t Max> struct RemainingBytes {
+    using value_type = std::string_view;
+    static constexpr size_t width = 0;
+
+    static bool skip(const char *&p, const char *end, const char *name) {
+        if (Max != NO_MAX_LENGTH && end - p > Max) {
+            SET_DECODE_ERROR(DECODE_ERROR_TOO_LONG, name, p, Max, end - p);
+            return false;
+        }
+        p = end;
+        return true;
+    }
+    static value_type read(const char *p, const char *end, const char *) { return std::string_view(p, end - p); }
+};
+
+// Boolean prefixed single field
+template <typename Kind> struct Optional {
+    using value_type = std::optional<typename Kind::value_type>;
+    static constexpr size_t width = 0;
+
+    static bool skip(const char *&p, const char *end, const char *name) {
+        if (!detail::need(p, end, 1, name))
+            return false;
+        if (!*(p++))
+            return true;
+        return Kind::skip(p, end, name);
+    }
+    static value_type read(const char *p, const char *end, const char *origin) {
+        if (!*p)
+            return std::nullopt;
+        return Kind::read(p + 1, end, origin);
+    }
+};
+
+template <typename Bundle> class BundleView;
+template <typename Bundle> class ArrayView;
+template <typename Kind> class PackedView;
+
+// Boolean prefixed bundle
+template <typename Bundle> struct OptionalBundle {
+    using value_type = std::optional<BundleView<Bundle>>;
+    static constexpr size_t width = 0;
+
+    static bool skip(const char *&p, const char *end, const char *name) {
+        if (!detail::need(p, end, 1, name))
+            return false;
+        if (!*(p++))
+            return true;
+        return BundleView<Bundle>::skip(p, end);
+    }
+    static value_type read(const char *p, const char *end, const char *origin) {
+        if (!*p)
+            return std::nullopt;
+        return BundleView<Bundle>(p + 1, end - p - 1, origin);
+    }
+};
+
+// Varint prefixed bundles
+template <typename Bundle> struct Array {
+    using value_type = ArrayView<Bundle>;
+    static constexpr size_t width = 0;
+
+    static bool skip(const char *&p, const char *end, const char *name) {
+        uint64_t count;
+        if (!detail::read_count(p, end, count, name))
+            return false;
+        for (uint64_t i = 0; i < count; i++) {
+            if (!BundleView<Bundle>::skip(p, end))
+                return false;
+        }
+        return true;
+    }
+    static value_type read(const char *p, const char *end, const char *origin) {
+        uint64_t count;
+        readVarStyle(&p, end, 32, &count);
+        return ArrayView<Bundle>(p, end, count, origin);
+    }
+};
+
+// Varint prefixed values. Element is a bundle with a single field, like Fixed<int32_t> or VarInt.
+template <typename Element> struct PackedArray {
+    using element = typename Element::_fields::template at<0>;
+    using value_type = PackedView<typename element::_kind>;
+    static constexpr size_t width = 0;
+
+    static bool skip(const char *&p, const char *end, const char *name) {
+        using Kind = typename element::_kind;
+        uint64_t count;
+        if (!detail::read_count(p, end, count, name))
+            return false;
+        if constexpr (Kind::width != 0) {
+            // All at once, failing at the first element that does not fit
+            if (static_cast<size_t>(end - p) < count * Kind::width) {
+                p += (end - p) / Kind::width * Kind::width;
+                SET_DECODE_ERROR(DECODE_ERROR_TRUNCATED, element::_name, p, 0, 0);
+                return false;
+            }
+            p += count * Kind::width;
+        } else {
+            for (uint64_t i = 0; i < count; i++) {
+                if (!Kind::skip(p, end, element::_name))
+                    return false;
+            }
+        }
+        return true;
+    }
+    static value_type read(const char *p, const char *end, const char *) {
+        uint64_t count;
+        readVarStyle(&p, end, 32, &count);
+        return value_type(p, end, count);
+    }
+};
+
+// Base of the tag type of every field. The tag also has the name of the field, in _name.
+template <typename Bundle, size_t Index, typename Kind> struct Field {
+    using _bundle = Bundle;
+    using _kind = Kind;
+    static constexpr size_t _index = Index;
+};
+
+template <typename... Fields> struct FieldList {
+    static constexpr size_t count = sizeof...(Fields);
+    template <size_t Index> using at = std::tuple_element_t<Index, std::tuple<Fields...>>;
+    static constexpr size_t widths[] = {Fields::_kind::width..., 0};
+    static constexpr detail::SkipFunction skippers[] = {&detail::skip_field<Fields>..., nullptr};
+
+    // How many fields are at constexpr offsets
+    static constexpr size_t fixed_count() {
+        size_t i = 0;
+        while (i < count && widths[i])
+            i++;
+        return i;
+    }
+    // Only for the first fixed_count() + 1 fields
+    static constexpr size_t offset(size_t index) {
+        size_t offset = 0;
+        for (size_t i = 0; i < index; i++)
+            offset += widths[i];
+        return offset;
+    }
+};
+
+template <typename Bundle> class BundleView {
+    using fields = typename Bundle::_fields;
+    static constexpr size_t FIXED_COUNT = fields::fixed_count();
+    static constexpr size_t FIXED_SIZE = fields::offset(FIXED_COUNT);
+
+  public:
+    // Views are cheap to make, nothing is looked at until a field is asked for.
+    // Frames are at most MAX_FRAME_SIZE, so size must fit in 32 bits.
+    BundleView(const char *buffer, size_t size) : BundleView(buffer, size, buffer) {}
+
+    // origin is where the packet starts, for the offsets of decode errors
+    BundleView(const char *buffer, size_t size, const char *origin)
+        : buffer_(buffer), end_(buffer + size), origin_(origin), scanned_(1) {
+        offsets_[0] = 0;
+    }
+
+    // Returns: false if the field, or one before it, is malformed (and sets error state)
+    template <typename F> bool get(typename F::_kind::value_type &out) {
+        static_assert(std::is_same<typename F::_bundle, Bundle>::value, "Field is not part of this packet");
+        constexpr size_t index = F::_index;
+        using Kind = typename F::_kind;
+
+        if constexpr (index < FIXED_COUNT) {
+            // Only a size check away, unless the packet is too short for it
+            constexpr size_t offset = fields::offset(index);
+            if (__builtin_expect(static_cast<size_t>(end_ - buffer_) >= offset + Kind::width, 1)) {
+                out = Kind::read(buffer_ + offset, buffer_ + offset + Kind::width, origin_);
+                return true;
+            }
+        }
+        if (!scan_to(index + 1))
+            return false;
+        out = Kind::read(buffer_ + offsets_[index], buffer_ + offsets_[index + 1], origin_);
+        return true;
+    }
+
+    // Checks every field, and that nothing comes after the last one.
+    // Returns: false if the packet is malformed (and sets error state)
+    bool validate() {
+        if (!scan_to(fields::count))
+            return false;
+        if (buffer_ + offsets_[fields::count] != end_) {
+            const char *p = buffer_ + offsets_[fields::count];
+            SET_DECODE_ERROR(DECODE_ERROR_TRAILING_BYTES, NULL, p, end_ - p, 0);
+            set_decode_error_origin(origin_);
+            return false;
+        }
+        return true;
+    }
+
+    const char *data() const { return buffer_; }
+    size_t size() const { return end_ - buffer_; }
+
+    // Moves p past a whole bundle
+    static bool skip(const char *&p, const char *end) {
+        for (size_t i = 0; i < fields::count; i++) {
+            if (!fields::skippers[i](p, end))
+                return false;
+        }
+        return true;
+    }
+
+  private:
+    // Makes sure the start of field index is known
+    bool scan_to(size_t index) {
+        if (FIXED_COUNT && scanned_ == 1 && static_cast<size_t>(end_ - buffer_) >= FIXED_SIZE) {
+            for (size_t i = 1; i <= FIXED_COUNT; i++)
+                offsets_[i] = fields::offset(i);
+            scanned_ = FIXED_COUNT + 1;
+        }
+        while (scanned_ <= index) {
+            const char *p = buffer_ + offsets_[scanned_ - 1];
+            if (!fields::skippers[scanned_ - 1](p, end_)) {
+                set_decode_error_origin(origin_);
+                return false;
+            }
+            offsets_[scanned_++] = p - buffer_;
+        }
+        return true;
+    }
+
+    const char *buffer_;
+    const char *end_;
+    const char *origin_;
+    // Where each field starts, for the first scanned_ of them.
+    // The one after the last field is where the bundle ends.
+    uint32_t offsets_[fields::count + 1];
+    uint32_t scanned_;
+};
+
+template <typename Packet> using PacketView = BundleView<Packet>;
+
+// Elements of an Array, one after the other. Only handed out once they have all been checked.
+template <typename Bundle> class ArrayView {
+  public:
+    ArrayView(const char *first, const char *end, uint32_t count, const char *origin)
+        : first_(first), end_(end), count_(count), origin_(origin) {}
+
+    class iterator {
+      public:
+        iterator(const char *p, const char *end, uint32_t left, const char *origin) : p_(p), end_(end), left_(left), origin_(origin) {
+            find_next();
+        }
+        BundleView<Bundle> operator*() const { return BundleView<Bundle>(p_, next_ - p_, origin_); }
+        iterator &operator++() {
+            p_ = next_;
+            left_--;
+            find_next();
+            return *this;
+        }
+        bool operator!=(const iterator &other) const { return left_ != other.left_; }
+
+      private:
+        void find_next() {
+            next_ = p_;
+            if (left_)
+                BundleView<Bundle>::skip(next_, end_);
+        }
+        const char *p_;
+        const char *next_;
+        const char *end_;
+        uint32_t left_;
+        const char *origin_;
+    };
+
+    uint32_t size() const { return count_; }
+    iterator begin() const { return iterator(first_, end_, count_, origin_); }
+    iterator end() const { return iterator(end_, end_, 0, origin_); }
+
+  private:
+    const char *first_;
+    const char *end_;
+    uint32_t count_;
+    const char *origin_;
+};
+
+// Values of a PackedArray. Fixed width ones can be indexed, varints only iterated over.
+template <typename Kind> class PackedView {
+  public:
+    using value_type = typename Kind::value_type;
+
+    PackedView(const char *first, const char *end, uint32_t count) : first_(first), end_(end), count_(count) {}
+
+    class iterator {
+      public:
+        iterator(const char *p, const char *end, uint32_t left) : p_(p), end_(end), left_(left) {}
+        value_type operator*() const { return Kind::read(p_, end_, nullptr); }
+        iterator &operator++() {
+            Kind::skip(p_, end_, nullptr);
+            left_--;
+            return *this;
+        }
+        bool operator!=(const iterator &other) const { return left_ != other.left_; }
+
+      private:
+        const char *p_;
+        const char *end_;
+        uint32_t left_;
+    };
+
+    uint32_t size() const { return count_; }
+    value_type operator[](uint32_t index) const {
+        static_assert(Kind::width != 0, "Only arrays of fixed width values can be indexed");
+        return Kind::read(first_ + static_cast<size_t>(index) * Kind::width, end_, nullptr);
+    }
+    iterator begin() const { return iterator(first_, end_, count_); }
+    iterator end() const { return iterator(end_, end_, 0); }
+
+  private:
+    const char *first_;
+    const char *end_;
+    uint32_t count_;
+};
+
+} // namespace packet_view
@@ -0,0 +1,163 @@
+#include "compression.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "datatypes.h"
+#include "error_handling.h"
+
+// Max size of a 32 bit varint
+#define MAX_VARINT_SIZE 5
+
+static void ensure_buffer(char **buffer, size_t *alloc, size_t size) {
+    if (size <= *alloc)
+        return;
+    size_t new_alloc = *alloc ? *alloc : 4096;
+    while (new_alloc < size)
+        new_alloc *= 2;
+    free(*buffer);
+    *buffer = malloc(new_alloc);
+    *alloc = new_alloc;
+}
+
+
+void packet_decompressor_init(struct PacketDecompressor *decompressor, int threshold) {
+    memset(decompressor, 0, sizeof(struct PacketDecompressor));
+    decompressor->threshold = threshold;
+    if (inflateInit(&decompressor->stream) != Z_OK) {
+        SET_ERROR_STATE(ERROR_TYPE_UNKNOWN, "Could not initialize zlib inflate stream");
+        exit_on_error();
+    }
+}
+
+void packet_decompressor_free(struct PacketDecompressor *decompressor) {
+    inflateEnd(&decompressor->stream);
+    free(decompressor->buffer);
+    memset(decompressor, 0, sizeof(struct PacketDecompressor));
+}
+
+int packet_decompress_frame(struct PacketDecompressor *decompressor, struct PacketFrame *frame) {
+    const char *itr = frame->data;
+    const char *end = frame->data + frame->size;
+
+    uint64_t value;
+    enum DecodeError error = decode_var_style(&itr, end, 32, &value);
+    if (error) {
+        SET_DECODE_ERROR(error, "data length", NULL, 0, 0);
+        return -1;
+    }
+    uint32_t data_length = value;
+
+    const char *packet = itr;
+    size_t packet_size = end - itr;
+    if (data_length != 0) {
+        if (data_length > MAX_UNCOMPRESSED_PACKET_SIZE) {
+            SET_DECODE_ERROR(DECODE_ERROR_TOO_LONG, "data length", NULL, MAX_UNCOMPRESSED_PACKET_SIZE, data_length);
+            return -1;
+        }
+        // The notchian server rejects these too, they should have been sent uncompressed
+        if ((int64_t) data_length < decompressor->threshold) {
+            SET_ERROR_STATE(ERROR_INVALID_PACKET, "Badly compressed packet, data length of %u is below the threshold of %d", data_length,
+                            decompressor->threshold);
+            return -1;
+        }
+        ensure_buffer(&decompressor->buffer, &decompressor->buffer_alloc, data_length);
+
+        z_stream *stream = &decompressor->stream;
+        inflateReset(stream);
+        stream->next_in = (Bytef *) itr;
+        stream->avail_in = end - itr;
+        stream->next_out = (Bytef *) decompressor->buffer;
+        stream->avail_out = data_length;
+        int res = inflate(stream, Z_FINISH);
+        if (res != Z_STREAM_END || stream->total_out != data_length) {
+            SET_ERROR_STATE(ERROR_INVALID_PACKET, "Compressed packet does not match its data length of %u (zlib: %d)", data_length, res);
+            return -1;
+        }
+        packet = decompressor->buffer;
+        packet_size = data_length;
+    }
+
+    if (packet_size == 0) {
+        SET_ERROR_STATE(ERROR_INVALID_PACKET, "Compressed frame has no packet id");
+        return -1;
+    }
+    const char *payload = packet;
+    error = decode_var_style(&payload, packet + packet_size, 32, &value);
+    if (error) {
+        SET_DECODE_ERROR(error, "packet id", NULL, 0, 0);
+        return -1;
+    }
+    frame->packet_id = (int) value;
+    frame->payload = payload;
+    frame->payload_size = packet_size - (payload - packet);
+    return 0;
+}
+
+
+void packet_compressor_init(struct PacketCompressor *compressor, int threshold, int level) {
+    memset(compressor, 0, sizeof(struct PacketCompressor));
+    compressor->threshold = threshold;
+    if (deflateInit(&compressor->stream, level) != Z_OK) {
+        SET_ERROR_STATE(ERROR_TYPE_UNKNOWN, "Could not initialize zlib deflate stream");
+        exit_on_error();
+    }
+}
+
+void packet_compressor_free(struct PacketCompressor *compressor) {
+    deflateEnd(&compressor->stream);
+    free(compressor->buffer);
+    memset(compressor, 0, sizeof(struct PacketCompressor));
+}
+
+int packet_compress(struct PacketCompressor *compressor, const char *packet, size_t size, const char **out, size_t *out_size) {
+    if (size > MAX_UNCOMPRESSED_PACKET_SIZE) {
+        SET_ERROR_STATE(ERROR_API_USAGE, "Packet too large to be sent: %zu", size);
+        return -1;
+    }
+    z_stream *stream = &compressor->stream;
+    bool compress = compressor->threshold >= 0 && size >= (size_t) compressor->threshold;
+    size_t bound = compress ? deflateBound(stream, size) : size;
+
+    // The body goes in first, at a fixed offset, then the prefixes are put
+    // right in front of it, so nothing has to be moved around afterwards.
+    size_t header = MAX_FRAME_PREFIX_SIZE + MAX_VARINT_SIZE;
+    ensure_buffer(&compressor->buffer, &compressor->buffer_alloc, header + bound);
+    char *body = compressor->buffer + header;
+    size_t body_size;
+    uint32_t data_length;
+
+    if (compress) {
+        deflateReset(stream);
+        stream->next_in = (Bytef *) packet;
+        stream->avail_in = size;
+        stream->next_out = (Bytef *) body;
+        stream->avail_out = bound;
+        if (deflate(stream, Z_FINISH) != Z_STREAM_END) {
+            SET_ERROR_STATE(ERROR_TYPE_UNKNOWN, "zlib failed to compress packet");
+            return -1;
+        }
+        body_size = stream->total_out;
+        data_length = size;
+    } else {
+        memcpy(body, packet, size);
+        body_size = size;
+        data_length = 0;
+    }
+
+    char *start = body - varStyleSize(data_length);
+    putVarStyle(start, data_length);
+
+    size_t frame_size = body + body_size - start;
+    if (frame_size > MAX_FRAME_SIZE) {
+        SET_ERROR_STATE(ERROR_API_USAGE, "Compressed packet does not fit in a frame: %zu", frame_size);
+        return -1;
+    }
+    start -= varStyleSize(frame_size);
+    putVarStyle(start, frame_size);
+
+    *out = start;
+    *out_size = body + body_size - start;
+    return 0;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <zlib.h>
+
+#include "framing.h"
+
+/*
+  Compressed packet format, used after the login "set compression" packet:
+    varint  frame length     (handled by the framer)
+    varint  data length      (0 if the rest is not compressed)
+    ...     zlib compressed (packet id + payload)
+
+  There is one of each of these per connection and direction. They keep their
+  z_stream and output buffer between packets, so nothing is set up or
+  allocated per packet once the buffer is large enough.
+*/
+
+// Largest uncompressed packet the notchian server accepts
+#define MAX_UNCOMPRESSED_PACKET_SIZE (8 * 1024 * 1024)
+
+struct PacketDecompressor {
+    z_stream stream;
+    // Same as the compressor's, compressed packets smaller than this are rejected
+    int threshold;
+    char *buffer;
+    size_t buffer_alloc;
+};
+
+struct PacketCompressor {
+    z_stream stream;
+    // Packets smaller than this are sent uncompressed, negative to never compress
+    int threshold;
+    char *buffer;
+    size_t buffer_alloc;
+};
+
+// threshold is the one from the set compression packet
+void packet_decompressor_init(struct PacketDecompressor *decompressor, int threshold);
+void packet_decompressor_free(struct PacketDecompressor *decompressor);
+
+// Fills in the packet id and payload of a frame read while compression is on.
+// The payload either points into the frame, or into the decompressor's buffer,
+// and is valid until the next call. It can be handed straight to deserialize_packet.
+// Returns: non zero on error, and sets error state
+int packet_decompress_frame(struct PacketDecompressor *decompressor, struct PacketFrame *frame);
+
+// level is a zlib compression level, like Z_DEFAULT_COMPRESSION
+void packet_compressor_init(struct PacketCompressor *compressor, int threshold, int level);
+void packet_compressor_free(struct PacketCompressor *compressor);
+
+// Turns an uncompressed packet (packet id + payload) into a complete compressed
+// frame, length prefix included. The output lives in the compressor's buffer,
+// and is valid until the next call.
+// Returns: non zero on error, and sets error state
+int packet_compress(struct PacketCompressor *compressor, const char *packet, size_t size, const char **out, size_t *out_size);
@@ -5,38 +5,94 @@
 #include <stdlib.h>
 #include <string.h>
 
-void writeBulkDataToBuffer(struct EncodeDataSegment **head_, const void *data, size_t size) {
-    struct EncodeDataSegment *head = *head_;
-    if (head->size + size > head->alloc) {
-        size_t alloc = DEFAULT_SEGMENT_ALLOC > size ? DEFAULT_SEGMENT_ALLOC : size;
-        head->next = malloc(sizeof(struct EncodeDataSegment) + alloc);
-        *head_ = head->next;
-        head = *head_;
+struct SegmentPool {
+    struct EncodeDataSegment *free[SEGMENT_SIZE_CLASSES];
+    int free_count[SEGMENT_SIZE_CLASSES];
+
+    // Average size of a freed chain, in bytes. 0 until the first one.
+    size_t typical_size;
+};
+static __thread struct SegmentPool segment_pool;
+
+// Smallest size class that fits size, SEGMENT_SIZE_CLASSES if none does
+static __always_inline int segment_size_class(size_t size) {
+    if (size <= DEFAULT_SEGMENT_ALLOC)
+        return 0;
+    if (size > MAX_POOLED_SEGMENT_ALLOC)
+        return SEGMENT_SIZE_CLASSES;
+    // DEFAULT_SEGMENT_ALLOC is 2^10
+    return 64 - __builtin_clzl(size - 1) - 10;
+}
 
-        head->alloc = alloc;
-        head->size = 0;
-        head->next = NULL;
+struct EncodeDataSegment *allocEncodeDataSegment(size_t size) {
+    int class = segment_size_class(size);
+    struct EncodeDataSegment *segment;
+    if (class < SEGMENT_SIZE_CLASSES && segment_pool.free[class]) {
+        segment = segment_pool.free[class];
+        segment_pool.free[class] = segment->next;
+        segment_pool.free_count[class]--;
+    } else {
+        size_t alloc = class < SEGMENT_SIZE_CLASSES ? (size_t) DEFAULT_SEGMENT_ALLOC << class : size;
+        segment = malloc(sizeof(struct EncodeDataSegment) + alloc);
+        segment->alloc = alloc;
     }
-    assert(head->next == NULL);
+    segment->size = 0;
+    segment->next = NULL;
+    return segment;
+}
 
-    memcpy(head->data + head->size, data, size);
-    head->size += size;
+struct EncodeDataSegment *makeEncodeDataSegmentRoot() {
+    // A bit of headroom over the average, so slightly larger packets still fit.
+    // Stays within the pooled sizes, larger packets just use a couple of segments.
+    size_t size = segment_pool.typical_size + segment_pool.typical_size / 4;
+    if (size > MAX_POOLED_SEGMENT_ALLOC)
+        size = MAX_POOLED_SEGMENT_ALLOC;
+    return allocEncodeDataSegment(size);
+}
+
+void freeEncodeDataSegment(struct EncodeDataSegment *root) {
+    size_t chain_size = 0;
+    while (root) {
+        struct EncodeDataSegment *next = root->next;
+        chain_size += root->size;
+
+        int class = segment_size_class(root->alloc);
+        if (class < SEGMENT_SIZE_CLASSES && root->alloc == (size_t) DEFAULT_SEGMENT_ALLOC << class &&
+            segment_pool.free_count[class] < SEGMENT_POOL_DEPTH) {
+            root->next = segment_pool.free[class];
+            segment_pool.free[class] = root;
+            segment_pool.free_count[class]++;
+        } else {
+            free(root);
+        }
+        root = next;
+    }
+
+    // Moving average, weighing the last chain by 1/8
+    if (segment_pool.typical_size == 0)
+        segment_pool.typical_size = chain_size;
+    else
+        segment_pool.typical_size = segment_pool.typical_size - segment_pool.typical_size / 8 + chain_size / 8;
 }
-void writeByteToBuffer(struct EncodeDataSegment **head_, char byte) {
-    struct EncodeDataSegment *head = *head_;
-    if (head->size + 1 > head->alloc) {
-        head->next = malloc(sizeof(struct EncodeDataSegment) + DEFAULT_SEGMENT_ALLOC);
-        *head_ = head->next;
-        head = *head_;
 
-        head->alloc = DEFAULT_SEGMENT_ALLOC;
-        head->size = 0;
-        head->next = NULL;
+void trimSegmentPool() {
+    for (int class = 0; class < SEGMENT_SIZE_CLASSES; class++) {
+        struct EncodeDataSegment *segment = segment_pool.free[class];
+        while (segment) {
+            struct EncodeDataSegment *next = segment->next;
+            free(segment);
+            segment = next;
+        }
+        segment_pool.free[class] = NULL;
+        segment_pool.free_count[class] = 0;
     }
-    assert(head->next == NULL);
-    head->data[head->size] = byte;
-    head->size += 1;
 }
+
+
+void writeBulkDataToBuffer(struct EncodeDataSegment **head_, const void *data, size_t size) {
+    memcpy(reserveBytesInBuffer(head_, size), data, size);
+}
+void writeByteToBuffer(struct EncodeDataSegment **head_, char byte) { *reserveBytesInBuffer(head_, 1) = byte; }
 struct CombinedDataSegment *combineSegments(struct EncodeDataSegment *root) {
     assert(root != NULL);
 
@@ -60,47 +116,118 @@ struct CombinedDataSegment *combineSegments(struct EncodeDataSegment *root) {
     return combined;
 }
 
+int segmentsToIovec(const struct SegmentCursor *cursor, struct iovec *iov, int max_iov) {
+    int count = 0;
+    size_t offset = cursor->offset;
+    for (struct EncodeDataSegment *head = cursor->segment; head && count < max_iov; head = head->next) {
+        if (head->size > offset) {
+            iov[count].iov_base = head->data + offset;
+            iov[count].iov_len = head->size - offset;
+            count++;
+        }
+        offset = 0;
+    }
+    return count;
+}
+
+void advanceSegmentCursor(struct SegmentCursor *cursor, size_t size) {
+    while (cursor->segment) {
+        size_t left = cursor->segment->size - cursor->offset;
+        if (size < left) {
+            cursor->offset += size;
+            return;
+        }
+        // Also steps over empty segments, so a finished chain always ends up at NULL
+        size -= left;
+        cursor->segment = cursor->segment->next;
+        cursor->offset = 0;
+    }
+    assert(size == 0);
+}
+
+int writeSegments(int fd, struct SegmentCursor *cursor) {
+    struct iovec iov[SEGMENT_IOV_BATCH];
+    while (1) {
+        int count = segmentsToIovec(cursor, iov, SEGMENT_IOV_BATCH);
+        if (count == 0) {
+            cursor->segment = NULL;
+            return 1;
+        }
+        ssize_t written = writev(fd, iov, count);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 0;
+            return -1;
+        }
+        advanceSegmentCursor(cursor, written);
+    }
+}
+
 
 // Adapted from https://minecraft.wiki/w/Minecraft_Wiki:Projects/wiki.vg_merge/Protocol#VarInt_and_VarLong
-static char SEGMENT_BITS = 0x7F;
-static char CONTINUE_BIT = 0x80;
+static const unsigned char SEGMENT_BITS = 0x7F;
+static const unsigned char CONTINUE_BIT = 0x80;
 
-// Reads an arbitrary sized varint from a buffer.
-// Sets errno on error. ENOMEM for out of bounds read, EINVAL for going past max bits
-unsigned long readVarStyle(const char **buffer_, const char *maxBuffer, char maxBits) {
-    unsigned long value = 0;
+enum VarStyleStatus _readVarStyleSlow(const char **buffer_, const char *maxBuffer, char maxBits, uint64_t *out) {
+    uint64_t value = 0;
     int position = 0;
 
     const char *buffer = *buffer_;
 
     while (1) {
-        char current = *(buffer++);
-        value |= (current & SEGMENT_BITS) << position;
+        if (buffer >= maxBuffer)
+            return VAR_STYLE_TRUNCATED;
+        unsigned char current = *(buffer++);
+        value |= (uint64_t) (current & SEGMENT_BITS) << position;
 
         if ((current & CONTINUE_BIT) == 0)
             break;
-        if (buffer >= maxBuffer) {
-            errno = ENOMEM;
-            return -1;
-        }
 
         position += 7;
 
-        if (position >= maxBits) {
-            errno = EINVAL;
-            return -1;
-        }
+        if (position >= maxBits)
+            return VAR_STYLE_TOO_LONG;
     }
     *buffer_ = buffer;
-    return value;
+    *out = value;
+    return VAR_STYLE_OK;
 }
 void writeVarStyle(struct EncodeDataSegment **head_, unsigned long value) {
-    while (1) {
-        if ((value & ~SEGMENT_BITS) == 0) {
-            writeByteToBuffer(head_, value);
-            return;
-        }
-        writeByteToBuffer(head_, (value & SEGMENT_BITS) | CONTINUE_BIT);
-        value >>= 7;
+    struct EncodeDataSegment *head = *head_;
+    // Common case, enough room for a wide store (of even the longest varlong) without moving on
+    if (__builtin_expect(head->alloc - head->size >= MAX_VAR_STYLE_SIZE, 1)) {
+        head->size = putVarStyleWide(head->data + head->size, value) - head->data;
+        return;
+    }
+    putVarStyle(reserveBytesInBuffer(head_, varStyleSize(value)), value);
+}
+
+char *reserveBytesInBuffer(struct EncodeDataSegment **head_, size_t size) {
+    struct EncodeDataSegment *head = *head_;
+    if (head->size + size > head->alloc) {
+        // Sized like the segment before it (at least what the pool prefers), unless that one was oversized
+        size_t alloc = head->alloc < MAX_POOLED_SEGMENT_ALLOC ? head->alloc : MAX_POOLED_SEGMENT_ALLOC;
+        head->next = allocEncodeDataSegment(alloc > size ? alloc : size);
+        *head_ = head->next;
+        head = *head_;
     }
+    assert(head->next == NULL);
+
+    char *ret = head->data + head->size;
+    head->size += size;
+    return ret;
+}
+
+struct VarStylePrefix reserveVarStylePrefix(struct EncodeDataSegment **head_, int size) {
+    reserveBytesInBuffer(head_, size);
+    return (struct VarStylePrefix) {.segment = *head_, .offset = (*head_)->size - size, .size = size};
+}
+
+int finishVarStylePrefix(struct VarStylePrefix prefix) {
+    size_t written = prefix.segment->size - prefix.offset - prefix.size;
+    for (struct EncodeDataSegment *segment = prefix.segment->next; segment; segment = segment->next)
+        written += segment->size;
+    return putVarStylePadded(prefix.segment->data + prefix.offset, written, prefix.size);
 }
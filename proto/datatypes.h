@@ -1,14 +1,40 @@
 #pragma once
 
+#include <endian.h>
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
 
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+
+// Longest varint, a 64 bit varlong
+#define MAX_VAR_STYLE_SIZE 10
 
 #define DEFAULT_SEGMENT_ALLOC 1024
 
+/*
+  Segments come out of a per thread pool, rather than straight from malloc.
+  Segment sizes are powers of two, from DEFAULT_SEGMENT_ALLOC up to
+  MAX_POOLED_SEGMENT_ALLOC, each with their own free list of up to
+  SEGMENT_POOL_DEPTH segments. Anything larger goes back to malloc.
+
+  The pool also keeps a running average of how large chains end up being
+  once they are freed, and hands out segments of that size from then on, so
+  the usual packet fits into a single segment.
+*/
+#define MAX_POOLED_SEGMENT_ALLOC (64 * 1024)
+#define SEGMENT_SIZE_CLASSES 7 // log2(MAX_POOLED_SEGMENT_ALLOC / DEFAULT_SEGMENT_ALLOC) + 1
+#define SEGMENT_POOL_DEPTH 32
+
 struct EncodeDataSegment {
-    // Most of the time DEFAULT_SEGMENT_ALLOC
-    // but can be larger
+    // Size class of the pool, or larger for
+    // a single big write
     size_t alloc;
     size_t size;
 
@@ -22,25 +48,189 @@ struct CombinedDataSegment {
 void writeBulkDataToBuffer(struct EncodeDataSegment **head, const void *data, size_t size);
 void writeByteToBuffer(struct EncodeDataSegment **head_, char byte);
 
-static inline struct EncodeDataSegment *makeEncodeDataSegmentRoot() {
-    struct EncodeDataSegment *root = malloc(sizeof(struct EncodeDataSegment) + DEFAULT_SEGMENT_ALLOC);
-    root->alloc = DEFAULT_SEGMENT_ALLOC;
-    root->size = 0;
-    root->next = NULL;
+// A single empty segment with room for at least size bytes, from the pool
+struct EncodeDataSegment *allocEncodeDataSegment(size_t size);
+
+// Start of a new chain, sized after what chains usually grow to
+struct EncodeDataSegment *makeEncodeDataSegmentRoot();
+
+// Gives every segment of a chain back to the pool
+void freeEncodeDataSegment(struct EncodeDataSegment *root);
+
+// Frees the segments pooled by the calling thread, like before it exits
+void trimSegmentPool();
+
+struct CombinedDataSegment *combineSegments(struct EncodeDataSegment *root);
+
+// How far into a segment chain has been written out so far. Lets the chain
+// be handed to writev directly, instead of being combined into one buffer first.
+struct SegmentCursor {
+    struct EncodeDataSegment *segment;
+    size_t offset; // Into segment->data
+};
+
+// iovecs handed to writev in one go, by writeSegments
+#define SEGMENT_IOV_BATCH 64
 
-    return root;
+static inline struct SegmentCursor makeSegmentCursor(struct EncodeDataSegment *root) {
+    return (struct SegmentCursor) {.segment = root, .offset = 0};
 }
-static inline void freeEncodeDataSegment(struct EncodeDataSegment *root) {
-    while (root) {
-        struct EncodeDataSegment *next = root->next;
-        free(root);
-        root = next;
-    }
+static inline bool segmentCursorDone(const struct SegmentCursor *cursor) { return cursor->segment == NULL; }
+
+// Fills iov with what is left of the chain after the cursor, skipping empty segments
+// Returns: entries used, at most max_iov. 0 once everything is written.
+int segmentsToIovec(const struct SegmentCursor *cursor, struct iovec *iov, int max_iov);
+
+// Moves the cursor forward by size bytes, like after a (partial) write of them
+void advanceSegmentCursor(struct SegmentCursor *cursor, size_t size);
+
+// Writes the chain after the cursor to fd with writev, picking up where
+// partial writes left off, and moves the cursor along.
+// Returns: 1 once everything is written, 0 if a non blocking fd is full (call
+// again once it is writable), -1 with errno set on error
+int writeSegments(int fd, struct SegmentCursor *cursor);
+
+
+enum VarStyleStatus {
+    VAR_STYLE_OK = 0,
+    // The buffer ended before the varint did
+    VAR_STYLE_TRUNCATED,
+    // Longer than maxBits allows
+    VAR_STYLE_TOO_LONG,
+};
+
+// Bounds checked byte at a time version of readVarStyle, for the end of a buffer
+enum VarStyleStatus _readVarStyleSlow(const char **buffer, const char *maxBuffer, char maxBits, uint64_t *out);
+
+// Packs the low 7 bits of every byte of x together
+static __always_inline uint64_t _varStyleGather(uint64_t x) {
+#ifdef __BMI2__
+    return _pext_u64(x, 0x7F7F7F7F7F7F7F7FULL);
+#else
+    x = ((x & 0x7F007F007F007F00ULL) >> 1) | (x & 0x007F007F007F007FULL);
+    x = ((x & 0x3FFF00003FFF0000ULL) >> 2) | (x & 0x00003FFF00003FFFULL);
+    x = ((x & 0x0FFFFFFF00000000ULL) >> 4) | (x & 0x000000000FFFFFFFULL);
+    return x;
+#endif
 }
 
+// Reads an arbitrary sized varint from a buffer into out.
+// On error neither the buffer nor out are touched.
+//
+// Whenever 8 bytes are left this is a single load: the terminating byte is the
+// first one without its high bit set, and everything up to it gets packed together.
+static __always_inline enum VarStyleStatus readVarStyle(const char **buffer, const char *maxBuffer, char maxBits, uint64_t *out) {
+    if (__builtin_expect(maxBuffer - *buffer < 8, 0))
+        return _readVarStyleSlow(buffer, maxBuffer, maxBits, out);
 
-struct CombinedDataSegment *combineSegments(struct EncodeDataSegment *root);
+    uint64_t raw;
+    memcpy(&raw, *buffer, sizeof(raw));
+    raw = le64toh(raw);
 
+    uint64_t stops = ~raw & 0x8080808080808080ULL;
+    // Only varlongs can be longer than 8 bytes
+    if (__builtin_expect(!stops, 0))
+        return _readVarStyleSlow(buffer, maxBuffer, maxBits, out);
 
-unsigned long readVarStyle(const char **buffer, const char *maxBuffer, char maxBits);
+    int size = (__builtin_ctzll(stops) + 1) / 8;
+    if (__builtin_expect(size * 7 - 7 >= maxBits, 0))
+        return VAR_STYLE_TOO_LONG;
+    // Everything past the terminating byte is masked away
+    uint64_t used = size == 8 ? raw : raw & ((1ULL << (size * 8)) - 1);
+    *buffer += size;
+    *out = _varStyleGather(used);
+    return VAR_STYLE_OK;
+}
 void writeVarStyle(struct EncodeDataSegment **head_, unsigned long value);
+
+// Makes sure the head segment has size contiguous bytes free, moving on to a
+// new segment if it does not, and claims them.
+// Returns: where to write those bytes
+char *reserveBytesInBuffer(struct EncodeDataSegment **head_, size_t size);
+
+// Bytes writeVarStyle would use for value. Varints must be cast to uint32_t
+// first, so negative ones are 5 bytes rather than 10.
+static __always_inline int varStyleSize(unsigned long value) { return (63 - __builtin_clzl(value | 1)) / 7 + 1; }
+
+// Spreads 7 bit groups out into bytes, the opposite of _varStyleGather.
+// Only the low 56 bits of x are used.
+static __always_inline uint64_t _varStyleScatter(uint64_t x) {
+#ifdef __BMI2__
+    return _pdep_u64(x, 0x7F7F7F7F7F7F7F7FULL);
+#else
+    x = ((x & 0x00FFFFFFF0000000ULL) << 4) | (x & 0x000000000FFFFFFFULL);
+    x = ((x & 0x0FFFC0000FFFC000ULL) << 2) | (x & 0x00003FFF00003FFFULL);
+    x = ((x & 0x3F803F803F803F80ULL) << 1) | (x & 0x007F007F007F007FULL);
+    return x;
+#endif
+}
+// value, encoded into size bytes, little endian. value must fit in 7 * size bits,
+// and size be at most 8. Smaller values are padded out with empty groups.
+static __always_inline uint64_t _varStyleEncode(unsigned long value, int size) {
+    uint64_t continues = 0x8080808080808080ULL & ((1ULL << (size * 8 - 8)) - 1);
+    return htole64(_varStyleScatter(value) | continues);
+}
+
+// Writes value to dst with a single 8 byte store. dst must have 8 bytes of
+// room (MAX_VAR_STYLE_SIZE for values of 2^56 and up), even though only
+// varStyleSize(value) of them end up mattering.
+// Returns: the end of the varint
+static __always_inline char *putVarStyleWide(char *dst, unsigned long value) {
+    int size = varStyleSize(value);
+    if (__builtin_expect(size > 8, 0)) {
+        // Large varlongs, first 8 groups, then the rest
+        uint64_t head = _varStyleEncode(value, 8) | htole64(0x80ULL << 56);
+        memcpy(dst, &head, sizeof(head));
+        dst += 8;
+        value >>= 56;
+        *(dst++) = (value & 0x7F) | (value > 0x7F ? 0x80 : 0);
+        if (value > 0x7F)
+            *(dst++) = value >> 7;
+        return dst;
+    }
+    uint64_t encoded = _varStyleEncode(value, size);
+    memcpy(dst, &encoded, sizeof(encoded));
+    return dst + size;
+}
+
+// Writes value to dst, which must have room for varStyleSize(value) bytes
+// Returns: the end of what was written
+static __always_inline char *putVarStyle(char *dst, unsigned long value) {
+    int size = varStyleSize(value);
+    if (__builtin_expect(size > 8, 0)) {
+        char wide[16];
+        putVarStyleWide(wide, value);
+        memcpy(dst, wide, size);
+        return dst + size;
+    }
+    uint64_t encoded = _varStyleEncode(value, size);
+    memcpy(dst, &encoded, size);
+    return dst + size;
+}
+
+// Writes value into exactly size bytes, padding it out with empty groups if
+// needed. Returns: non zero if it does not fit.
+static __always_inline int putVarStylePadded(char *dst, unsigned long value, int size) {
+    if (size < 1 || size > 8 || varStyleSize(value) > size)
+        return -1;
+    uint64_t encoded = _varStyleEncode(value, size);
+    memcpy(dst, &encoded, size);
+    return 0;
+}
+
+// A length prefix written before the length is known, see reserveVarStylePrefix
+struct VarStylePrefix {
+    struct EncodeDataSegment *segment;
+    size_t offset;
+    int size;
+};
+
+// Reserves size bytes for a varint counting everything written after it,
+// like the length prefix of a packet (MAX_FRAME_PREFIX_SIZE bytes). The body
+// is then written straight after it, and the prefix filled in at the end
+// with finishVarStylePrefix, so no second buffer or copy is needed.
+struct VarStylePrefix reserveVarStylePrefix(struct EncodeDataSegment **head_, int size);
+
+// Fills in the prefix with the amount of bytes written after it
+// Returns: non zero if that amount does not fit in the reserved size
+int finishVarStylePrefix(struct VarStylePrefix prefix);
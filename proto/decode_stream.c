@@ -0,0 +1,333 @@
+#include "decode_stream.h"
+
+
+#include "datatypes.h"
+#include "error_handling.h"
+
+enum StepResult {
+    // The op is fully decoded
+    STEP_DONE,
+    // Moved on to something else, but the op is not done yet (pushed a frame, or into an optional)
+    STEP_AGAIN,
+    STEP_NEED_MORE,
+    STEP_ERROR,
+};
+
+static __always_inline void take(struct PacketDecodeStream *stream, const char **itr, size_t size) {
+    *itr += size;
+    stream->left -= size;
+}
+
+static PacketNode *new_bundle(struct PacketDecodeStream *stream, const struct DecodePlan *plan) {
+    PacketNode *bundle = PN_new_bundle_sized_in(stream->options.arena, plan->op_count);
+    // Same slot layout as _deserialize_plan, see PacketFieldHandle
+    bundle->__data->bundle.size = plan->op_count;
+    return bundle;
+}
+
+static int push_frame(struct PacketDecodeStream *stream, const struct DecodePlan *plan, PacketNode *bundle, PacketNode *list,
+                      uint32_t remaining) {
+    if (stream->depth >= MAX_PACKET_NESTING) {
+        SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "Packet too deeply nested to continue. Please increase MAX_PACKET_NESTING");
+        return -1;
+    }
+    stream->stack[stream->depth++] = (struct DecodeStreamFrame) {
+            .plan = plan,
+            .bundle = bundle,
+            .op = 0,
+            .list = list,
+            .remaining = remaining,
+    };
+    stream->current = NULL;
+    return 0;
+}
+
+// Collects a fixed width field (width > 0), or a varint (width == 0).
+// Returns: its bytes once they are all there, otherwise NULL. *size is set to how many there are.
+static const char *gather(struct PacketDecodeStream *stream, const char **itr, const char *end, int width, int *size) {
+    if (stream->partial_size == 0) {
+        // Usual case, the whole field is in this feed
+        size_t available = end - *itr;
+        const char *start = *itr;
+        if (width) {
+            if (available >= (size_t) width) {
+                take(stream, itr, width);
+                *size = width;
+                return start;
+            }
+        } else {
+            size_t max = available < MAX_VAR_STYLE_SIZE ? available : MAX_VAR_STYLE_SIZE;
+            for (size_t i = 0; i < max; i++) {
+                if (!(start[i] & 0x80)) {
+                    take(stream, itr, i + 1);
+                    *size = i + 1;
+                    return start;
+                }
+            }
+            if (max == MAX_VAR_STYLE_SIZE) {
+                // Too long, leave it to readVarStyle to complain
+                take(stream, itr, max);
+                *size = max;
+                return start;
+            }
+        }
+    }
+
+    while (*itr < end) {
+        char current = **itr;
+        take(stream, itr, 1);
+        stream->partial[stream->partial_size++] = current;
+
+        bool complete = width ? stream->partial_size == width : !(current & 0x80) || stream->partial_size == MAX_VAR_STYLE_SIZE;
+        if (complete) {
+            *size = stream->partial_size;
+            stream->partial_size = 0;
+            return stream->partial;
+        }
+    }
+    return NULL;
+}
+
+// Out of bytes for the op. Only an error when the packet has none left to give.
+static enum StepResult need_more(struct PacketDecodeStream *stream, const struct PlanOp *op) {
+    if (stream->left == 0) {
+        SET_DECODE_ERROR(DECODE_ERROR_TRUNCATED, plan_op_name(op), NULL, 0, 0);
+        return STEP_ERROR;
+    }
+    return STEP_NEED_MORE;
+}
+
+static enum StepResult read_var_style(struct PacketDecodeStream *stream, const struct PlanOp *op, const char **itr, const char *end,
+                                      uint32_t *out) {
+    int size;
+    const char *bytes = gather(stream, itr, end, 0, &size);
+    if (!bytes)
+        return need_more(stream, op);
+    uint64_t value;
+    enum DecodeError error = decode_var_style(&bytes, bytes + size, 32, &value);
+    if (error) {
+        SET_DECODE_ERROR(error, plan_op_name(op), NULL, 0, 0);
+        return STEP_ERROR;
+    }
+    *out = value;
+    return STEP_DONE;
+}
+
+// Binary containers are copied in as they arrive, rather than gathered
+static enum StepResult step_container(struct PacketDecodeStream *stream, const struct PlanOp *op, struct DecodeStreamFrame *frame,
+                                      const char **itr, const char *end) {
+    if (!stream->container) {
+        uint32_t size;
+        if (op->opcode == PO_REMAINING_BYTES) {
+            size = stream->left;
+        } else {
+            enum StepResult res = read_var_style(stream, op, itr, end, &size);
+            if (res != STEP_DONE)
+                return res;
+        }
+        if (op->max_length != PLAN_NO_MAX_LENGTH && size > op->max_length) {
+            SET_DECODE_ERROR(DECODE_ERROR_TOO_LONG, plan_op_name(op), NULL, op->max_length, size);
+            return STEP_ERROR;
+        }
+        if (size > stream->left) {
+            SET_DECODE_ERROR(DECODE_ERROR_TRUNCATED, plan_op_name(op), NULL, 0, 0);
+            return STEP_ERROR;
+        }
+
+        PacketNode *node = _plan_node(op, stream->options.arena, sizeof(node->__data->contents));
+        _PN_new_contents_in(stream->options.arena, node, size);
+        frame->bundle->__data->bundle.fields[frame->op] = node;
+        stream->container = node;
+        stream->container_filled = 0;
+    }
+
+    struct PacketBufferContents *contents = stream->container->__data->contents;
+    size_t copied = contents->size - stream->container_filled;
+    if (copied > (size_t) (end - *itr))
+        copied = end - *itr;
+    memcpy(contents->data + stream->container_filled, *itr, copied);
+    take(stream, itr, copied);
+    stream->container_filled += copied;
+
+    if (stream->container_filled < contents->size)
+        return need_more(stream, op);
+    stream->container = NULL;
+    return STEP_DONE;
+}
+
+static enum StepResult step(struct PacketDecodeStream *stream, const struct PlanOp *op, struct DecodeStreamFrame *frame, const char **itr,
+                            const char *end) {
+    switch (op->opcode) {
+        case PO_BOOLEAN:
+        case PO_BYTE:
+        case PO_UBYTE:
+        case PO_SHORT:
+        case PO_USHORT:
+        case PO_INT:
+        case PO_UINT:
+        case PO_LONG:
+        case PO_ULONG:
+        case PO_UUID:
+        case PO_VARINT:
+        case PO_VARLONG: {
+            int size;
+            const char *bytes = gather(stream, itr, end, op->width, &size);
+            if (!bytes)
+                return need_more(stream, op);
+            if (!frame->bundle) {
+                // Element of a packed array
+                union __PacketNodeData value;
+                if (_deserialize_value(op, &bytes, bytes + size, &value))
+                    return STEP_ERROR;
+                PN_packed_list_append(frame->list, &value);
+                return STEP_DONE;
+            }
+            // Once all the bytes are there, this is no different from a whole packet
+            if (_deserialize_op(op, frame->op, frame->bundle, NULL, stream->depth, &bytes, bytes + size, &stream->options))
+                return STEP_ERROR;
+            return STEP_DONE;
+        }
+        case PO_STRING:
+        case PO_PREFIXED_BYTE_ARRAY:
+        case PO_REMAINING_BYTES:
+            return step_container(stream, op, frame, itr, end);
+        case PO_OPTIONAL:
+        case PO_OPTIONAL_BUNDLE: {
+            int size;
+            const char *is_present = gather(stream, itr, end, 1, &size);
+            if (!is_present)
+                return need_more(stream, op);
+            if (!*is_present)
+                return STEP_DONE;
+
+            const struct DecodePlan *sub = plan_op_sub_plan(op);
+            if (op->opcode == PO_OPTIONAL) {
+                // Shares same context
+                stream->current = sub->ops;
+                return STEP_AGAIN;
+            }
+            PacketNode *contents = new_bundle(stream, sub);
+            contents->full_hash = op->name_hash;
+            memcpy(contents->name, plan_op_name(op), op->name_len + 1);
+            frame->bundle->__data->bundle.fields[frame->op] = contents;
+            return push_frame(stream, sub, contents, NULL, 0) ? STEP_ERROR : STEP_AGAIN;
+        }
+        case PO_PREFIXED_ARRAY:
+        case PO_PACKED_ARRAY: {
+            uint32_t count;
+            enum StepResult res = read_var_style(stream, op, itr, end, &count);
+            if (res != STEP_DONE)
+                return res;
+            if (count > MAX_DECODED_LIST_SIZE) {
+                SET_DECODE_ERROR(DECODE_ERROR_TOO_MANY_ELEMENTS, plan_op_name(op), NULL, count, MAX_DECODED_LIST_SIZE);
+                return STEP_ERROR;
+            }
+            const struct DecodePlan *sub = plan_op_sub_plan(op);
+            enum NodeType element_type = op->opcode == PO_PACKED_ARRAY ? sub->ops->node_type : NT_LIST;
+            int capacity = count < stream->left ? count : stream->left;
+            PacketNode *list = _plan_list(op, stream->options.arena, element_type, capacity);
+            frame->bundle->__data->bundle.fields[frame->op] = list;
+            if (count == 0)
+                return STEP_DONE;
+
+            // Packed elements go straight into the list, the frame has no bundle
+            if (op->opcode == PO_PACKED_ARRAY)
+                return push_frame(stream, sub, NULL, list, count - 1) ? STEP_ERROR : STEP_AGAIN;
+            PacketNode *element = new_bundle(stream, sub);
+            PN_list_append(list, element);
+            return push_frame(stream, sub, element, list, count - 1) ? STEP_ERROR : STEP_AGAIN;
+        }
+        default:
+            SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "Unknown plan opcode: %d", op->opcode);
+            return STEP_ERROR;
+    }
+}
+
+
+int packet_decode_stream_begin(struct PacketDecodeStream *stream, const struct PacketDeclaration *packet, size_t size,
+                               const struct DecodeOptions *options) {
+    memset(stream, 0, sizeof(struct PacketDecodeStream));
+    if (!packet->plan) {
+        SET_ERROR_STATE(ERROR_API_USAGE, "Packet declaration has not been compiled, use create_version_serde");
+        return -1;
+    }
+    stream->options = *options;
+    stream->options.flags &= ~DECODE_ZERO_COPY;
+    stream->size = size;
+    stream->left = size;
+    return push_frame(stream, packet->plan, new_bundle(stream, packet->plan), NULL, 0);
+}
+
+void packet_decode_stream_abort(struct PacketDecodeStream *stream) {
+    if (stream->depth)
+        PN_free(stream->stack[0].bundle);
+    stream->depth = 0;
+}
+
+enum DecodeStreamResult packet_decode_stream_feed(struct PacketDecodeStream *stream, const char *data, size_t size, size_t *consumed) {
+    const char *itr = data;
+    const char *end = data + (size < stream->left ? size : stream->left);
+    enum DecodeStreamResult result;
+
+    if (!stream->depth) {
+        SET_ERROR_STATE(ERROR_API_USAGE, "Decode stream is not decoding a packet");
+        *consumed = 0;
+        return DECODE_STREAM_ERROR;
+    }
+
+    while (1) {
+        struct DecodeStreamFrame *frame = &stream->stack[stream->depth - 1];
+
+        if (frame->op == frame->plan->op_count) {
+            // Bundle is complete, on to the next array element if there is one
+            if (frame->list && frame->remaining) {
+                frame->remaining--;
+                frame->op = 0;
+                if (!PN_list_is_packed(frame->list)) {
+                    frame->bundle = new_bundle(stream, frame->plan);
+                    PN_list_append(frame->list, frame->bundle);
+                }
+                continue;
+            }
+            stream->depth--;
+            if (stream->depth == 0) {
+                if (stream->left) {
+                    SET_DECODE_ERROR(DECODE_ERROR_TRAILING_BYTES, NULL, NULL, stream->left, 0);
+                    stream->depth = 1;
+                    goto error;
+                }
+                stream->result = frame->bundle;
+                result = DECODE_STREAM_DONE;
+                break;
+            }
+            // Finishes the op of the parent that pushed this frame
+            stream->stack[stream->depth - 1].op++;
+            stream->current = NULL;
+            continue;
+        }
+
+        if (!stream->current)
+            stream->current = &frame->plan->ops[frame->op];
+        enum StepResult res = step(stream, stream->current, frame, &itr, end);
+        if (res == STEP_DONE) {
+            frame->op++;
+            stream->current = NULL;
+        } else if (res == STEP_NEED_MORE) {
+            result = DECODE_STREAM_NEED_MORE;
+            break;
+        } else if (res == STEP_ERROR) {
+            goto error;
+        }
+    }
+
+    *consumed = itr - data;
+    return result;
+
+error:
+    // Fields can span feeds, so rather than a position, errors get where the stream got to
+    if (global_error_state && global_error_state->decode_error)
+        global_error_state->offset = stream->size - stream->left;
+    packet_decode_stream_abort(stream);
+    *consumed = itr - data;
+    return DECODE_STREAM_ERROR;
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "serde.h"
+
+/*
+  Incremental version of deserialize_packet, for packets that arrive in
+  pieces. Rather than waiting for (and buffering) the whole packet, bytes are
+  fed in as they are read, and decoding picks up right where the last feed
+  ran out: the position in the decode plan, the stack of bundles being filled
+  in, and whatever part of a field was already there.
+
+  Fixed width fields and varints spanning two feeds are stashed in a small
+  buffer. Strings and byte arrays are copied straight into their node as they
+  come in, so a multi megabyte field never exists twice.
+
+  The size of the packet (everything after the packet id) must be known up
+  front, like from the length prefix, as remaining_bytes fields depend on it.
+  DECODE_ZERO_COPY is ignored, there is no single buffer to point into.
+*/
+
+enum DecodeStreamResult {
+    // stream->result holds the packet, and belongs to the caller
+    DECODE_STREAM_DONE = 0,
+    // Every fed byte has been consumed
+    DECODE_STREAM_NEED_MORE,
+    // Packet is invalid, error state is set and the partial tree is freed
+    DECODE_STREAM_ERROR,
+};
+
+// A bundle being filled in
+struct DecodeStreamFrame {
+    const struct DecodePlan *plan;
+    PacketNode *bundle;
+    // Next op of plan to decode
+    uint32_t op;
+
+    // When decoding the elements of a prefixed array: the list, and how many
+    // elements still come after this one. list is NULL otherwise.
+    // Packed arrays have no bundle, each element is added to the list as it is read.
+    PacketNode *list;
+    uint32_t remaining;
+};
+
+struct PacketDecodeStream {
+    struct DecodeOptions options;
+    // Size of the packet, and the bytes of it not fed yet
+    size_t size;
+    size_t left;
+
+    struct DecodeStreamFrame stack[MAX_PACKET_NESTING];
+    int depth;
+
+    // Op being decoded into the slot of the top frame's op. Only differs from
+    // that op once the presence byte of a PO_OPTIONAL has been read.
+    const struct PlanOp *current;
+
+    // Fixed width field, or varint, spanning two feeds. The largest is a uuid.
+    char partial[16];
+    int partial_size;
+
+    // String or byte array being copied into, and how much of it already is
+    PacketNode *container;
+    size_t container_filled;
+
+    PacketNode *result;
+};
+
+// Starts decoding a packet of size bytes. The options are copied.
+// Returns: non zero on error, and sets error state
+int packet_decode_stream_begin(struct PacketDecodeStream *stream, const struct PacketDeclaration *packet, size_t size,
+                               const struct DecodeOptions *options);
+
+// Hands the next bytes of the packet to the decoder. Anything past the end of
+// the packet is left alone, consumed is set to how much was used.
+enum DecodeStreamResult packet_decode_stream_feed(struct PacketDecodeStream *stream, const char *data, size_t size, size_t *consumed);
+
+// Frees the partial tree of a packet that will never be finished, like when
+// the connection drops. Does nothing once DONE or ERROR was returned.
+void packet_decode_stream_abort(struct PacketDecodeStream *stream);
@@ -0,0 +1,227 @@
+#include "encryption.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAS_AESNI_PATH 1
+#endif
+
+static const uint8_t SBOX[256] = {
+        0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76, 0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59,
+        0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0, 0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1,
+        0x71, 0xd8, 0x31, 0x15, 0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75, 0x09, 0x83,
+        0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84, 0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b,
+        0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf, 0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c,
+        0x9f, 0xa8, 0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2, 0xcd, 0x0c, 0x13, 0xec,
+        0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73, 0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee,
+        0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb, 0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+        0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08, 0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6,
+        0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a, 0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9,
+        0x86, 0xc1, 0x1d, 0x9e, 0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf, 0x8c, 0xa1,
+        0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16,
+};
+
+static __always_inline uint8_t xtime(uint8_t x) { return (x << 1) ^ ((x >> 7) * 0x1b); }
+
+static void expand_key(struct CFB8Cipher *cipher, const uint8_t key[AES_BLOCK_SIZE]) {
+    uint8_t *w = &cipher->round_keys[0][0];
+    memcpy(w, key, AES_BLOCK_SIZE);
+
+    uint8_t rcon = 1;
+    for (int i = 4; i < (AES_128_ROUNDS + 1) * 4; i++) {
+        uint8_t temp[4];
+        memcpy(temp, w + (i - 1) * 4, 4);
+        if (i % 4 == 0) {
+            // RotWord, SubWord, Rcon
+            uint8_t first = temp[0];
+            temp[0] = SBOX[temp[1]] ^ rcon;
+            temp[1] = SBOX[temp[2]];
+            temp[2] = SBOX[temp[3]];
+            temp[3] = SBOX[first];
+            rcon = xtime(rcon);
+        }
+        for (int b = 0; b < 4; b++)
+            w[i * 4 + b] = w[(i - 4) * 4 + b] ^ temp[b];
+    }
+}
+
+// Plain byte oriented AES, for CPUs without AES-NI
+static void aes_encrypt_block(const struct CFB8Cipher *cipher, const uint8_t in[AES_BLOCK_SIZE], uint8_t out[AES_BLOCK_SIZE]) {
+    uint8_t s[AES_BLOCK_SIZE];
+    for (int i = 0; i < AES_BLOCK_SIZE; i++)
+        s[i] = in[i] ^ cipher->round_keys[0][i];
+
+    for (int round = 1; round <= AES_128_ROUNDS; round++) {
+        uint8_t t[AES_BLOCK_SIZE];
+        // SubBytes and ShiftRows, the state is column major
+        for (int c = 0; c < 4; c++)
+            for (int r = 0; r < 4; r++)
+                t[c * 4 + r] = SBOX[s[((c + r) % 4) * 4 + r]];
+
+        if (round != AES_128_ROUNDS) {
+            // MixColumns
+            for (int c = 0; c < 4; c++) {
+                uint8_t *col = &t[c * 4];
+                uint8_t all = col[0] ^ col[1] ^ col[2] ^ col[3];
+                uint8_t first = col[0];
+                col[0] ^= all ^ xtime(col[0] ^ col[1]);
+                col[1] ^= all ^ xtime(col[1] ^ col[2]);
+                col[2] ^= all ^ xtime(col[2] ^ col[3]);
+                col[3] ^= all ^ xtime(col[3] ^ first);
+            }
+        }
+        for (int i = 0; i < AES_BLOCK_SIZE; i++)
+            s[i] = t[i] ^ cipher->round_keys[round][i];
+    }
+    memcpy(out, s, AES_BLOCK_SIZE);
+}
+
+static void cfb8_portable(struct CFB8Cipher *cipher, char *data, size_t size, bool decrypt) {
+    uint8_t block[AES_BLOCK_SIZE];
+    for (size_t i = 0; i < size; i++) {
+        aes_encrypt_block(cipher, cipher->iv, block);
+        uint8_t in = data[i];
+        uint8_t out = in ^ block[0];
+        data[i] = out;
+
+        memmove(cipher->iv, cipher->iv + 1, AES_BLOCK_SIZE - 1);
+        cipher->iv[AES_BLOCK_SIZE - 1] = decrypt ? in : out;
+    }
+}
+
+
+#ifdef HAS_AESNI_PATH
+#define _AESNI __attribute__((target("aes,sse2")))
+
+#define _LOAD_KEYS()                                                                                                                       \
+    const __m128i k0 = _mm_load_si128((const __m128i *) cipher->round_keys[0]);                                                            \
+    const __m128i k1 = _mm_load_si128((const __m128i *) cipher->round_keys[1]);                                                            \
+    const __m128i k2 = _mm_load_si128((const __m128i *) cipher->round_keys[2]);                                                            \
+    const __m128i k3 = _mm_load_si128((const __m128i *) cipher->round_keys[3]);                                                            \
+    const __m128i k4 = _mm_load_si128((const __m128i *) cipher->round_keys[4]);                                                            \
+    const __m128i k5 = _mm_load_si128((const __m128i *) cipher->round_keys[5]);                                                            \
+    const __m128i k6 = _mm_load_si128((const __m128i *) cipher->round_keys[6]);                                                            \
+    const __m128i k7 = _mm_load_si128((const __m128i *) cipher->round_keys[7]);                                                            \
+    const __m128i k8 = _mm_load_si128((const __m128i *) cipher->round_keys[8]);                                                            \
+    const __m128i k9 = _mm_load_si128((const __m128i *) cipher->round_keys[9]);                                                            \
+    const __m128i k10 = _mm_load_si128((const __m128i *) cipher->round_keys[10]);
+
+#define _ENCRYPT(B)                                                                                                                        \
+    B = _mm_xor_si128(B, k0);                                                                                                              \
+    B = _mm_aesenc_si128(B, k1);                                                                                                           \
+    B = _mm_aesenc_si128(B, k2);                                                                                                           \
+    B = _mm_aesenc_si128(B, k3);                                                                                                           \
+    B = _mm_aesenc_si128(B, k4);                                                                                                           \
+    B = _mm_aesenc_si128(B, k5);                                                                                                           \
+    B = _mm_aesenc_si128(B, k6);                                                                                                           \
+    B = _mm_aesenc_si128(B, k7);                                                                                                           \
+    B = _mm_aesenc_si128(B, k8);                                                                                                           \
+    B = _mm_aesenc_si128(B, k9);                                                                                                           \
+    B = _mm_aesenclast_si128(B, k10);
+
+// The next register is the current one shifted down a byte, with the ciphertext byte at the top
+#define _SHIFT_IN(REG, BYTE) _mm_or_si128(_mm_srli_si128(REG, 1), _mm_slli_si128(_mm_cvtsi32_si128((uint8_t) (BYTE)), 15))
+
+_AESNI static void cfb8_encrypt_aesni(struct CFB8Cipher *cipher, char *data, size_t size) {
+    _LOAD_KEYS();
+    __m128i reg = _mm_loadu_si128((const __m128i *) cipher->iv);
+
+    // Every byte depends on the last, nothing to do but keep the chain short
+    for (size_t i = 0; i < size; i++) {
+        __m128i b = reg;
+        _ENCRYPT(b);
+        char out = data[i] ^ (char) _mm_cvtsi128_si32(b);
+        data[i] = out;
+        reg = _SHIFT_IN(reg, out);
+    }
+    _mm_storeu_si128((__m128i *) cipher->iv, reg);
+}
+
+_AESNI static void cfb8_decrypt_aesni(struct CFB8Cipher *cipher, char *data, size_t size) {
+    _LOAD_KEYS();
+
+    // The last 16 bytes of ciphertext, followed by the next 8. Each of the
+    // 8 registers for those next bytes is then just an unaligned load from it.
+    uint8_t window[AES_BLOCK_SIZE + 8];
+    memcpy(window, cipher->iv, AES_BLOCK_SIZE);
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        memcpy(window + AES_BLOCK_SIZE, data + i, 8);
+
+        __m128i b0 = _mm_loadu_si128((const __m128i *) (window + 0));
+        __m128i b1 = _mm_loadu_si128((const __m128i *) (window + 1));
+        __m128i b2 = _mm_loadu_si128((const __m128i *) (window + 2));
+        __m128i b3 = _mm_loadu_si128((const __m128i *) (window + 3));
+        __m128i b4 = _mm_loadu_si128((const __m128i *) (window + 4));
+        __m128i b5 = _mm_loadu_si128((const __m128i *) (window + 5));
+        __m128i b6 = _mm_loadu_si128((const __m128i *) (window + 6));
+        __m128i b7 = _mm_loadu_si128((const __m128i *) (window + 7));
+
+        // Independent of each other, so these all overlap in the pipeline
+        _ENCRYPT(b0);
+        _ENCRYPT(b1);
+        _ENCRYPT(b2);
+        _ENCRYPT(b3);
+        _ENCRYPT(b4);
+        _ENCRYPT(b5);
+        _ENCRYPT(b6);
+        _ENCRYPT(b7);
+
+        uint64_t keystream = (uint64_t) (uint8_t) _mm_cvtsi128_si32(b0) | (uint64_t) (uint8_t) _mm_cvtsi128_si32(b1) << 8 |
+                             (uint64_t) (uint8_t) _mm_cvtsi128_si32(b2) << 16 | (uint64_t) (uint8_t) _mm_cvtsi128_si32(b3) << 24 |
+                             (uint64_t) (uint8_t) _mm_cvtsi128_si32(b4) << 32 | (uint64_t) (uint8_t) _mm_cvtsi128_si32(b5) << 40 |
+                             (uint64_t) (uint8_t) _mm_cvtsi128_si32(b6) << 48 | (uint64_t) (uint8_t) _mm_cvtsi128_si32(b7) << 56;
+        uint64_t text;
+        memcpy(&text, data + i, 8);
+        text ^= keystream; // x86 is little endian, byte k of the word is byte k of the data
+        memcpy(data + i, &text, 8);
+
+        _mm_storeu_si128((__m128i *) window, _mm_loadu_si128((const __m128i *) (window + 8)));
+    }
+
+    __m128i reg = _mm_loadu_si128((const __m128i *) window);
+    for (; i < size; i++) {
+        __m128i b = reg;
+        _ENCRYPT(b);
+        char in = data[i];
+        data[i] = in ^ (char) _mm_cvtsi128_si32(b);
+        reg = _SHIFT_IN(reg, in);
+    }
+    _mm_storeu_si128((__m128i *) cipher->iv, reg);
+}
+#undef _SHIFT_IN
+#undef _ENCRYPT
+#undef _LOAD_KEYS
+#endif
+
+
+void cfb8_init(struct CFB8Cipher *cipher, const uint8_t key[AES_BLOCK_SIZE], const uint8_t iv[AES_BLOCK_SIZE]) {
+    memset(cipher, 0, sizeof(struct CFB8Cipher));
+    expand_key(cipher, key);
+    memcpy(cipher->iv, iv, AES_BLOCK_SIZE);
+#ifdef HAS_AESNI_PATH
+    cipher->use_aesni = __builtin_cpu_supports("aes");
+#endif
+}
+
+void cfb8_encrypt(struct CFB8Cipher *cipher, char *data, size_t size) {
+#ifdef HAS_AESNI_PATH
+    if (cipher->use_aesni) {
+        cfb8_encrypt_aesni(cipher, data, size);
+        return;
+    }
+#endif
+    cfb8_portable(cipher, data, size, false);
+}
+
+void cfb8_decrypt(struct CFB8Cipher *cipher, char *data, size_t size) {
+#ifdef HAS_AESNI_PATH
+    if (cipher->use_aesni) {
+        cfb8_decrypt_aesni(cipher, data, size);
+        return;
+    }
+#endif
+    cfb8_portable(cipher, data, size, true);
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+  AES-128-CFB8, as used for the whole stream once the "encryption response"
+  packet went through. Minecraft uses the shared secret as both the key and the
+  initial IV, and keeps one cipher going per direction for the connection.
+
+  Works in place, and never allocates. Uses AES-NI when the CPU has it.
+
+  CFB8 needs one AES block per byte. Encrypting is inherently serial, as every
+  block depends on the ciphertext byte before it. Decrypting is not, every
+  shift register is already known from the ciphertext, so 8 blocks are run
+  through AES-NI at once to keep its pipeline full.
+*/
+
+#define AES_BLOCK_SIZE 16
+#define AES_128_ROUNDS 10
+
+struct CFB8Cipher {
+    // Expanded key, same layout for AES-NI and the portable fallback
+    uint8_t round_keys[AES_128_ROUNDS + 1][AES_BLOCK_SIZE] __attribute__((aligned(16)));
+
+    // Shift register, the last 16 bytes of ciphertext
+    uint8_t iv[AES_BLOCK_SIZE];
+
+    bool use_aesni;
+};
+
+void cfb8_init(struct CFB8Cipher *cipher, const uint8_t key[AES_BLOCK_SIZE], const uint8_t iv[AES_BLOCK_SIZE]);
+
+void cfb8_encrypt(struct CFB8Cipher *cipher, char *data, size_t size);
+void cfb8_decrypt(struct CFB8Cipher *cipher, char *data, size_t size);
@@ -2,12 +2,51 @@
 #include <stdio.h>
 
 __thread struct GlobalErrorState *global_error_state = NULL;
+__thread struct GlobalErrorState _global_error_slot;
 
 
+static void format_decode_error(struct GlobalErrorState *state) {
+    const char *field = state->field ? state->field : "";
+    int len = 0;
+    switch (state->decode_error) {
+        case DECODE_ERROR_NONE:
+            return;
+        case DECODE_ERROR_TRUNCATED:
+            len = snprintf(state->message, sizeof(state->message) - 1, "Size is too small for \"%s\"", field);
+            break;
+        case DECODE_ERROR_BAD_VARINT:
+            len = snprintf(state->message, sizeof(state->message) - 1, "Varint too long in \"%s\"", field);
+            break;
+        case DECODE_ERROR_TOO_LONG:
+            len = snprintf(state->message, sizeof(state->message) - 1, "\"%s\" of max size %lld had size of %lld", field, state->args[0],
+                           state->args[1]);
+            break;
+        case DECODE_ERROR_TOO_MANY_ELEMENTS:
+            len = snprintf(state->message, sizeof(state->message) - 1, "\"%s\" has %lld elements, only %lld are supported", field,
+                           state->args[0], state->args[1]);
+            break;
+        case DECODE_ERROR_TRAILING_BYTES:
+            len = snprintf(state->message, sizeof(state->message) - 1, "Packet has %lld trailing bytes", state->args[0]);
+            break;
+    }
+    if (state->offset >= 0 && len >= 0 && (size_t) len < sizeof(state->message) - 1)
+        snprintf(state->message + len, sizeof(state->message) - 1 - len, " (at byte %zd)", state->offset);
+}
+
+const char *error_message() {
+    if (!global_error_state)
+        return NULL;
+    if (!global_error_state->formatted) {
+        format_decode_error(global_error_state);
+        global_error_state->formatted = true;
+    }
+    return global_error_state->message;
+}
+
 void exit_on_error() {
     if (!global_error_state)
         return;
     fprintf(stderr, "An unrecoverable error has occured (code: %d) in file %s on line %d:\n%s\n", global_error_state->type,
-            global_error_state->file_name, global_error_state->line, global_error_state->message);
+            global_error_state->file_name, global_error_state->line, error_message());
     exit(-1);
 }
@@ -1,36 +1,110 @@
 #pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <sys/types.h>
 
-// Only set if something has gone severly wrong
+#include "datatypes.h"
+
+// Only set if something has gone severly wrong. Always points at the
+// thread's own error slot, so setting an error never allocates.
 extern __thread struct GlobalErrorState *global_error_state;
+extern __thread struct GlobalErrorState _global_error_slot;
 
 enum ErrorType { ERROR_TYPE_UNKNOWN = 0, ERROR_INVALID_PACKET, ERROR_INVALID_PACKET_FORMAT, ERROR_API_USAGE };
 
-#define RESET_ERROR_STATE()                                                                                                                \
-    if (global_error_state) {                                                                                                              \
-        free(global_error_state);                                                                                                          \
-        global_error_state = NULL;                                                                                                         \
-    }
+// What went wrong while decoding, see SET_DECODE_ERROR. The meaning of
+// GlobalErrorState.args is given for each one.
+enum DecodeError {
+    // Not a decode error, the message was formatted right away
+    DECODE_ERROR_NONE = 0,
+    // A field runs past the end of the packet
+    DECODE_ERROR_TRUNCATED,
+    // A varint is longer than its type allows
+    DECODE_ERROR_BAD_VARINT,
+    // A container is over its max length. args: max length, size
+    DECODE_ERROR_TOO_LONG,
+    // An array has more elements than a node can hold. args: count, max count
+    DECODE_ERROR_TOO_MANY_ELEMENTS,
+    // Bytes are left over after the last field. args: how many
+    DECODE_ERROR_TRAILING_BYTES,
+};
+
+// readVarStyle, with a failure turned into the error every decoder reports for it
+// Returns: DECODE_ERROR_NONE if a varint was read into out
+static __always_inline enum DecodeError decode_var_style(const char **buffer, const char *max_buffer, char max_bits, uint64_t *out) {
+    enum VarStyleStatus status = readVarStyle(buffer, max_buffer, max_bits, out);
+    if (__builtin_expect(status == VAR_STYLE_OK, 1))
+        return DECODE_ERROR_NONE;
+    return status == VAR_STYLE_TRUNCATED ? DECODE_ERROR_TRUNCATED : DECODE_ERROR_BAD_VARINT;
+}
+
+#define RESET_ERROR_STATE() global_error_state = NULL
 
 #define SET_ERROR_STATE(ERR_TYPE, ERR_STR, ...)                                                                                            \
     {                                                                                                                                      \
-        RESET_ERROR_STATE();                                                                                                               \
-        global_error_state = calloc(1, sizeof(struct GlobalErrorState));                                                                   \
+        global_error_state = &_global_error_slot;                                                                                          \
         global_error_state->type = ERR_TYPE;                                                                                               \
         global_error_state->file_name = __FILE__;                                                                                          \
         global_error_state->line = __LINE__;                                                                                               \
+        global_error_state->decode_error = DECODE_ERROR_NONE;                                                                              \
+        global_error_state->formatted = true;                                                                                              \
         snprintf(global_error_state->message, sizeof(global_error_state->message) - 1, ERR_STR, ##__VA_ARGS__);                            \
     }
 
+// For the decode hot path, where garbage packets can come in by the thousand.
+// Only the error code, field name (which must outlive the error, like a plan
+// op name) and position in the buffer are stored. The message is formatted
+// when error_message is first called.
+#define SET_DECODE_ERROR(CODE, FIELD, POSITION, ARG0, ARG1)                                                                                \
+    {                                                                                                                                      \
+        global_error_state = &_global_error_slot;                                                                                          \
+        global_error_state->type = ERROR_INVALID_PACKET;                                                                                   \
+        global_error_state->file_name = __FILE__;                                                                                          \
+        global_error_state->line = __LINE__;                                                                                               \
+        global_error_state->decode_error = CODE;                                                                                           \
+        global_error_state->field = FIELD;                                                                                                 \
+        global_error_state->position = POSITION;                                                                                           \
+        global_error_state->offset = -1;                                                                                                   \
+        global_error_state->args[0] = ARG0;                                                                                                \
+        global_error_state->args[1] = ARG1;                                                                                                \
+        global_error_state->formatted = false;                                                                                             \
+    }
+
 
 void exit_on_error();
 
+// Message of the current error, formatting it first if needed. NULL if there is none.
+const char *error_message();
+
 
 struct GlobalErrorState {
+    // Only filled in once error_message is called
     char message[1024];
 
     const char *file_name;
     int line;
 
     enum ErrorType type;
+
+    enum DecodeError decode_error;
+    // Field being decoded, may be NULL
+    const char *field;
+    // Where in the buffer decoding failed, may be NULL. Entry points turn it
+    // into offset with set_decode_error_origin.
+    const char *position;
+    // Bytes into the packet decoding failed, -1 if not known
+    ssize_t offset;
+    long long args[2];
+
+    bool formatted;
 };
+
+// Called by decoding entry points with the start of the packet they were given
+static __always_inline void set_decode_error_origin(const char *start) {
+    if (global_error_state && global_error_state->decode_error && global_error_state->position) {
+        global_error_state->offset = global_error_state->position - start;
+        global_error_state->position = NULL;
+    }
+}
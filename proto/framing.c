@@ -0,0 +1,132 @@
+#include "framing.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "datatypes.h"
+#include "error_handling.h"
+
+void packet_framer_init(struct PacketFramer *framer) { memset(framer, 0, sizeof(struct PacketFramer)); }
+
+void packet_framer_free(struct PacketFramer *framer) {
+    free(framer->carry);
+    memset(framer, 0, sizeof(struct PacketFramer));
+}
+
+void packet_framer_feed(struct PacketFramer *framer, const char *data, size_t size) {
+    framer->input = data;
+    framer->input_end = data + size;
+}
+
+static enum FrameResult finish_frame(struct PacketFramer *framer, const char *data, size_t size, struct PacketFrame *frame) {
+    frame->data = data;
+    frame->size = size;
+
+    if (framer->compressed) {
+        frame->packet_id = -1;
+        frame->payload = NULL;
+        frame->payload_size = 0;
+        return FRAME_OK;
+    }
+
+    const char *payload = data;
+    uint64_t packet_id;
+    enum DecodeError error = decode_var_style(&payload, data + size, 32, &packet_id);
+    if (error) {
+        SET_DECODE_ERROR(error, "packet id", NULL, 0, 0);
+        return FRAME_ERROR;
+    }
+    frame->packet_id = (int) packet_id;
+    frame->payload = payload;
+    frame->payload_size = size - (payload - data);
+    return FRAME_OK;
+}
+
+// Reads the length prefix, from whatever of it was already stashed away and the current input.
+// Returns: FRAME_OK with size set, FRAME_NEED_MORE if all of the input was stashed.
+static enum FrameResult read_prefix(struct PacketFramer *framer, size_t *size) {
+    char prefix[MAX_FRAME_PREFIX_SIZE];
+    int prefix_size = framer->prefix_size;
+    memcpy(prefix, framer->prefix, prefix_size);
+
+    size_t available = framer->input_end - framer->input;
+    size_t taken = MAX_FRAME_PREFIX_SIZE - prefix_size;
+    if (taken > available)
+        taken = available;
+    memcpy(prefix + prefix_size, framer->input, taken);
+
+    const char *itr = prefix;
+    uint64_t length = 0;
+    enum VarStyleStatus status = readVarStyle(&itr, prefix + prefix_size + taken, 21, &length);
+    if (status == VAR_STYLE_TRUNCATED && prefix_size + taken < MAX_FRAME_PREFIX_SIZE) {
+        // Ran out of bytes
+        memcpy(framer->prefix, prefix, prefix_size + taken);
+        framer->prefix_size = prefix_size + taken;
+        framer->input += taken;
+        return FRAME_NEED_MORE;
+    }
+    if (status) {
+        // Even a truncated one is too long by now, as the whole prefix is there
+        SET_DECODE_ERROR(DECODE_ERROR_BAD_VARINT, "frame length", NULL, 0, 0);
+        return FRAME_ERROR;
+    }
+    if (length == 0) {
+        // Frames always start with a packet id
+        SET_DECODE_ERROR(DECODE_ERROR_TRUNCATED, "packet id", NULL, 0, 0);
+        return FRAME_ERROR;
+    }
+    *size = length;
+    framer->input += (itr - prefix) - prefix_size;
+    framer->prefix_size = 0;
+    return FRAME_OK;
+}
+
+enum FrameResult packet_framer_next(struct PacketFramer *framer, struct PacketFrame *frame) {
+    size_t available = framer->input_end - framer->input;
+
+    // Finish off a frame spanning feeds first
+    if (framer->carry_needed) {
+        size_t taken = framer->carry_needed - framer->carry_size;
+        if (taken > available)
+            taken = available;
+        memcpy(framer->carry + framer->carry_size, framer->input, taken);
+        framer->carry_size += taken;
+        framer->input += taken;
+        if (framer->carry_size < framer->carry_needed)
+            return FRAME_NEED_MORE;
+
+        framer->carry_needed = 0;
+        return finish_frame(framer, framer->carry, framer->carry_size, frame);
+    }
+
+    if (!available)
+        return FRAME_NEED_MORE;
+
+    size_t size;
+    enum FrameResult res = read_prefix(framer, &size);
+    if (res != FRAME_OK)
+        return res;
+
+    available = framer->input_end - framer->input;
+    if (size <= available) {
+        // Common case, entire frame in one read
+        const char *data = framer->input;
+        framer->input += size;
+        return finish_frame(framer, data, size, frame);
+    }
+
+    if (size > framer->carry_alloc) {
+        size_t alloc = framer->carry_alloc ? framer->carry_alloc : 4096;
+        while (alloc < size)
+            alloc *= 2;
+        free(framer->carry);
+        framer->carry = malloc(alloc);
+        framer->carry_alloc = alloc;
+    }
+    memcpy(framer->carry, framer->input, available);
+    framer->carry_size = available;
+    framer->carry_needed = size;
+    framer->input += available;
+    return FRAME_NEED_MORE;
+}
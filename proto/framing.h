@@ -0,0 +1,66 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+  Splits a TCP byte stream into length prefixed minecraft packets.
+
+  Data is handed over with packet_framer_feed, in whatever pieces it was
+  read in, then packet_framer_next is called until it returns FRAME_NEED_MORE.
+  Frames fully inside of the fed data are returned as views into it, without
+  any copying. Only frames spanning two feeds are copied, once, into a carry
+  buffer owned by the framer.
+*/
+
+// The length prefix is at most a 3 byte varint
+#define MAX_FRAME_PREFIX_SIZE 3
+#define MAX_FRAME_SIZE ((1 << 21) - 1)
+
+enum FrameResult {
+    FRAME_OK = 0,
+    // Every fed byte has been consumed
+    FRAME_NEED_MORE,
+    // Stream is corrupt, error state is set. The framer can not be used anymore.
+    FRAME_ERROR,
+};
+
+// Valid until the next call to packet_framer_next or packet_framer_feed,
+// and for as long as the fed buffer is.
+struct PacketFrame {
+    // Everything after the length prefix
+    const char *data;
+    size_t size;
+
+    // Not set (-1 and NULL) for compressed frames, see packet_decompress_frame
+    int packet_id;
+    // Everything after the packet id
+    const char *payload;
+    size_t payload_size;
+};
+
+struct PacketFramer {
+    // What is left of the last feed
+    const char *input;
+    const char *input_end;
+
+    // Length prefix spanning two feeds
+    char prefix[MAX_FRAME_PREFIX_SIZE];
+    int prefix_size;
+
+    // Frame spanning two feeds. carry_needed is the full size of that frame, 0 if there is none.
+    char *carry;
+    size_t carry_size;
+    size_t carry_alloc;
+    size_t carry_needed;
+
+    // Set once the "set compression" packet went by. The packet id is then
+    // hidden inside of the compressed data.
+    bool compressed;
+};
+
+void packet_framer_init(struct PacketFramer *framer);
+void packet_framer_free(struct PacketFramer *framer);
+
+// The framer does not copy data, it must stay valid until FRAME_NEED_MORE is returned
+void packet_framer_feed(struct PacketFramer *framer, const char *data, size_t size);
+enum FrameResult packet_framer_next(struct PacketFramer *framer, struct PacketFrame *frame);
@@ -0,0 +1,108 @@
+#include "lazy_packet.h"
+
+#include "error_handling.h"
+
+int lazy_packet_init(struct LazyPacket *lazy, const struct PacketDeclaration *packet, const char *buffer, size_t size,
+                     const struct DecodeOptions *options) {
+    if (!packet->plan) {
+        SET_ERROR_STATE(ERROR_API_USAGE, "Packet declaration has not been compiled, use create_version_serde");
+        return -1;
+    }
+    if (packet->plan->op_count > MAX_LAZY_FIELDS) {
+        SET_ERROR_STATE(ERROR_API_USAGE, "Packet \"%s\" has too many fields to be lazily decoded", packet->name);
+        return -1;
+    }
+    if (size > UINT32_MAX) {
+        SET_ERROR_STATE(ERROR_API_USAGE, "Packet too large to be lazily decoded: %zu", size);
+        return -1;
+    }
+    lazy->packet = packet;
+    lazy->buffer = buffer;
+    lazy->size = size;
+    lazy->options = *options;
+    lazy->options.projection = NULL;
+    lazy->offsets[0] = 0;
+    lazy->scanned = 1;
+    memset(lazy->decoded, 0, sizeof(lazy->decoded));
+    lazy->bundle = NULL;
+    return 0;
+}
+
+// Makes sure the start of a field is known, by skipping over the ones before it
+static int scan_to(struct LazyPacket *lazy, uint32_t slot) {
+    const struct DecodePlan *plan = lazy->packet->plan;
+    while (lazy->scanned <= slot) {
+        uint32_t last = lazy->scanned - 1;
+        const char *buffer = lazy->buffer + lazy->offsets[last];
+        if (_skip_op(&plan->ops[last], &buffer, lazy->buffer + lazy->size, 0)) {
+            set_decode_error_origin(lazy->buffer);
+            return -1;
+        }
+        lazy->offsets[lazy->scanned++] = buffer - lazy->buffer;
+    }
+    return 0;
+}
+
+// Returns: non zero on error, and sets error state
+static int decode_field(struct LazyPacket *lazy, uint32_t slot) {
+    const struct DecodePlan *plan = lazy->packet->plan;
+    if (!lazy->bundle) {
+        lazy->bundle = PN_new_bundle_sized_in(lazy->options.arena, plan->op_count);
+        lazy->bundle->__data->bundle.size = plan->op_count;
+    }
+    if ((lazy->decoded[slot / 64] >> (slot % 64)) & 1)
+        return 0;
+    if (scan_to(lazy, slot))
+        return -1;
+
+    PacketNode *parents[MAX_PACKET_NESTING] = {0};
+    const char *buffer = lazy->buffer + lazy->offsets[slot];
+    if (_deserialize_op(&plan->ops[slot], slot, lazy->bundle, parents, 0, &buffer, lazy->buffer + lazy->size, &lazy->options)) {
+        set_decode_error_origin(lazy->buffer);
+        return -1;
+    }
+    lazy->decoded[slot / 64] |= 1ULL << (slot % 64);
+
+    // Decoding found the end of the field for free
+    if (lazy->scanned == slot + 1)
+        lazy->offsets[lazy->scanned++] = buffer - lazy->buffer;
+    return 0;
+}
+
+PacketNode *lazy_packet_get(struct LazyPacket *lazy, PacketFieldHandle handle) {
+    const struct DecodePlan *plan = lazy->packet->plan;
+    if (handle.slot < 0 || (uint32_t) handle.slot >= plan->op_count || plan->ops[handle.slot].name_hash != handle.name_hash) {
+        SET_ERROR_STATE(ERROR_API_USAGE, "Field handle with slot %d is not for packet \"%s\"", handle.slot, lazy->packet->name);
+        return NULL;
+    }
+    if (decode_field(lazy, handle.slot))
+        return NULL;
+    return lazy->bundle->__data->bundle.fields[handle.slot];
+}
+
+PacketNode *lazy_packet_tree(struct LazyPacket *lazy) {
+    const struct DecodePlan *plan = lazy->packet->plan;
+    for (uint32_t i = 0; i < plan->op_count; i++) {
+        if (decode_field(lazy, i))
+            return NULL;
+    }
+    if (!lazy->bundle)
+        lazy->bundle = PN_new_bundle_sized_in(lazy->options.arena, 0);
+
+    // The last field was decoded in order, so where the packet ends is known
+    if (scan_to(lazy, plan->op_count))
+        return NULL;
+    if (lazy->offsets[plan->op_count] != lazy->size) {
+        uint32_t end = lazy->offsets[plan->op_count];
+        SET_DECODE_ERROR(DECODE_ERROR_TRAILING_BYTES, NULL, lazy->buffer + end, lazy->size - end, 0);
+        set_decode_error_origin(lazy->buffer);
+        return NULL;
+    }
+    return lazy->bundle;
+}
+
+void lazy_packet_free(struct LazyPacket *lazy) {
+    if (lazy->bundle)
+        PN_free(lazy->bundle);
+    lazy->bundle = NULL;
+}
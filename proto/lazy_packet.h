@@ -0,0 +1,54 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "serde.h"
+
+/*
+  Lazily decoded packet. Setting one up costs nothing, the buffer is not even
+  looked at. The first time a field is asked for, the packet is scanned up to
+  that field, only noting down where each field starts (skipping them the same
+  way projections do), and then that one field is decoded. Later fields
+  continue the scan from where it stopped, and fields already decoded are
+  just returned again.
+
+  Packets that are never looked at past their packet id cost nothing, ones
+  that are looked at once cost a length walk plus the fields actually used.
+
+  The buffer must outlive the lazy packet. Trailing bytes are only noticed
+  once the scan gets to the end, like with lazy_packet_tree.
+*/
+
+// Most top level fields a lazy packet can have
+#define MAX_LAZY_FIELDS 256
+
+struct LazyPacket {
+    const struct PacketDeclaration *packet;
+    const char *buffer;
+    size_t size;
+    struct DecodeOptions options;
+
+    // Where each top level field starts, for the first scanned ones.
+    // The one after the last field is where the packet ends.
+    uint32_t offsets[MAX_LAZY_FIELDS + 1];
+    uint32_t scanned;
+    // Bit per field, set once it has been decoded (absent optionals stay NULL)
+    uint64_t decoded[MAX_LAZY_FIELDS / 64];
+
+    // Has every decoded field in its slot, created on first access
+    PacketNode *bundle;
+};
+
+// Returns: non zero on error, and sets error state
+int lazy_packet_init(struct LazyPacket *lazy, const struct PacketDeclaration *packet, const char *buffer, size_t size,
+                     const struct DecodeOptions *options);
+
+// Decodes a top level field, if that has not happened yet. The node belongs to the lazy packet.
+// Returns: NULL for absent optionals, or on error (and sets error state)
+PacketNode *lazy_packet_get(struct LazyPacket *lazy, PacketFieldHandle handle);
+
+// Decodes every remaining field, and checks the packet has no trailing bytes.
+// Returns: the same bundle deserialize_packet would, which still belongs to the lazy packet. NULL on error.
+PacketNode *lazy_packet_tree(struct LazyPacket *lazy);
+
+// Frees whatever was decoded
+void lazy_packet_free(struct LazyPacket *lazy);
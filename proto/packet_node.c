@@ -1,5 +1,21 @@
 #include "packet_node.h"
 
+void PN_materialize_tree(PacketNode *node, struct Arena *arena) {
+    PN_materialize_in(arena, node);
+    if (node->type == NT_BUNDLE) {
+        for (int i = 0; i < node->__data->bundle.size; i++) {
+            if (node->__data->bundle.fields[i])
+                PN_materialize_tree(node->__data->bundle.fields[i], arena);
+        }
+    } else if (node->type == NT_LIST && !PN_list_is_packed(node)) {
+        for (int i = 0; i < node->list_size; i++) {
+            PacketNode *child = PN_list_get(node, i);
+            if (child)
+                PN_materialize_tree(child, arena);
+        }
+    }
+}
+
 // Print all the elements of a node tree
 // completely GPT generated as this is the boring part
 void PN_tree_(const PacketNode *node, int indent) {
@@ -15,6 +31,8 @@ void PN_tree_(const PacketNode *node, int indent) {
             break;
         case NT_LIST:
             printf("LIST");
+            if (PN_list_is_packed(node))
+                printf(" (packed, %d)", node->list_size);
             break;
         case NT_BOOLEAN:
             printf("BOOLEAN: %d", node->__data->boolean);
@@ -55,12 +73,19 @@ void PN_tree_(const PacketNode *node, int indent) {
         case NT_DOUBLE:
             printf("DOUBLE: %f", node->__data->double_);
             break;
-        case NT_STRING:
-            printf("STRING: \"%s\"", node->__data->contents->data);
+        case NT_STRING: {
+            size_t size;
+            const char *data = PN_get_bytes(node, &size);
+            printf("STRING: \"%.*s\"", (int) size, data);
             break;
+        }
         case NT_NBT:
-            printf("NBT: [binary, size=%zu]", node->__data->contents->size);
+        case NT_BYTE_ARRAY: {
+            size_t size;
+            PN_get_bytes(node, &size);
+            printf("%s: [binary, size=%zu]", node->type == NT_NBT ? "NBT" : "BYTE_ARRAY", size);
             break;
+        }
         case NT_POSITION:
             printf("POSITION: (%d, %d, %d)", node->__data->x, node->__data->y, node->__data->z);
             break;
@@ -79,17 +104,24 @@ void PN_tree_(const PacketNode *node, int indent) {
 
     // Recurse for composite types
     if (node->type == NT_BUNDLE) {
-        for (int i = 0; i < PACKET_NODE_COLLECTION_SIZE; i++) {
-            PacketNode *child = node->__data->hashmap[i];
-            while (child) {
-                PN_tree_(child, indent + 1);
-                child = child->_hashmap_next;
-            }
+        for (int i = 0; i < node->__data->bundle.size; i++) {
+            if (node->__data->bundle.fields[i])
+                PN_tree_(node->__data->bundle.fields[i], indent + 1);
+        }
+    } else if (node->type == NT_LIST && PN_list_is_packed(node)) {
+        // Print each value as if it were a node of its own
+        _Alignas(PacketNode) char storage[sizeof(PacketNode) + sizeof(union __PacketNodeData)] = {0};
+        PacketNode *element = (PacketNode *) storage;
+        element->type = node->__data->list.element_type;
+        for (int i = 0; i < node->list_size; i++) {
+            *element->__data = _PNL_value((PacketNode *) node, i);
+            PN_tree_(element, indent + 1);
         }
     } else if (node->type == NT_LIST) {
         for (int i = 0; i < node->list_size; i++) {
-            if (node->__data->children[i])
-                PN_tree_(node->__data->children[i], indent + 1);
+            PacketNode *child = PN_list_get((PacketNode *) node, i);
+            if (child)
+                PN_tree_(child, indent + 1);
         }
     }
 }
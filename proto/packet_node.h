@@ -1,16 +1,18 @@
 #pragma once
 #include <assert.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "arena.h"
 #include "constants.h"
 
 #include "xxhash.h"
 
 enum NodeType {
-    // Hashmap style dictionary
+    // Dictionary style, by name, see PNB_set
     NT_BUNDLE,
 
     NT_LIST,
@@ -50,25 +52,62 @@ struct MC_enumValue {
 };
 
 
-// Max size of both bundles AND lists
-#define PACKET_NODE_COLLECTION_SIZE 1024
+// Most elements a list decoded off the wire can have. Lists themselves grow as
+// needed, this only stops hostile counts (packets are at most 2 MB anyway).
+#define MAX_DECODED_LIST_SIZE (1 << 21)
+
+// Default field capacity of a bundle, when not known up front
+#define DEFAULT_BUNDLE_SIZE 8
+// Default element capacity of a list, when not known up front
+#define DEFAULT_LIST_SIZE 4
 struct PacketBufferContents {
     size_t size;
     char data[];
 };
 
+// Borrowed bytes, see PN_FLAG_VIEW
+struct PacketBufferView {
+    const char *data;
+    size_t size;
+};
+
+// Fields of a bundle, in insertion order. Initially points to storage
+// allocated right after this struct, see PN_new_bundle_sized_in.
+struct PacketBundleFields {
+    struct PacketNode_ **fields;
+    // Where to grow into, NULL for the heap
+    struct Arena *arena;
+    int size;
+    int alloc;
+};
+
+// Elements of a list, PacketNode.list_size of them. Initially points to
+// storage allocated right after this struct, see PN_new_list_sized_in.
+//
+// Packed lists (see PN_new_packed_list_sized_in) hold values instead of
+// nodes, element_size bytes each, laid out like the matching member of
+// union __PacketNodeData. Like an int32_t[] for a list of NT_INT.
+struct PacketListItems {
+    void *items;
+    // Where to grow into, NULL for the heap
+    struct Arena *arena;
+    int alloc;
+    // NT_LIST for lists of nodes, otherwise the type of every packed value
+    uint8_t element_type;
+    uint8_t element_size;
+};
+
 struct MC_uuid {
     uint64_t uuid_high;
     uint64_t uuid_low;
 };
 // Not malloced by itself
 union __PacketNodeData {
-    // For list type nodes:
-    //  NT_PACKET_LIST, TODO
-    struct PacketNode_ *children[PACKET_NODE_COLLECTION_SIZE];
+    // Used for: NT_LIST
+    struct PacketListItems list;
 
     // Used for: NT_BUNDLE
-    struct PacketNode_ *hashmap[PACKET_NODE_COLLECTION_SIZE];
+    struct PacketBundleFields bundle;
 
 
     uint8_t boolean;
@@ -100,6 +139,9 @@ union __PacketNodeData {
     // NT_STRING, NT_NBT
     struct PacketBufferContents *contents;
 
+    // Same as contents, but when PN_FLAG_VIEW is set
+    struct PacketBufferView view;
+
     // MC special position format NT_POSITION
     struct {
         int32_t x;
@@ -119,19 +161,32 @@ union __PacketNodeData {
 
 #define PACKET_KEY_NAME_LEN MAX_STRING_CONST_SIZE
 
+// Binary container node (NT_STRING, NT_NBT, NT_BYTE_ARRAY) that points into
+// somebody else's buffer rather than owning its contents. It is NOT null
+// terminated, and only valid for as long as that buffer is.
+// See PN_materialize for getting an owned copy.
+#define PN_FLAG_VIEW (1 << 0)
+// The node itself was allocated from an arena, and is released with it rather than by PN_free
+#define PN_FLAG_ARENA (1 << 1)
+// Same, but for the contents of a binary container node. Arena trees are never
+// PN_free-d, so anything that allocates contents for a PN_FLAG_ARENA node has to
+// take them from that same arena (PN_materialize_in), or they leak. The getters
+// never allocate for one, read those with PN_get_bytes.
+#define PN_FLAG_ARENA_CONTENTS (1 << 2)
+
 // Needs to be calloc-ed, otherwise name cannot be properly hashed
 struct PacketNode_ {
     char name[PACKET_KEY_NAME_LEN];
     enum NodeType type;
 
-    // Most of the time ignore this. It is only for hashmaps when
-    // a collision occurs
-    struct PacketNode_ *_hashmap_next;
     uint64_t full_hash;
 
     // Only used for lists
     int list_size;
 
+    // PN_FLAG_*
+    uint8_t flags;
+
 
     // ONLY WHAT YOU NEED IS PRESENT!
     // Holds the raw data for nodes
@@ -142,17 +197,29 @@ typedef struct PacketNode_ PacketNode;
 
 static __always_inline PacketNode *_PN_alloc(size_t data_size) { return calloc(1, sizeof(PacketNode) + data_size); }
 
-static __always_inline uint64_t PN_str_hash(const char *str) {
+// Allocates from the arena if one is given, otherwise the same as _PN_alloc
+static __always_inline PacketNode *_PN_alloc_in(struct Arena *arena, size_t data_size) {
+    if (!arena)
+        return _PN_alloc(data_size);
+    PacketNode *ret = arena_alloc(arena, sizeof(PacketNode) + data_size);
+    memset(ret, 0, sizeof(PacketNode) + data_size);
+    ret->flags = PN_FLAG_ARENA;
+    return ret;
+}
+
+// PN_str_hash, for a string that isn't null terminated
+static __always_inline uint64_t PN_str_hash_n(const char *str, size_t size) {
     char temp[PACKET_KEY_NAME_LEN] = {0};
-    size_t size = strlen(str) + 1;
-    if (size >= PACKET_KEY_NAME_LEN) {
-        fprintf(stderr, "ERROR: name too long to fit in packet node key: \"%s\"\n", str);
+    if (size + 1 >= PACKET_KEY_NAME_LEN) {
+        fprintf(stderr, "ERROR: name too long to fit in packet node key: \"%.*s\"\n", (int) size, str);
         exit(1);
     }
     memcpy(temp, str, size);
     return XXH64(temp, PACKET_KEY_NAME_LEN, 0);
 }
 
+static __always_inline uint64_t PN_str_hash(const char *str) { return PN_str_hash_n(str, strlen(str)); }
+
 static __always_inline PacketNode *PN_rename(PacketNode *node, const char *name) {
     node->full_hash = PN_str_hash(name);
     strncpy(node->name, name, PACKET_KEY_NAME_LEN - 1);
@@ -167,127 +234,345 @@ static __always_inline PacketNode *PN_from_string(const char *name) {
     ret->type = NT_STRING;
     ret->__data->contents = contents;
 
-    contents->size = size;
+    // Same as decoded strings, the size does not count the null terminator
+    contents->size = size - 1;
     memcpy(contents->data, name, size);
     return ret;
 }
+
+// Gives a binary container node room for size bytes, plus a null terminator
+// so strings can be used directly. Arena may be NULL.
+static __always_inline struct PacketBufferContents *_PN_new_contents_in(struct Arena *arena, PacketNode *node, size_t size) {
+    size_t alloc = 1 + size + sizeof(struct PacketBufferContents);
+    struct PacketBufferContents *contents = arena ? arena_alloc(arena, alloc) : malloc(alloc);
+    contents->size = size;
+    contents->data[size] = '\0';
+
+    node->__data->contents = contents;
+    node->flags &= ~PN_FLAG_VIEW;
+    if (arena)
+        node->flags |= PN_FLAG_ARENA_CONTENTS;
+    return contents;
+}
+
+// Turns a view node into one that owns its contents. Does nothing for any other node.
+// Nodes living in an arena should be materialized into that same arena.
+static __always_inline void PN_materialize_in(struct Arena *arena, PacketNode *node) {
+    if (!(node->flags & PN_FLAG_VIEW))
+        return;
+    struct PacketBufferView view = node->__data->view;
+    memcpy(_PN_new_contents_in(arena, node, view.size)->data, view.data, view.size);
+}
+static __always_inline void PN_materialize(PacketNode *node) { PN_materialize_in(NULL, node); }
+
+// PN_materialize_in, for every node in a tree. Arena may be NULL.
+void PN_materialize_tree(PacketNode *node, struct Arena *arena);
+
+// Raw bytes of a binary container node, whether it is a view or not
+static __always_inline const char *PN_get_bytes(const PacketNode *node, size_t *size) {
+    assert(node->type == NT_STRING || node->type == NT_NBT || node->type == NT_BYTE_ARRAY);
+    if (node->flags & PN_FLAG_VIEW) {
+        *size = node->__data->view.size;
+        return node->__data->view.data;
+    }
+    *size = node->__data->contents->size;
+    return node->__data->contents->data;
+}
+
+// Views are materialized first, as they are not null terminated. The node does
+// not know which arena it came from, so views in an arena are left alone.
+// Returns: NULL for a view allocated from an arena, see PN_FLAG_ARENA_CONTENTS
 static __always_inline char *PN_get_string(PacketNode *node) {
     assert(node->type == NT_STRING);
+    if ((node->flags & PN_FLAG_VIEW) && (node->flags & PN_FLAG_ARENA))
+        return NULL;
+    PN_materialize(node);
     return node->__data->contents->data;
 }
+// Grows the contents with malloc, so not for nodes allocated from an arena
 static __always_inline void PN_set_string(PacketNode *node, const char *name) {
     assert(node->type == NT_STRING);
-    size_t old_size = node->__data->contents->size;
     size_t new_size = strlen(name) + 1;
 
-    if (old_size >= new_size) {
+    if (node->flags & PN_FLAG_VIEW) {
+        // Nothing to reuse, or free
+        node->flags &= ~PN_FLAG_VIEW;
+        node->__data->contents = NULL;
+    } else if (node->__data->contents->size + 1 >= new_size) {
         // Technically this leaves a bit of memory unused, so what!
-        node->__data->contents->size = new_size;
+        node->__data->contents->size = new_size - 1;
         memcpy(node->__data->contents->data, name, new_size);
         return;
     }
 
-    free(node->__data->contents);
+    if (!(node->flags & PN_FLAG_ARENA_CONTENTS))
+        free(node->__data->contents);
+    node->flags &= ~PN_FLAG_ARENA_CONTENTS;
     struct PacketBufferContents *contents = malloc(new_size + sizeof(struct PacketBufferContents));
-    contents->size = new_size;
+    contents->size = new_size - 1;
     memcpy(contents->data, name, new_size);
     node->__data->contents = contents;
 }
 
-static __always_inline PacketNode *PN_new_bundle() {
-    PacketNode *ret = _PN_alloc(sizeof(ret->__data->hashmap));
+static __always_inline PacketNode **_PNB_inline_fields(PacketNode *bundle) {
+    return (PacketNode **) (&bundle->__data->bundle + 1);
+}
+
+// Creates a bundle with room for field_count fields before it has to grow.
+// Schema decoded bundles know exactly how many they need.
+static __always_inline PacketNode *PN_new_bundle_sized_in(struct Arena *arena, int field_count) {
+    PacketNode *ret = _PN_alloc_in(arena, sizeof(struct PacketBundleFields) + field_count * sizeof(PacketNode *));
     ret->type = NT_BUNDLE;
+    ret->__data->bundle.fields = _PNB_inline_fields(ret);
+    ret->__data->bundle.arena = arena;
+    ret->__data->bundle.alloc = field_count;
 
     return ret;
 }
-static __always_inline PacketNode *PN_new_list() {
-    PacketNode *ret = _PN_alloc(sizeof(ret->__data->children));
-    ret->type = NT_LIST;
-    ret->list_size = 0;
-    return ret;
+static __always_inline PacketNode *PN_new_bundle_in(struct Arena *arena) { return PN_new_bundle_sized_in(arena, DEFAULT_BUNDLE_SIZE); }
+static __always_inline PacketNode *PN_new_bundle() { return PN_new_bundle_in(NULL); }
+
+// Bytes a value of a primitive type takes up in a node, or a packed list.
+// 0 for anything that can't be packed.
+static __always_inline size_t PN_value_size(enum NodeType type) {
+    switch (type) {
+        case NT_BOOLEAN:
+        case NT_BYTE:
+        case NT_UBYTE:
+            return 1;
+        case NT_SHORT:
+        case NT_USHORT:
+            return 2;
+        case NT_INT:
+        case NT_UINT:
+        case NT_VARINT:
+        case NT_FLOAT:
+            return 4;
+        case NT_LONG:
+        case NT_ULONG:
+        case NT_VARLONG:
+        case NT_DOUBLE:
+            return 8;
+        case NT_UUID:
+            return sizeof(struct MC_uuid);
+        default:
+            return 0;
+    }
 }
 
-static __always_inline void PN_list_append(PacketNode *list, PacketNode *child) {
+static __always_inline void *_PNL_inline_items(PacketNode *list) { return &list->__data->list + 1; }
+
+// Bytes each element of a list of element_type takes up, see PacketListItems
+static __always_inline size_t _PNL_element_size(enum NodeType element_type) {
+    return element_type == NT_LIST ? sizeof(PacketNode *) : PN_value_size(element_type);
+}
+
+// Node data size for a list with room for capacity elements of element_size bytes
+static __always_inline size_t _PNL_data_size(size_t element_size, int capacity) {
+    return sizeof(struct PacketListItems) + element_size * capacity;
+}
+
+// Sets up a node allocated with _PNL_data_size as a list
+static __always_inline PacketNode *_PNL_init(PacketNode *list, struct Arena *arena, enum NodeType element_type, int capacity) {
+    list->type = NT_LIST;
+    list->list_size = 0;
+    list->__data->list.items = _PNL_inline_items(list);
+    list->__data->list.arena = arena;
+    list->__data->list.alloc = capacity;
+    list->__data->list.element_type = element_type;
+    list->__data->list.element_size = _PNL_element_size(element_type);
+    return list;
+}
+
+// Creates a list of nodes with room for capacity elements before it has to grow
+static __always_inline PacketNode *PN_new_list_sized_in(struct Arena *arena, int capacity) {
+    return _PNL_init(_PN_alloc_in(arena, _PNL_data_size(_PNL_element_size(NT_LIST), capacity)), arena, NT_LIST, capacity);
+}
+static __always_inline PacketNode *PN_new_list_in(struct Arena *arena) { return PN_new_list_sized_in(arena, DEFAULT_LIST_SIZE); }
+static __always_inline PacketNode *PN_new_list() { return PN_new_list_in(NULL); }
+
+// Creates a list holding values of a primitive type directly, rather than a node for each
+static __always_inline PacketNode *PN_new_packed_list_sized_in(struct Arena *arena, enum NodeType element_type, int capacity) {
+    assert(PN_value_size(element_type));
+    return _PNL_init(_PN_alloc_in(arena, _PNL_data_size(PN_value_size(element_type), capacity)), arena, element_type, capacity);
+}
+static __always_inline PacketNode *PN_new_packed_list(enum NodeType element_type) {
+    return PN_new_packed_list_sized_in(NULL, element_type, DEFAULT_LIST_SIZE);
+}
+
+static __always_inline bool PN_list_is_packed(const PacketNode *list) {
     assert(list->type == NT_LIST);
-    assert(list->list_size < PACKET_NODE_COLLECTION_SIZE);
-    list->__data->children[list->list_size++] = child;
+    return list->__data->list.element_type != NT_LIST;
+}
+
+static inline void _PNL_grow(PacketNode *list) {
+    struct PacketListItems *items = &list->__data->list;
+    int alloc = items->alloc ? items->alloc * 2 : DEFAULT_LIST_SIZE;
+    void *grown;
+    if (items->arena) {
+        grown = arena_alloc(items->arena, (size_t) alloc * items->element_size);
+    } else {
+        grown = malloc((size_t) alloc * items->element_size);
+    }
+    memcpy(grown, items->items, (size_t) list->list_size * items->element_size);
+    if (items->items != _PNL_inline_items(list) && !items->arena)
+        free(items->items);
+    items->items = grown;
+    items->alloc = alloc;
+}
+
+// Makes room for one more element at the end of a list.
+// Returns: where it goes, element_size bytes
+static __always_inline void *_PNL_push(PacketNode *list) {
+    struct PacketListItems *items = &list->__data->list;
+    if (__builtin_expect(list->list_size == items->alloc, 0))
+        _PNL_grow(list);
+    return (char *) items->items + (size_t) list->list_size++ * items->element_size;
+}
+
+static __always_inline void PN_list_append(PacketNode *list, PacketNode *child) {
+    assert(!PN_list_is_packed(list));
+    *(PacketNode **) _PNL_push(list) = child;
 }
 
 static __always_inline PacketNode *PN_list_get(PacketNode *list, int index) {
-    assert(list->type == NT_LIST);
+    assert(!PN_list_is_packed(list));
     assert(index >= 0 && index < list->list_size);
-    return list->__data->children[index];
+    return ((PacketNode **) list->__data->list.items)[index];
 }
-static inline void PN_free(PacketNode *node) {
-    if (node->_hashmap_next)
-        PN_free(node->_hashmap_next);
 
+// Copies element_size bytes of value onto the end of a packed list
+static __always_inline void PN_packed_list_append(PacketNode *list, const void *value) {
+    assert(PN_list_is_packed(list));
+    memcpy(_PNL_push(list), value, list->__data->list.element_size);
+}
+
+// Every value of a packed list, back to back. Valid until the list grows.
+static __always_inline void *PN_packed_list_data(PacketNode *list) {
+    assert(PN_list_is_packed(list));
+    return list->__data->list.items;
+}
+
+// A value of a packed list, as if it were the data of a node of element_type.
+// Copied out, since packed values are not aligned the way the union is.
+static __always_inline union __PacketNodeData _PNL_value(PacketNode *list, int index) {
+    assert(index >= 0 && index < list->list_size);
+    union __PacketNodeData value;
+    memcpy(&value, (char *) list->__data->list.items + (size_t) index * list->__data->list.element_size, list->__data->list.element_size);
+    return value;
+}
+// Arena allocated parts of the tree are left for the arena to release. Trees
+// fully built in an arena don't need PN_free at all, just an arena_reset.
+static inline void PN_free(PacketNode *node) {
     switch (node->type) {
         case NT_STRING:
         case NT_NBT:
-            free(node->__data->contents);
+        case NT_BYTE_ARRAY:
+            if (!(node->flags & (PN_FLAG_VIEW | PN_FLAG_ARENA_CONTENTS)))
+                free(node->__data->contents);
             break;
-        case NT_BUNDLE:
-            for (int i = 0; i < PACKET_NODE_COLLECTION_SIZE; i++) {
-                if (node->__data->hashmap[i])
-                    PN_free(node->__data->hashmap[i]);
+        case NT_BUNDLE: {
+            struct PacketBundleFields *bundle = &node->__data->bundle;
+            for (int i = 0; i < bundle->size; i++) {
+                if (bundle->fields[i])
+                    PN_free(bundle->fields[i]);
             }
+            if (bundle->fields != _PNB_inline_fields(node) && !bundle->arena)
+                free(bundle->fields);
             break;
-        case NT_LIST:
-            for (int i = 0; i < node->list_size; i++) {
-                if (node->__data->children[i])
-                    PN_free(node->__data->children[i]);
+        }
+        case NT_LIST: {
+            struct PacketListItems *items = &node->__data->list;
+            if (items->element_type == NT_LIST) {
+                for (int i = 0; i < node->list_size; i++) {
+                    PacketNode *child = ((PacketNode **) items->items)[i];
+                    if (child)
+                        PN_free(child);
+                }
             }
+            if (items->items != _PNL_inline_items(node) && !items->arena)
+                free(items->items);
             break;
+        }
 
         default:
     }
 
 
-    free(node);
+    if (!(node->flags & PN_FLAG_ARENA))
+        free(node);
+}
+
+static inline void _PNB_grow(PacketNode *root_bundle) {
+    struct PacketBundleFields *bundle = &root_bundle->__data->bundle;
+    int alloc = bundle->alloc ? bundle->alloc * 2 : DEFAULT_BUNDLE_SIZE;
+    PacketNode **fields;
+    if (bundle->arena) {
+        fields = arena_alloc(bundle->arena, alloc * sizeof(PacketNode *));
+    } else {
+        fields = malloc(alloc * sizeof(PacketNode *));
+    }
+    memcpy(fields, bundle->fields, bundle->size * sizeof(PacketNode *));
+
+    if (bundle->fields != _PNB_inline_fields(root_bundle) && !bundle->arena)
+        free(bundle->fields);
+    bundle->fields = fields;
+    bundle->alloc = alloc;
 }
 
-// Puts an element onto a hashmap/bundle.
+// Puts an element onto a bundle, replacing any element of the same name.
 // WARNING: **Takes ownership of value!**
 static __always_inline void PNB_set(PacketNode *root_bundle, PacketNode *value) {
     assert(root_bundle->type == NT_BUNDLE);
-    size_t hash = value->full_hash;
-    size_t modhash = hash % PACKET_NODE_COLLECTION_SIZE;
-
-    PacketNode **hashmap_element = &root_bundle->__data->hashmap[modhash];
-    while (*hashmap_element) {
-        // Save if key of same value was found
-        // note: assuming xxhash is collision free
-        if ((*hashmap_element)->full_hash == hash) {
-            PN_free(*hashmap_element);
-            *hashmap_element = value;
+    struct PacketBundleFields *bundle = &root_bundle->__data->bundle;
+    uint64_t hash = value->full_hash;
+
+    // Bundles are small enough that a linear scan beats hashing into buckets.
+    // note: assuming xxhash is collision free
+    for (int i = 0; i < bundle->size; i++) {
+        if (bundle->fields[i] && bundle->fields[i]->full_hash == hash) {
+            PN_free(bundle->fields[i]);
+            bundle->fields[i] = value;
             return;
         }
-
-        hashmap_element = &(*hashmap_element)->_hashmap_next;
     }
-    *hashmap_element = value;
+    if (bundle->size == bundle->alloc)
+        _PNB_grow(root_bundle);
+    bundle->fields[bundle->size++] = value;
 }
 // Get the element of a bundle by the hash of a name
 static __always_inline PacketNode *PNB_hget(PacketNode *root_bundle, uint64_t hash) {
     assert(root_bundle->type == NT_BUNDLE);
-    size_t modhash = hash % PACKET_NODE_COLLECTION_SIZE;
-    PacketNode *hashmap_element = root_bundle->__data->hashmap[modhash];
-
-    while (hashmap_element && hashmap_element->full_hash != hash) {
-        hashmap_element = hashmap_element->_hashmap_next;
+    struct PacketBundleFields *bundle = &root_bundle->__data->bundle;
+    for (int i = 0; i < bundle->size; i++) {
+        if (bundle->fields[i] && bundle->fields[i]->full_hash == hash)
+            return bundle->fields[i];
     }
-
-    if (!hashmap_element)
-        return NULL;
-
-    if (hashmap_element->full_hash != hash)
-        return NULL;
-    return hashmap_element;
+    return NULL;
 }
 // Get the element on a bundle by name
 static __always_inline PacketNode *PNB_get(PacketNode *root_bundle, char *e) { return PNB_hget(root_bundle, PN_str_hash(e)); }
 
+// A field name resolved against a packet definition ahead of time,
+// see plan_field_handle. Slot is -1 if the name could not be resolved.
+typedef struct {
+    int slot;
+    uint64_t name_hash;
+} PacketFieldHandle;
+
+// Get the element of a bundle by a field handle. For bundles decoded with the
+// handle's plan this is a single indexed load, anything else falls back to PNB_hget.
+static __always_inline PacketNode *PNB_fget(PacketNode *root_bundle, PacketFieldHandle handle) {
+    assert(root_bundle->type == NT_BUNDLE);
+    struct PacketBundleFields *bundle = &root_bundle->__data->bundle;
+    if (__builtin_expect(handle.slot >= 0 && handle.slot < bundle->size, 1)) {
+        PacketNode *element = bundle->fields[handle.slot];
+        if (__builtin_expect(element && element->full_hash == handle.name_hash, 1))
+            return element;
+    }
+    return PNB_hget(root_bundle, handle.name_hash);
+}
+
 
 #define _PACKET_NODE_INIT(FUNCTION_NAME_ADDON, ELEMENT_NAME, ELEMENT_TYPE, ELEMENT_TYPE_ID)                                                \
     static __always_inline PacketNode *PN_from_##FUNCTION_NAME_ADDON(ELEMENT_TYPE arg) {                                                   \
@@ -316,8 +601,9 @@ static __always_inline PacketNode *PNB_get(PacketNode *root_bundle, char *e) { r
     static __always_inline void _PNB_set_with_hash_##FUNCTION_NAME_ADDON(PacketNode *node, char *name, uint64_t hash,                      \
                                                                          ELEMENT_TYPE value) {                                             \
         PacketNode *element = PN_from_##FUNCTION_NAME_ADDON(value);                                                                        \
-        strncpy(node->name, name, PACKET_KEY_NAME_LEN - 1);                                                                                \
-        node->full_hash = hash;                                                                                                            \
+        strncpy(element->name, name, PACKET_KEY_NAME_LEN - 1);                                                                             \
+        element->full_hash = hash;                                                                                                         \
+        PNB_set(node, element);                                                                                                            \
     }
 #define _PACKET_BUNDLE_QUICK_GET(FUNCTION_NAME_ADDON, ELEMENT_NAME, ELEMENT_TYPE, ELEMENT_TYPE_ID)                                         \
     static __always_inline ELEMENT_TYPE PNB_get_##FUNCTION_NAME_ADDON(PacketNode *node, char *name) {                                      \
@@ -329,12 +615,33 @@ static __always_inline PacketNode *PNB_get(PacketNode *root_bundle, char *e) { r
         return PN_get_##FUNCTION_NAME_ADDON(element);                                                                                      \
     }
 
+#define _PACKET_BUNDLE_HANDLE_GET(FUNCTION_NAME_ADDON, ELEMENT_NAME, ELEMENT_TYPE, ELEMENT_TYPE_ID)                                        \
+    static __always_inline ELEMENT_TYPE PNB_fget_##FUNCTION_NAME_ADDON(PacketNode *node, PacketFieldHandle handle) {                       \
+        PacketNode *element = PNB_fget(node, handle);                                                                                      \
+        if (!element) {                                                                                                                    \
+            fprintf(stderr, "Could not resolve element in slot %d of type " #FUNCTION_NAME_ADDON "\n", handle.slot);                       \
+            exit(1);                                                                                                                       \
+        }                                                                                                                                  \
+        return PN_get_##FUNCTION_NAME_ADDON(element);                                                                                      \
+    }
+
+#define _PACKET_LIST_GEN_FUNCS(FUNCTION_NAME_ADDON, ELEMENT_NAME, ELEMENT_TYPE, ELEMENT_TYPE_ID)                                           \
+    static __always_inline void PNL_append_##FUNCTION_NAME_ADDON(PacketNode *list, ELEMENT_TYPE value) {                                   \
+        assert(list->type == NT_LIST && list->__data->list.element_type == ELEMENT_TYPE_ID);                                               \
+        PN_packed_list_append(list, &value);                                                                                               \
+    }                                                                                                                                      \
+    static __always_inline ELEMENT_TYPE PNL_get_##FUNCTION_NAME_ADDON(PacketNode *list, int index) {                                       \
+        assert(list->type == NT_LIST && list->__data->list.element_type == ELEMENT_TYPE_ID);                                               \
+        return _PNL_value(list, index).ELEMENT_NAME;                                                                                       \
+    }
+
 #define _PACKET_NODE_GEN_FUNCS(FUNCTION_NAME_ADDON, ELEMENT_NAME, ELEMENT_TYPE, ELEMENT_TYPE_ID)                                           \
     _PACKET_NODE_INIT(FUNCTION_NAME_ADDON, ELEMENT_NAME, ELEMENT_TYPE, ELEMENT_TYPE_ID)                                                    \
     _PACKET_NODE_GETTER(FUNCTION_NAME_ADDON, ELEMENT_NAME, ELEMENT_TYPE, ELEMENT_TYPE_ID)                                                  \
     _PACKET_NODE_SETTER(FUNCTION_NAME_ADDON, ELEMENT_NAME, ELEMENT_TYPE, ELEMENT_TYPE_ID)                                                  \
     _PACKET_BUNDLE_QUICK_SET(FUNCTION_NAME_ADDON, ELEMENT_NAME, ELEMENT_TYPE, ELEMENT_TYPE_ID)                                             \
-    _PACKET_BUNDLE_QUICK_GET(FUNCTION_NAME_ADDON, ELEMENT_NAME, ELEMENT_TYPE, ELEMENT_TYPE_ID)
+    _PACKET_BUNDLE_QUICK_GET(FUNCTION_NAME_ADDON, ELEMENT_NAME, ELEMENT_TYPE, ELEMENT_TYPE_ID)                                             \
+    _PACKET_BUNDLE_HANDLE_GET(FUNCTION_NAME_ADDON, ELEMENT_NAME, ELEMENT_TYPE, ELEMENT_TYPE_ID)
 
 
 _PACKET_NODE_GEN_FUNCS(boolean, boolean, int8_t, NT_BOOLEAN)
@@ -352,6 +659,23 @@ _PACKET_NODE_GEN_FUNCS(float, float_, float, NT_FLOAT)
 _PACKET_NODE_GEN_FUNCS(double, double_, double, NT_DOUBLE)
 _PACKET_NODE_GEN_FUNCS(uuid, uuid, struct MC_uuid, NT_UUID)
 
+// Packed list accessors, PNL_get_int and so on
+_PACKET_LIST_GEN_FUNCS(boolean, boolean, int8_t, NT_BOOLEAN)
+_PACKET_LIST_GEN_FUNCS(byte, byte_, int8_t, NT_BYTE)
+_PACKET_LIST_GEN_FUNCS(ubyte, Ubyte_, uint8_t, NT_UBYTE)
+_PACKET_LIST_GEN_FUNCS(short, short_, int16_t, NT_SHORT)
+_PACKET_LIST_GEN_FUNCS(ushort, Ushort_, uint16_t, NT_USHORT)
+_PACKET_LIST_GEN_FUNCS(int, int_, int32_t, NT_INT)
+_PACKET_LIST_GEN_FUNCS(uint, Uint_, int32_t, NT_UINT)
+_PACKET_LIST_GEN_FUNCS(varint, varint, int32_t, NT_VARINT)
+_PACKET_LIST_GEN_FUNCS(long, long_, int64_t, NT_LONG)
+_PACKET_LIST_GEN_FUNCS(ulong, Ulong_, uint64_t, NT_ULONG)
+_PACKET_LIST_GEN_FUNCS(varlong, varlong, uint64_t, NT_VARLONG)
+_PACKET_LIST_GEN_FUNCS(float, float_, float, NT_FLOAT)
+_PACKET_LIST_GEN_FUNCS(double, double_, double, NT_DOUBLE)
+_PACKET_LIST_GEN_FUNCS(uuid, uuid, struct MC_uuid, NT_UUID)
+
+// The _raw accessors only work on nodes owning their contents, see PN_FLAG_VIEW
 _PACKET_NODE_GEN_FUNCS(string_raw, contents, struct PacketBufferContents *, NT_STRING)
 _PACKET_NODE_GEN_FUNCS(byte_array_raw, contents, struct PacketBufferContents *, NT_BYTE_ARRAY)
 _PACKET_NODE_GEN_FUNCS(NBT_raw, contents, struct PacketBufferContents *, NT_NBT)
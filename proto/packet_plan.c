@@ -0,0 +1,361 @@
+#include "packet_plan.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "constants.h"
+#include "error_handling.h"
+
+
+// Returns the offset of size (zeroed) bytes in the blob
+static size_t blob_reserve(struct DecodePlanBlob *blob, size_t size, size_t align) {
+    size_t offset = (blob->size + align - 1) & ~(align - 1);
+    if (offset + size > blob->alloc) {
+        size_t alloc = blob->alloc ? blob->alloc : 1024;
+        while (offset + size > alloc)
+            alloc *= 2;
+        blob->data = realloc(blob->data, alloc);
+        blob->alloc = alloc;
+    }
+    memset(blob->data + blob->size, 0, offset + size - blob->size);
+    blob->size = offset + size;
+    return offset;
+}
+
+// Returns the offset of a null terminated copy of str[0..len), only storing each string once
+static size_t blob_intern(struct DecodePlanBlob *blob, const char *str, size_t len, uint64_t hash) {
+    if (blob->interned_alloc == 0 || blob->size / 8 >= blob->interned_alloc) {
+        // Rehash everything. Every string is pointed to by at least one PlanOp,
+        // so size / 8 is a generous upper bound on the amount of them.
+        size_t old_alloc = blob->interned_alloc;
+        size_t *old = blob->interned;
+        blob->interned_alloc = old_alloc ? old_alloc * 2 : 256;
+        blob->interned = calloc(blob->interned_alloc, sizeof(size_t));
+        for (size_t i = 0; i < old_alloc; i++) {
+            if (!old[i])
+                continue;
+            const char *s = blob->data + old[i] - 1;
+            size_t slot = PN_str_hash(s) & (blob->interned_alloc - 1);
+            while (blob->interned[slot])
+                slot = (slot + 1) & (blob->interned_alloc - 1);
+            blob->interned[slot] = old[i];
+        }
+        free(old);
+    }
+
+    size_t slot = hash & (blob->interned_alloc - 1);
+    while (blob->interned[slot]) {
+        const char *s = blob->data + blob->interned[slot] - 1;
+        if (0 == strncmp(s, str, len) && s[len] == 0)
+            return blob->interned[slot] - 1;
+        slot = (slot + 1) & (blob->interned_alloc - 1);
+    }
+
+    // Reserved memory is zeroed, so that is the null terminator too
+    size_t offset = blob_reserve(blob, len + 1, 1);
+    memcpy(blob->data + offset, str, len);
+    // Stored as offset + 1 so 0 can mean empty
+    blob->interned[slot] = offset + 1;
+    return offset;
+}
+
+
+// Before being put into the blob offsets are absolute
+struct PendingOp {
+    struct PlanOp op;
+    size_t name_offset;
+    size_t sub_plan_offset;                     // 0 if not set
+    const struct EnumRegistryEntry *enum_entry; // NULL if not set
+};
+
+static size_t compile_items(struct DecodePlanBlob *blob, struct ProtoNode *const *items, int count, int depth);
+
+static size_t compile_list(struct DecodePlanBlob *blob, struct ProtoList *list, int depth) {
+    return compile_items(blob, list->contents, list->size, depth);
+}
+
+static void set_op_name(struct DecodePlanBlob *blob, struct PendingOp *pending, struct ProtoNode *item) {
+    struct ProtoNode *name = get_argument_of_type(item, 0, PNT_str);
+    size_t len = name->escaped.size;
+    if (len + 1 >= PACKET_KEY_NAME_LEN) {
+        SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "Field name too long for a packet node: \"%.*s\"", PROTO_TOKEN_ARG(name->escaped));
+        exit_on_error();
+    }
+    pending->op.name_len = len;
+    pending->op.name_hash = PN_str_hash_n(name->escaped.data, len);
+    pending->name_offset = blob_intern(blob, name->escaped.data, len, pending->op.name_hash);
+}
+
+// Optional second argument holding the max length of a container
+static int64_t get_max_length(struct ProtoNode *item) {
+    struct ProtoNode *arg = proto_list_get(item->object.arguments, 1);
+    if (arg == NULL)
+        return PLAN_NO_MAX_LENGTH;
+    if (arg->type != PNT_num || arg->parsed_number.is_float || arg->parsed_number.ll < 0) {
+        SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "The %.*s datatypes second argument CAN ONLY BE A POSITIVE INT",
+                        PROTO_TOKEN_ARG(item->object.name));
+        exit_on_error();
+    }
+    return arg->parsed_number.ll;
+}
+
+// Optional second argument of a varint, or varlong, naming the enum it holds
+static const struct EnumRegistryEntry *get_enum_entry(struct DecodePlanBlob *blob, struct ProtoNode *item) {
+    struct ProtoNode *arg = proto_list_get(item->object.arguments, 1);
+    if (arg == NULL)
+        return NULL;
+    if (arg->type != PNT_obj || arg->object.name_hash != OBJ_enum) {
+        SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "The %.*s datatypes second argument can only be enum(\"name\")",
+                        PROTO_TOKEN_ARG(item->object.name));
+        exit_on_error();
+    }
+    struct ProtoNode *name = get_argument_of_type(arg, 0, PNT_str);
+    uint64_t hash = PN_str_hash_n(name->escaped.data, name->escaped.size);
+    if (blob->enums) {
+        for (struct EnumRegistryEntry *entry = blob->enums[hash % ENUM_REGISTRY_SIZE]; entry; entry = entry->next) {
+            if (entry->name_hash == hash)
+                return entry;
+        }
+    }
+    SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "Unknown enum: \"%.*s\"", PROTO_TOKEN_ARG(name->escaped));
+    exit_on_error();
+    return NULL;
+}
+
+static int compare_enum_values(const void *a, const void *b) {
+    int64_t x = *(const int64_t *) a, y = *(const int64_t *) b;
+    return (x > y) - (x < y);
+}
+
+size_t compile_enum_table(struct DecodePlanBlob *blob, struct ProtoNode *declaration) {
+    const struct ProtoDict *dict = declaration->object.attached_dict;
+    uint32_t count = dict->size;
+
+    size_t offset = blob_reserve(blob, sizeof(struct PlanEnum) + count * sizeof(int64_t), _Alignof(struct PlanEnum));
+    struct PlanEnum *table = (struct PlanEnum *) (blob->data + offset);
+    table->count = count;
+    for (uint32_t i = 0; i < count; i++) {
+        struct ProtoNode *key = dict->entries[i].key;
+        if (key->type != PNT_num || key->parsed_number.is_float || dict->entries[i].value->type != PNT_str) {
+            SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "Enum values must be declared using the enum(){INT : STRING} format!!");
+            exit_on_error();
+        }
+        table->values[i] = key->parsed_number.ll;
+    }
+    qsort(table->values, count, sizeof(int64_t), compare_enum_values);
+    for (uint32_t i = 1; i < count; i++) {
+        if (table->values[i] == table->values[i - 1]) {
+            SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "Duplicate enum value: %lld", (long long) table->values[i]);
+            exit_on_error();
+        }
+    }
+    return offset;
+}
+
+static void compile_item(struct DecodePlanBlob *blob, struct PendingOp *pending, struct ProtoNode *item, int depth) {
+    if (item->type != PNT_obj) {
+        SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "Packets definitions cannot contain anything other than objects, got of type: %d",
+                        item->type);
+        exit_on_error();
+    }
+    struct PlanOp *op = &pending->op;
+    op->max_length = PLAN_NO_MAX_LENGTH;
+
+#define _CASE_FIXED(HASH, OPCODE, NODE_TYPE, WIDTH)                                                                                        \
+    case HASH:                                                                                                                             \
+        op->opcode = OPCODE;                                                                                                               \
+        op->node_type = NODE_TYPE;                                                                                                         \
+        op->width = WIDTH;                                                                                                                 \
+        set_op_name(blob, pending, item);                                                                                                  \
+        break;
+
+    switch (item->object.name_hash) {
+        _CASE_FIXED(OBJ_boolean, PO_BOOLEAN, NT_BOOLEAN, 1)
+        _CASE_FIXED(OBJ_byte, PO_BYTE, NT_BYTE, 1)
+        _CASE_FIXED(OBJ_Ubyte, PO_UBYTE, NT_UBYTE, 1)
+        _CASE_FIXED(OBJ_short, PO_SHORT, NT_SHORT, 2)
+        _CASE_FIXED(OBJ_Ushort, PO_USHORT, NT_USHORT, 2)
+        _CASE_FIXED(OBJ_int, PO_INT, NT_INT, 4)
+        _CASE_FIXED(OBJ_Uint, PO_UINT, NT_UINT, 4)
+        _CASE_FIXED(OBJ_long, PO_LONG, NT_LONG, 8)
+        _CASE_FIXED(OBJ_Ulong, PO_ULONG, NT_ULONG, 8)
+        _CASE_FIXED(OBJ_uuid, PO_UUID, NT_UUID, 16)
+        case OBJ_varint:
+            op->opcode = PO_VARINT;
+            op->node_type = NT_VARINT;
+            set_op_name(blob, pending, item);
+            pending->enum_entry = get_enum_entry(blob, item);
+            break;
+        case OBJ_varlong:
+            op->opcode = PO_VARLONG;
+            op->node_type = NT_VARLONG;
+            set_op_name(blob, pending, item);
+            pending->enum_entry = get_enum_entry(blob, item);
+            break;
+        case OBJ_string:
+            op->opcode = PO_STRING;
+            op->node_type = NT_STRING;
+            op->max_length = get_max_length(item);
+            set_op_name(blob, pending, item);
+            break;
+        case OBJ_prefixed_byte_array:
+            op->opcode = PO_PREFIXED_BYTE_ARRAY;
+            op->node_type = NT_BYTE_ARRAY;
+            op->max_length = get_max_length(item);
+            set_op_name(blob, pending, item);
+            break;
+        case OBJ_byte_array: {
+            // Only byte_array("name", CONTEXT(REMAINING_BYTES())) is understood for now
+            struct ProtoNode *context = get_argument_of_type(item, 1, PNT_obj);
+            struct ProtoNode *inner = proto_list_get(context->object.arguments, 0);
+            if (context->object.name_hash != OBJ_CONTEXT || inner == NULL || inner->type != PNT_obj ||
+                inner->object.name_hash != OBJ_REMAINING_BYTES) {
+                SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "byte_array must have its length as CONTEXT(REMAINING_BYTES())");
+                exit_on_error();
+            }
+            op->opcode = PO_REMAINING_BYTES;
+            op->node_type = NT_BYTE_ARRAY;
+            set_op_name(blob, pending, item);
+            break;
+        }
+        case OBJ_prefixed_optional:
+            if (depth + 1 >= MAX_PACKET_NESTING) {
+                SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "Packet too deeply nested. Please increase MAX_PACKET_NESTING");
+                exit_on_error();
+            }
+            // Same two modes as the decoder always had. As a modifier to a single
+            // item, or as a container with an attached list
+            if (item->object.attached_list) {
+                op->opcode = PO_OPTIONAL_BUNDLE;
+                op->node_type = NT_BUNDLE;
+                set_op_name(blob, pending, item);
+                pending->sub_plan_offset = compile_list(blob, item->object.attached_list, depth + 1);
+            } else {
+                struct ProtoNode *opt = proto_list_get(item->object.arguments, 0);
+                if (NULL == opt || opt->type != PNT_obj) {
+                    SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT,
+                                    "prefixed_optional MUST, either have an attached list, or a singular object!");
+                    exit_on_error();
+                }
+                pending->sub_plan_offset = compile_items(blob, &opt, 1, depth + 1);
+
+                // Takes on the name of what it wraps
+                const struct PlanOp *inner = ((const struct DecodePlan *) (blob->data + pending->sub_plan_offset))->ops;
+                op->opcode = PO_OPTIONAL;
+                op->node_type = inner->node_type;
+                op->name_len = inner->name_len;
+                op->name_hash = inner->name_hash;
+                pending->name_offset = (const char *) inner + inner->name - blob->data;
+            }
+            break;
+        case OBJ_prefixed_array:
+            if (!item->object.attached_list) {
+                SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "prefixed_array MUST have an attached list");
+                exit_on_error();
+            }
+            if (depth + 1 >= MAX_PACKET_NESTING) {
+                SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "Packet too deeply nested. Please increase MAX_PACKET_NESTING");
+                exit_on_error();
+            }
+            op->opcode = PO_PREFIXED_ARRAY;
+            op->node_type = NT_LIST;
+            set_op_name(blob, pending, item);
+            pending->sub_plan_offset = compile_list(blob, item->object.attached_list, depth + 1);
+
+            // Arrays of plain numbers don't need a bundle (and node) per element
+            const struct DecodePlan *sub = (const struct DecodePlan *) (blob->data + pending->sub_plan_offset);
+            if (sub->op_count == 1 && sub->ops[0].opcode <= PO_VARLONG)
+                op->opcode = PO_PACKED_ARRAY;
+            break;
+        default:
+            SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "Unknown packet definition datatype: %.*s", PROTO_TOKEN_ARG(item->object.name));
+            exit_on_error();
+    }
+#undef _CASE_FIXED
+}
+
+static size_t compile_items(struct DecodePlanBlob *blob, struct ProtoNode *const *items, int count, int depth) {
+    // Sub plans (and names) have to be in the blob before the plan pointing to them
+    struct PendingOp *pending = calloc(count ? count : 1, sizeof(struct PendingOp));
+    for (int i = 0; i < count; i++)
+        compile_item(blob, &pending[i], items[i], depth);
+
+    size_t plan_offset = blob_reserve(blob, sizeof(struct DecodePlan) + count * sizeof(struct PlanOp), _Alignof(struct DecodePlan));
+    struct DecodePlan *plan = (struct DecodePlan *) (blob->data + plan_offset);
+    plan->op_count = count;
+
+    for (int i = 0; i < count; i++) {
+        size_t op_offset = (char *) &plan->ops[i] - blob->data;
+        plan->ops[i] = pending[i].op;
+        plan->ops[i].name = (int32_t) ((ptrdiff_t) pending[i].name_offset - (ptrdiff_t) op_offset);
+        if (pending[i].sub_plan_offset)
+            plan->ops[i].sub_plan = (int32_t) ((ptrdiff_t) pending[i].sub_plan_offset - (ptrdiff_t) op_offset);
+        if (pending[i].enum_entry)
+            plan->ops[i].enum_values = (int32_t) ((ptrdiff_t) pending[i].enum_entry->table - (ptrdiff_t) op_offset);
+    }
+    free(pending);
+    return plan_offset;
+}
+
+size_t compile_decode_plan(struct DecodePlanBlob *blob, struct ProtoList *definition) { return compile_list(blob, definition, 0); }
+
+void finish_decode_plan_blob(struct DecodePlanBlob *blob) {
+    free(blob->interned);
+    blob->interned = NULL;
+    blob->interned_alloc = 0;
+    blob->enums = NULL;
+}
+
+
+PacketFieldHandle plan_field_handle(const struct DecodePlan *plan, const char *name) {
+    uint64_t hash = PN_str_hash(name);
+    for (uint32_t i = 0; i < plan->op_count; i++) {
+        if (plan->ops[i].name_hash == hash)
+            return (PacketFieldHandle) {.slot = i, .name_hash = hash};
+    }
+    SET_ERROR_STATE(ERROR_API_USAGE, "Field \"%s\" is not part of the packet definition", name);
+    return (PacketFieldHandle) {.slot = -1, .name_hash = hash};
+}
+
+
+static const char *PLAN_OPCODE_NAMES[] = {
+        [PO_BOOLEAN] = "boolean",
+        [PO_BYTE] = "byte",
+        [PO_UBYTE] = "Ubyte",
+        [PO_SHORT] = "short",
+        [PO_USHORT] = "Ushort",
+        [PO_INT] = "int",
+        [PO_UINT] = "Uint",
+        [PO_LONG] = "long",
+        [PO_ULONG] = "Ulong",
+        [PO_UUID] = "uuid",
+        [PO_VARINT] = "varint",
+        [PO_VARLONG] = "varlong",
+        [PO_STRING] = "string",
+        [PO_PREFIXED_BYTE_ARRAY] = "prefixed_byte_array",
+        [PO_REMAINING_BYTES] = "remaining_bytes",
+        [PO_OPTIONAL] = "optional",
+        [PO_OPTIONAL_BUNDLE] = "optional_bundle",
+        [PO_PREFIXED_ARRAY] = "prefixed_array",
+        [PO_PACKED_ARRAY] = "packed_array",
+};
+
+void debug_print_decode_plan(const struct DecodePlan *plan, int level) {
+    for (uint32_t i = 0; i < plan->op_count; i++) {
+        const struct PlanOp *op = &plan->ops[i];
+        for (int l = 0; l < level; l++)
+            printf("\t");
+        printf("%u: %s \"%s\"", i, PLAN_OPCODE_NAMES[op->opcode], plan_op_name(op));
+        if (op->max_length != PLAN_NO_MAX_LENGTH)
+            printf(" max=%lld", (long long) op->max_length);
+        const struct PlanEnum *table = plan_op_enum(op);
+        if (table)
+            printf(" enum=%u values", table->count);
+        printf("\n");
+
+        const struct DecodePlan *sub = plan_op_sub_plan(op);
+        if (sub)
+            debug_print_decode_plan(sub, level + 1);
+    }
+}
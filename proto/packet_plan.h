@@ -0,0 +1,162 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "packet_node.h"
+#include "proto_file.h"
+
+/*
+  Decode plans are the "compiled" form of a packet definition from a .proto
+  file. Rather than walking the ProtoList tree for every packet, and checking
+  every argument every time, each definition is flattened once (at
+  create_version_serde time) into a linear array of PlanOps.
+
+  Every plan of a version lives in one contiguous blob, and every reference
+  inside of it (names, sub plans) is a self-relative offset. That way the blob
+  can be grown with realloc while it is being built, and never needs fixups.
+*/
+
+enum PlanOpcode {
+    // Fixed width, big endian, primitives
+    PO_BOOLEAN,
+    PO_BYTE,
+    PO_UBYTE,
+    PO_SHORT,
+    PO_USHORT,
+    PO_INT,
+    PO_UINT,
+    PO_LONG,
+    PO_ULONG,
+    PO_UUID,
+
+    PO_VARINT,
+    PO_VARLONG,
+
+    // Varint length prefixed containers
+    PO_STRING,
+    PO_PREFIXED_BYTE_ARRAY,
+
+    // Everything left in the packet
+    PO_REMAINING_BYTES,
+
+    // A boolean prefixed optional wrapping a single field. The field shares the
+    // parent bundle. The sub plan has exactly one op.
+    PO_OPTIONAL,
+    // A boolean prefixed optional wrapping a list of fields. Those fields are put
+    // into their own bundle.
+    PO_OPTIONAL_BUNDLE,
+    // Varint prefixed list of bundles, each decoded by the sub plan
+    PO_PREFIXED_ARRAY,
+    // Same on the wire as PO_PREFIXED_ARRAY, for when the sub plan is a single
+    // value op. Decodes into a packed list of those values, no bundle per element.
+    PO_PACKED_ARRAY,
+};
+
+#define MAX_PACKET_NESTING 32
+
+#define ENUM_REGISTRY_SIZE 1024
+
+// An enum declared in the enums(){} block of a proto file
+struct EnumRegistryEntry {
+    const char *name;
+    uint64_t name_hash;
+
+    // Offset of its PlanEnum inside of the plan blob
+    size_t table;
+
+    // Hashmaps need this
+    struct EnumRegistryEntry *next;
+};
+
+// Used in PlanOp.max_length when no limit is given
+#define PLAN_NO_MAX_LENGTH (-1)
+
+struct PlanOp {
+    uint8_t opcode;    // enum PlanOpcode
+    uint8_t node_type; // enum NodeType this op produces
+    uint8_t width;     // Bytes on the wire, only for fixed width primitives
+    uint8_t name_len;  // Excluding the null terminator
+
+    // Self-relative offsets, see plan_op_name and plan_op_sub_plan
+    int32_t name;
+    int32_t sub_plan;    // 0 if not set
+    int32_t enum_values; // 0 if not set, only for varints and varlongs
+
+    int64_t max_length;
+    uint64_t name_hash; // Same as PN_str_hash(name)
+};
+
+struct DecodePlan {
+    uint32_t op_count;
+    uint32_t _pad;
+    struct PlanOp ops[];
+};
+
+// Every value an enum can take, sorted
+struct PlanEnum {
+    uint32_t count;
+    uint32_t _pad;
+    int64_t values[];
+};
+
+static __always_inline const char *plan_op_name(const struct PlanOp *op) { return (const char *) op + op->name; }
+
+static __always_inline const struct DecodePlan *plan_op_sub_plan(const struct PlanOp *op) {
+    if (!op->sub_plan)
+        return NULL;
+    return (const struct DecodePlan *) ((const char *) op + op->sub_plan);
+}
+
+static __always_inline const struct PlanEnum *plan_op_enum(const struct PlanOp *op) {
+    if (!op->enum_values)
+        return NULL;
+    return (const struct PlanEnum *) ((const char *) op + op->enum_values);
+}
+
+static __always_inline bool plan_enum_has(const struct PlanEnum *table, int64_t value) {
+    uint32_t low = 0, high = table->count;
+    while (low < high) {
+        uint32_t mid = (low + high) / 2;
+        if (table->values[mid] == value)
+            return true;
+        if (table->values[mid] < value)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return false;
+}
+
+// Growable storage for every plan in a version
+struct DecodePlanBlob {
+    char *data;
+    size_t size;
+    size_t alloc;
+
+    // Open addressing table of string offsets, only used while compiling
+    size_t *interned;
+    size_t interned_alloc;
+
+    // Enums that varint("name", enum("other name")) can refer to, only used while compiling
+    struct EnumRegistryEntry *const *enums;
+};
+
+// Compiles the contents of an enum(){INT : STRING} declaration into the blob.
+// Returns: the offset of the resulting PlanEnum inside of blob->data.
+// Exits the program if the declaration is malformed.
+size_t compile_enum_table(struct DecodePlanBlob *blob, struct ProtoNode *declaration);
+
+// Compiles a packet definition into the blob.
+// Returns: the offset of the resulting DecodePlan inside of blob->data.
+// Exits the program if the definition is malformed, like create_version_serde.
+size_t compile_decode_plan(struct DecodePlanBlob *blob, struct ProtoList *definition);
+
+// Frees the interning table, but keeps the compiled plans around
+void finish_decode_plan_blob(struct DecodePlanBlob *blob);
+
+// Resolves a field name of a plan, for use with PNB_fget. Nested plans (the
+// elements of arrays, or optional bundles) are resolved against plan_op_sub_plan.
+// Sets error state and returns a handle with a slot of -1 if not found.
+PacketFieldHandle plan_field_handle(const struct DecodePlan *plan, const char *name);
+
+void debug_print_decode_plan(const struct DecodePlan *plan, int level);
@@ -0,0 +1,147 @@
+#include "packet_validate.h"
+
+#include "datatypes.h"
+#include "error_handling.h"
+
+static const char *PACKET_VALIDITY_NAMES[] = {
+        [PACKET_VALID] = "valid",
+        [PACKET_UNKNOWN] = "unknown packet",
+        [PACKET_TRUNCATED] = "truncated",
+        [PACKET_BAD_VARINT] = "bad varint",
+        [PACKET_TOO_LONG] = "too long",
+        [PACKET_BAD_ENUM] = "bad enum",
+        [PACKET_TRAILING_BYTES] = "trailing bytes",
+        [PACKET_BAD_PLAN] = "bad plan",
+};
+
+const char *packet_validity_name(enum PacketValidity validity) {
+    if ((unsigned) validity >= sizeof(PACKET_VALIDITY_NAMES) / sizeof(*PACKET_VALIDITY_NAMES))
+        return "unknown";
+    return PACKET_VALIDITY_NAMES[validity];
+}
+
+struct ValidateContext {
+    const char *buffer;
+    const char *max_buffer;
+    const struct PlanOp *failed_op;
+};
+
+static enum PacketValidity validate_plan(struct ValidateContext *ctx, const struct DecodePlan *plan);
+
+static enum PacketValidity validate_op(struct ValidateContext *ctx, const struct PlanOp *op) {
+#define _FAIL(VALIDITY)                                                                                                                    \
+    {                                                                                                                                      \
+        ctx->failed_op = op;                                                                                                               \
+        return VALIDITY;                                                                                                                   \
+    }
+#define _SKIP(SIZE)                                                                                                                        \
+    if ((size_t) (ctx->max_buffer - ctx->buffer) < (size_t) (SIZE))                                                                        \
+        _FAIL(PACKET_TRUNCATED);                                                                                                           \
+    ctx->buffer += SIZE;
+#define _READ_VAR_STYLE(OUT, BITS)                                                                                                         \
+    {                                                                                                                                      \
+        uint64_t _value;                                                                                                                   \
+        enum DecodeError _error = decode_var_style(&ctx->buffer, ctx->max_buffer, BITS, &_value);                                          \
+        if (_error)                                                                                                                        \
+            _FAIL(_error == DECODE_ERROR_TRUNCATED ? PACKET_TRUNCATED : PACKET_BAD_VARINT);                                                \
+        OUT = _value;                                                                                                                      \
+    }
+
+    switch (op->opcode) {
+        case PO_BOOLEAN:
+        case PO_BYTE:
+        case PO_UBYTE:
+        case PO_SHORT:
+        case PO_USHORT:
+        case PO_INT:
+        case PO_UINT:
+        case PO_LONG:
+        case PO_ULONG:
+        case PO_UUID:
+            _SKIP(op->width);
+            return PACKET_VALID;
+        case PO_VARINT:
+        case PO_VARLONG: {
+            uint64_t raw;
+            _READ_VAR_STYLE(raw, op->opcode == PO_VARINT ? 32 : 64);
+            const struct PlanEnum *table = plan_op_enum(op);
+            if (table) {
+                // Same sign as the node the value would be decoded into
+                int64_t value = op->opcode == PO_VARINT ? (int64_t) (int32_t) raw : (int64_t) raw;
+                if (!plan_enum_has(table, value))
+                    _FAIL(PACKET_BAD_ENUM);
+            }
+            return PACKET_VALID;
+        }
+        case PO_STRING:
+        case PO_PREFIXED_BYTE_ARRAY: {
+            uint32_t size;
+            _READ_VAR_STYLE(size, 32);
+            if (op->max_length != PLAN_NO_MAX_LENGTH && size > op->max_length)
+                _FAIL(PACKET_TOO_LONG);
+            _SKIP(size);
+            return PACKET_VALID;
+        }
+        case PO_REMAINING_BYTES:
+            if (op->max_length != PLAN_NO_MAX_LENGTH && ctx->max_buffer - ctx->buffer > op->max_length)
+                _FAIL(PACKET_TOO_LONG);
+            ctx->buffer = ctx->max_buffer;
+            return PACKET_VALID;
+        case PO_OPTIONAL:
+        case PO_OPTIONAL_BUNDLE: {
+            _SKIP(1);
+            if (!ctx->buffer[-1])
+                return PACKET_VALID;
+            return validate_plan(ctx, plan_op_sub_plan(op));
+        }
+        case PO_PREFIXED_ARRAY:
+        case PO_PACKED_ARRAY: {
+            uint32_t count;
+            _READ_VAR_STYLE(count, 32);
+            if (count > MAX_DECODED_LIST_SIZE)
+                _FAIL(PACKET_TOO_LONG);
+            const struct DecodePlan *sub = plan_op_sub_plan(op);
+            for (uint32_t element = 0; element < count; element++) {
+                enum PacketValidity res = validate_plan(ctx, sub);
+                if (res)
+                    return res;
+            }
+            return PACKET_VALID;
+        }
+        default:
+            // Plans are compiled by us, so this never happens. But _deserialize_op fails here too
+            _FAIL(PACKET_BAD_PLAN);
+    }
+#undef _READ_VAR_STYLE
+#undef _SKIP
+#undef _FAIL
+}
+
+static enum PacketValidity validate_plan(struct ValidateContext *ctx, const struct DecodePlan *plan) {
+    for (uint32_t i = 0; i < plan->op_count; i++) {
+        enum PacketValidity res = validate_op(ctx, &plan->ops[i]);
+        if (res)
+            return res;
+    }
+    return PACKET_VALID;
+}
+
+enum PacketValidity validate_packet(const struct PacketDeclaration *packet, const char *buffer, size_t size,
+                                    const struct PlanOp **failed_op) {
+    if (!packet->plan) {
+        if (failed_op)
+            *failed_op = NULL;
+        return PACKET_UNKNOWN;
+    }
+    struct ValidateContext ctx = {
+            .buffer = buffer,
+            .max_buffer = buffer + size,
+            .failed_op = NULL,
+    };
+    enum PacketValidity res = validate_plan(&ctx, packet->plan);
+    if (res == PACKET_VALID && ctx.buffer != ctx.max_buffer)
+        res = PACKET_TRAILING_BYTES;
+    if (failed_op)
+        *failed_op = ctx.failed_op;
+    return res;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "serde.h"
+
+/*
+  Validate only decoding, for traffic that should not be trusted. Walks a
+  packet with its compiled plan, checking everything deserialize_packet
+  would (bounds, varint widths, max lengths, trailing bytes), plus that
+  enum fields hold one of their declared values. Nothing is allocated and
+  no error state is set, so rejecting a malformed packet costs next to
+  nothing.
+
+  A packet that validates is guaranteed to deserialize.
+*/
+
+enum PacketValidity {
+    PACKET_VALID = 0,
+    // The declaration is an empty slot, no packet has that id
+    PACKET_UNKNOWN,
+    // A field runs past the end of the packet
+    PACKET_TRUNCATED,
+    // A varint, or varlong, is longer than its type allows
+    PACKET_BAD_VARINT,
+    // A string, or byte array, is over its max length. Or an array has more
+    // elements than a PacketNode can hold.
+    PACKET_TOO_LONG,
+    // An enum field holds a value that is not part of the enum
+    PACKET_BAD_ENUM,
+    // Something is left over after the last field
+    PACKET_TRAILING_BYTES,
+    // The plan has an opcode the decoder does not know, so the packet would fail to deserialize
+    PACKET_BAD_PLAN,
+};
+
+// For logging, like "truncated"
+const char *packet_validity_name(enum PacketValidity validity);
+
+// Checks a packet against its declaration. Like deserialize_packet the buffer must
+// hold the entire packet, uncompressed, and unencrypted.
+// If failed_op is not NULL, it is set to the op that failed (NULL for unknown packets, and trailing bytes).
+enum PacketValidity validate_packet(const struct PacketDeclaration *packet, const char *buffer, size_t size,
+                                    const struct PlanOp **failed_op);
@@ -0,0 +1,173 @@
+#include "packet_visit.h"
+
+#include "datatypes.h"
+#include "error_handling.h"
+
+struct VisitContext {
+    const char *buffer;
+    const char *max_buffer;
+    PacketVisitCallback callback;
+    void **state;
+};
+
+// Result of a visit step: 0 to go on, 1 if the callback said to stop, -1 on error
+#define _EMIT(CTX, EVENT)                                                                                                                  \
+    if ((CTX)->callback(EVENT, (CTX)->state) == 1)                                                                                         \
+        return 1;
+
+static int visit_plan(struct VisitContext *ctx, const struct DecodePlan *plan, int depth);
+
+static int visit_bundle(struct VisitContext *ctx, const struct PlanOp *op, const struct DecodePlan *plan, int slot, int depth, int index) {
+    if (depth + 1 >= MAX_PACKET_NESTING) {
+        SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "Packet too deeply nested to continue. Please increase MAX_PACKET_NESTING");
+        return -1;
+    }
+    struct PacketVisitEvent event = {
+            .kind = VISIT_BUNDLE_BEGIN,
+            .op = op,
+            .handle = {.slot = slot, .name_hash = op ? op->name_hash : 0},
+            .type = NT_BUNDLE,
+            .depth = depth,
+            .index = index,
+    };
+    _EMIT(ctx, &event);
+    int res = visit_plan(ctx, plan, depth + 1);
+    if (res)
+        return res;
+    event.kind = VISIT_BUNDLE_END;
+    _EMIT(ctx, &event);
+    return 0;
+}
+
+static int visit_op(struct VisitContext *ctx, const struct PlanOp *op, int slot, int depth) {
+#define _MEM_ERROR_CHECK(NEEDED)                                                                                                           \
+    if ((size_t) (ctx->max_buffer - ctx->buffer) < (size_t) (NEEDED)) {                                                                    \
+        SET_DECODE_ERROR(DECODE_ERROR_TRUNCATED, plan_op_name(op), ctx->buffer, 0, 0);                                                     \
+        return -1;                                                                                                                         \
+    }
+#define _READ_VAR_STYLE(OUT, BITS)                                                                                                         \
+    {                                                                                                                                      \
+        uint64_t _value;                                                                                                                   \
+        enum DecodeError _error = decode_var_style(&ctx->buffer, ctx->max_buffer, BITS, &_value);                                          \
+        if (__builtin_expect(_error, 0)) {                                                                                                 \
+            SET_DECODE_ERROR(_error, plan_op_name(op), ctx->buffer, 0, 0);                                                                 \
+            return -1;                                                                                                                     \
+        }                                                                                                                                  \
+        OUT = _value;                                                                                                                      \
+    }
+
+    struct PacketVisitEvent event = {
+            .kind = VISIT_FIELD,
+            .op = op,
+            .handle = {.slot = slot, .name_hash = op->name_hash},
+            .type = op->node_type,
+            .depth = depth,
+            .index = -1,
+    };
+    switch (op->opcode) {
+        case PO_BOOLEAN:
+        case PO_BYTE:
+        case PO_UBYTE:
+        case PO_SHORT:
+        case PO_USHORT:
+        case PO_INT:
+        case PO_UINT:
+        case PO_LONG:
+        case PO_ULONG:
+        case PO_UUID:
+        case PO_VARINT:
+        case PO_VARLONG:
+            if (_deserialize_value(op, &ctx->buffer, ctx->max_buffer, &event.value))
+                return -1;
+            break;
+        case PO_STRING:
+        case PO_PREFIXED_BYTE_ARRAY:
+        case PO_REMAINING_BYTES: {
+            uint32_t size;
+            if (op->opcode == PO_REMAINING_BYTES) {
+                size = ctx->max_buffer - ctx->buffer;
+            } else {
+                _READ_VAR_STYLE(size, 32);
+            }
+            if (op->max_length != PLAN_NO_MAX_LENGTH && size > op->max_length) {
+                SET_DECODE_ERROR(DECODE_ERROR_TOO_LONG, plan_op_name(op), ctx->buffer, op->max_length, size);
+                return -1;
+            }
+            _MEM_ERROR_CHECK(size);
+            event.value.view = (struct PacketBufferView) {.data = ctx->buffer, .size = size};
+            ctx->buffer += size;
+            break;
+        }
+        case PO_OPTIONAL:
+        case PO_OPTIONAL_BUNDLE: {
+            _MEM_ERROR_CHECK(1);
+            char is_present = *(ctx->buffer++);
+            if (!is_present)
+                return 0;
+
+            const struct DecodePlan *sub = plan_op_sub_plan(op);
+            if (op->opcode == PO_OPTIONAL)
+                // Shares same context
+                return visit_op(ctx, sub->ops, slot, depth);
+            return visit_bundle(ctx, op, sub, slot, depth, -1);
+        }
+        case PO_PREFIXED_ARRAY:
+        case PO_PACKED_ARRAY: {
+            // Packed or not, elements are visited like one field bundles
+            _READ_VAR_STYLE(event.count, 32);
+            if (event.count > MAX_DECODED_LIST_SIZE) {
+                SET_DECODE_ERROR(DECODE_ERROR_TOO_MANY_ELEMENTS, plan_op_name(op), ctx->buffer, event.count, MAX_DECODED_LIST_SIZE);
+                return -1;
+            }
+            event.kind = VISIT_LIST_BEGIN;
+            _EMIT(ctx, &event);
+
+            const struct DecodePlan *sub = plan_op_sub_plan(op);
+            for (uint32_t i = 0; i < event.count; i++) {
+                int res = visit_bundle(ctx, NULL, sub, -1, depth, i);
+                if (res)
+                    return res;
+            }
+            event.kind = VISIT_LIST_END;
+            break;
+        }
+        default:
+            SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "Unknown plan opcode: %d", op->opcode);
+            return -1;
+    }
+#undef _READ_VAR_STYLE
+#undef _MEM_ERROR_CHECK
+
+    _EMIT(ctx, &event);
+    return 0;
+}
+
+static int visit_plan(struct VisitContext *ctx, const struct DecodePlan *plan, int depth) {
+    for (uint32_t i = 0; i < plan->op_count; i++) {
+        int res = visit_op(ctx, &plan->ops[i], i, depth);
+        if (res)
+            return res;
+    }
+    return 0;
+}
+
+int visit_packet(const struct PacketDeclaration *packet, const char *buffer, size_t size, PacketVisitCallback callback, void **state) {
+    if (!packet->plan) {
+        SET_ERROR_STATE(ERROR_API_USAGE, "Packet declaration has not been compiled, use create_version_serde");
+        return -1;
+    }
+    struct VisitContext ctx = {
+            .buffer = buffer,
+            .max_buffer = buffer + size,
+            .callback = callback,
+            .state = state,
+    };
+    int res = visit_plan(&ctx, packet->plan, 0);
+    if (res == 0 && ctx.buffer != ctx.max_buffer) {
+        SET_DECODE_ERROR(DECODE_ERROR_TRAILING_BYTES, NULL, ctx.buffer, ctx.max_buffer - ctx.buffer, 0);
+        res = -1;
+    }
+    if (res == -1)
+        set_decode_error_origin(buffer);
+    return res;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "serde.h"
+
+/*
+  Visitor (SAX style) decoding. Walks a packet with the same compiled plan as
+  deserialize_packet, but hands every field to a callback straight from the
+  buffer instead of building a PacketNode tree. Nothing is allocated, strings
+  and byte arrays are views into the buffer, only valid during the callback.
+
+  Events come in wire order. Optional bundles and array elements are wrapped
+  in VISIT_BUNDLE_BEGIN/END, arrays in VISIT_LIST_BEGIN/END. Absent optionals
+  produce no events at all, just like they leave no node in a decoded tree.
+*/
+
+enum PacketVisitKind {
+    // A single value, see PacketVisitEvent.value
+    VISIT_FIELD,
+    // An optional bundle, or an element of an array. Its fields come next.
+    VISIT_BUNDLE_BEGIN,
+    VISIT_BUNDLE_END,
+    // count elements follow, each one a bundle
+    VISIT_LIST_BEGIN,
+    VISIT_LIST_END,
+};
+
+struct PacketVisitEvent {
+    enum PacketVisitKind kind;
+
+    // Op the event is for, plan_op_name(op) is the field name. NULL for array elements.
+    const struct PlanOp *op;
+    // Same as what plan_field_handle gives for the field, within its bundle
+    PacketFieldHandle handle;
+    enum NodeType type;
+
+    // Bundles deep, 0 for the fields of the packet itself
+    int depth;
+    // Position of an array element, otherwise -1
+    int index;
+
+    // VISIT_FIELD, as it would be in the node. Strings and byte arrays are views, not null terminated.
+    union __PacketNodeData value;
+    // VISIT_LIST_BEGIN and VISIT_LIST_END
+    uint32_t count;
+};
+
+// Return 1 to stop visiting early, 0 to keep going
+typedef char (*PacketVisitCallback)(const struct PacketVisitEvent *event, void **state);
+
+// Visits every field of a packet. Like deserialize_packet the buffer must hold
+// the entire packet, uncompressed, and unencrypted.
+// Returns: 0 once done, 1 if the callback stopped it, or -1 on error (sets error state)
+int visit_packet(const struct PacketDeclaration *packet, const char *buffer, size_t size, PacketVisitCallback callback, void **state);
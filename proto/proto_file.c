@@ -3,10 +3,15 @@
 #include <assert.h>
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "error_handling.h"
 #include "xxhash.h"
 
 // Always *should* be set to the current string
@@ -56,10 +61,73 @@ __attribute__((noreturn)) static void parsing_error(const char *error_loc, const
 }
 
 
-static char *unescape_string(const char *in) {
-    char *out = calloc(strlen(in) + 1, sizeof(char));
+// State of a single parse_proto_file
+struct ProtoParser {
+    struct Arena *arena;
+
+    // Open addressing table of every unescaped string so far
+    struct InternedString {
+        const char *str; // NULL if empty
+        uint64_t hash;
+    } *interned;
+    size_t interned_count;
+    size_t interned_alloc;
+
+    // Elements of every list (or dict) still being parsed, innermost last.
+    // Only copied out once the list is done, and its size known.
+    struct ProtoNode **scratch;
+    size_t scratch_size;
+    size_t scratch_alloc;
+};
+
+// Returns: the one copy of str[0..len) in the arena
+static const char *intern(struct ProtoParser *parser, const char *str, size_t len) {
+    if (2 * (parser->interned_count + 1) > parser->interned_alloc) {
+        size_t old_alloc = parser->interned_alloc;
+        struct InternedString *old = parser->interned;
+        parser->interned_alloc = old_alloc ? old_alloc * 2 : 256;
+        parser->interned = calloc(parser->interned_alloc, sizeof(struct InternedString));
+        for (size_t i = 0; i < old_alloc; i++) {
+            if (!old[i].str)
+                continue;
+            size_t slot = old[i].hash & (parser->interned_alloc - 1);
+            while (parser->interned[slot].str)
+                slot = (slot + 1) & (parser->interned_alloc - 1);
+            parser->interned[slot] = old[i];
+        }
+        free(old);
+    }
+
+    uint64_t hash = XXH64(str, len, 0);
+    size_t slot = hash & (parser->interned_alloc - 1);
+    while (parser->interned[slot].str) {
+        const char *existing = parser->interned[slot].str;
+        if (parser->interned[slot].hash == hash && 0 == strncmp(existing, str, len) && existing[len] == 0)
+            return existing;
+        slot = (slot + 1) & (parser->interned_alloc - 1);
+    }
+
+    char *copy = arena_alloc(parser->arena, len + 1);
+    memcpy(copy, str, len);
+    copy[len] = 0;
+    parser->interned[slot] = (struct InternedString) {.str = copy, .hash = hash};
+    parser->interned_count++;
+    return copy;
+}
+
+static void scratch_push(struct ProtoParser *parser, struct ProtoNode *node) {
+    if (parser->scratch_size == parser->scratch_alloc) {
+        parser->scratch_alloc = parser->scratch_alloc ? parser->scratch_alloc * 2 : 64;
+        parser->scratch = realloc(parser->scratch, parser->scratch_alloc * sizeof(struct ProtoNode *));
+    }
+    parser->scratch[parser->scratch_size++] = node;
+}
+
+// Writes out the unescaped string, which is never longer than in
+static size_t unescape_string(const char *in, size_t len, char *out) {
+    const char *end = in + len;
     char *out_ptr = out;
-    while (*in) {
+    while (in < end) {
         if (*in != '\\') {
             *(out_ptr++) = *(in++);
             continue;
@@ -99,6 +167,8 @@ static char *unescape_string(const char *in) {
                 break;
             case 'X':
             case 'x':
+                if (end - in < 3)
+                    parsing_error(in, "Incomplete hex escape");
                 char high = tolower(*(++in));
                 char low = tolower(*(++in));
                 assert(('0' <= high && high <= '9') || ('a' <= high && high <= 'f'));
@@ -114,13 +184,20 @@ static char *unescape_string(const char *in) {
         }
         in++;
     }
-    return out;
+    return out_ptr - out;
 }
 
 static struct ResultingNumber proto_node_number(struct ProtoNode *node) {
     assert(node->type == PNT_num);
 
-    char *number = node->raw_data;
+    // Tokens are not null terminated, strtoll and friends need them to be
+    char text[128];
+    if (node->raw.size >= sizeof(text))
+        parsing_error(node->raw.data, "Number too long");
+    memcpy(text, node->raw.data, node->raw.size);
+    text[node->raw.size] = 0;
+
+    const char *number = text;
     bool is_negative = *number == '-';
     number += is_negative;
     if (!*number)
@@ -128,7 +205,7 @@ static struct ResultingNumber proto_node_number(struct ProtoNode *node) {
 
 
     bool is_decimal = false;
-    for (char *itr = number; *itr; itr++)
+    for (const char *itr = number; *itr; itr++)
         if (*itr == '.') {
             is_decimal = true;
             break;
@@ -165,12 +242,12 @@ static struct ResultingNumber proto_node_number(struct ProtoNode *node) {
             .ll = is_negative ? -result : result,
     };
 INVALID:
-    fprintf(stderr, "Cannot parse number: %s\n", node->raw_data);
+    fprintf(stderr, "Cannot parse number: %s\n", text);
     exit(1);
 }
 
 
-static struct ProtoList *proto_list_parse(const char **input, char list_mode);
+static struct ProtoList *proto_list_parse(struct ProtoParser *parser, const char **input, char list_mode);
 
 const char *skip_whitespace(const char *str) {
     while (*str == '#' || (*str && isspace(*str))) {
@@ -206,28 +283,29 @@ static const char *absorb_name(const char *str) {
     return str;
 }
 
-static struct ProtoDict *proto_dict_parse(const char **input);
+static struct ProtoDict *proto_dict_parse(struct ProtoParser *parser, const char **input);
 
+// Nums and strs don't need the room of an object
+static __always_inline size_t proto_node_size(enum ProtoNodeType type) {
+    if (type == PNT_obj)
+        return sizeof(struct ProtoNode);
+    return offsetof(struct ProtoNode, parsed_number) + sizeof(struct ResultingNumber);
+}
 
-static struct ProtoNode *assess_and_parse_singular_object(const char **input) {
+static struct ProtoNode *assess_and_parse_singular_object(struct ProtoParser *parser, const char **input) {
     const char *str = *input;
     enum ProtoNodeType type = assess_proto_node_type(str);
     if (type == PNT_UNKNOWN)
         parsing_error(*input, "Unable to parse data type");
 
-    struct ProtoNode *ret = calloc(1, sizeof(struct ProtoNode));
+    struct ProtoNode *ret = arena_alloc(parser->arena, proto_node_size(type));
+    memset(ret, 0, proto_node_size(type));
     ret->type = type;
 
     if (type == PNT_num) {
         const char *after = absorb_number(str);
 
-        size_t len = after - str;
-
-        if (len >= sizeof(ret->raw_data))
-            parsing_error(str, "Number too long");
-
-        memcpy(ret->raw_data, str, len);
-        ret->raw_data[len] = 0;
+        ret->raw = (struct ProtoToken) {.data = str, .size = after - str};
         ret->parsed_number = proto_node_number(ret);
 
 
@@ -248,20 +326,22 @@ static struct ProtoNode *assess_and_parse_singular_object(const char **input) {
         // Skip over the trailing double quote
         str += !!*str;
 
-        if (len >= sizeof(ret->raw_data))
-            parsing_error(initial, "String too long");
-        memcpy(ret->raw_data, initial, len);
-        ret->raw_data[len] = 0;
-
-        ret->escaped_string = unescape_string(ret->raw_data);
+        ret->raw = (struct ProtoToken) {.data = initial, .size = len};
+        ret->escaped = ret->raw;
+        if (memchr(initial, '\\', len)) {
+            // The one case where the text of the file can't be used as is
+            char *unescaped = malloc(len + 1);
+            size_t size = unescape_string(initial, len, unescaped);
+            ret->escaped = (struct ProtoToken) {.data = intern(parser, unescaped, size), .size = size};
+            free(unescaped);
+        }
     } else if (ret->type == PNT_obj) {
         const char *after_name = absorb_name(str);
         size_t len = after_name - str;
         if (len >= MAX_PROTO_OBJ_SIZE)
             parsing_error(str, "Object name too long");
-        memcpy(ret->object.name, str, len);
-        ret->object.name[len] = 0;
-        ret->object.name_hash = PN_str_hash(ret->object.name);
+        ret->object.name = (struct ProtoToken) {.data = str, .size = len};
+        ret->object.name_hash = PN_str_hash_n(str, len);
 
         str = skip_whitespace(after_name);
 
@@ -278,13 +358,13 @@ static struct ProtoNode *assess_and_parse_singular_object(const char **input) {
                     if (*output != NULL)
                         parsing_error(str, "Object cannot have two sets of arguments or lists");
 
-                    *output = proto_list_parse(&str, list_mode);
+                    *output = proto_list_parse(parser, &str, list_mode);
                     break;
                 case '{':
                     if (ret->object.attached_dict != NULL)
                         parsing_error(str, "Object cannot have two sets of attached dicts");
 
-                    ret->object.attached_dict = proto_dict_parse(&str);
+                    ret->object.attached_dict = proto_dict_parse(parser, &str);
                 default:;
             }
         }
@@ -297,39 +377,38 @@ static struct ProtoNode *assess_and_parse_singular_object(const char **input) {
 
 
 // Assumes we are on the char past the opener, sets the input one after the closer
-static struct ProtoDict *proto_dict_parse(const char **input) {
-    int index = 0;
-    struct ProtoDict *dict = calloc(1, sizeof(struct ProtoDict));
-    struct ProtoDict *current_dict = dict;
+static struct ProtoDict *proto_dict_parse(struct ProtoParser *parser, const char **input) {
+    size_t start = parser->scratch_size;
     const char *str = skip_whitespace(*input);
     while (*str) {
         if (*str == '}')
             break;
-        struct ProtoNode *key = assess_and_parse_singular_object(&str);
+        struct ProtoNode *key = assess_and_parse_singular_object(parser, &str);
         str = skip_whitespace(str);
         if (*str != ':')
             parsing_error(str, "Syntax error: dict is lacking a colon to indicate a key-value pair");
         str++; // Skip colon
 
         str = skip_whitespace(str);
-        struct ProtoNode *value = assess_and_parse_singular_object(&str);
+        struct ProtoNode *value = assess_and_parse_singular_object(parser, &str);
         str = skip_whitespace(str);
 
-        if (index >= PROTO_LIST_SEGMENT_SIZE) {
-            current_dict->next = calloc(1, sizeof(struct ProtoDict));
-            current_dict = current_dict->next;
-            index %= PROTO_LIST_SEGMENT_SIZE;
-        }
-
-        current_dict->keys[index] = key;
-        current_dict->values[index] = value;
-        index++;
+        // Pairs go onto the scratch stack as key, value
+        scratch_push(parser, key);
+        scratch_push(parser, value);
 
 
         str += *str == ','; // Skip comma if present
         str = skip_whitespace(str);
     }
 
+    uint32_t size = (parser->scratch_size - start) / 2;
+    struct ProtoDict *dict = arena_alloc(parser->arena, sizeof(struct ProtoDict) + size * sizeof(struct ProtoDictEntry));
+    dict->size = size;
+    // Scratch is still NULL if nothing was ever pushed
+    if (size)
+        memcpy(dict->entries, parser->scratch + start, size * sizeof(struct ProtoDictEntry));
+    parser->scratch_size = start;
 
     // Add one if not null
     *input = str + !!*str;
@@ -338,21 +417,17 @@ static struct ProtoDict *proto_dict_parse(const char **input) {
 
 
 char proto_list_foreach(struct ProtoList *list, ListCallback callback, void **state) {
-    for (int i = 0; i < PROTO_LIST_SEGMENT_SIZE && list->contents[i]; i++) {
+    for (uint32_t i = 0; i < list->size; i++) {
         if (callback(list->contents[i], state) == 1)
             return 1;
     }
-    if (list->next)
-        return proto_list_foreach(list->next, callback, state);
     return 0;
 }
 char proto_dict_foreach(struct ProtoDict *dict, DictCallback callback, void **state) {
-    for (int i = 0; i < PROTO_LIST_SEGMENT_SIZE && dict->keys[i] && dict->values[i]; i++) {
-        if (callback(dict->keys[i], dict->values[i], state) == 1)
+    for (uint32_t i = 0; i < dict->size; i++) {
+        if (callback(dict->entries[i].key, dict->entries[i].value, state) == 1)
             return 0;
     }
-    if (dict->next)
-        return proto_dict_foreach(dict->next, callback, state);
     return 0;
 }
 
@@ -361,10 +436,8 @@ char proto_dict_foreach(struct ProtoDict *dict, DictCallback callback, void **st
 // list_mode of 2 is function arg mode (parenthesis terminated)
 //
 // Assumes we are on the char past the opener, sets the input one after the closer
-static struct ProtoList *proto_list_parse(const char **input, char list_mode) {
-    int index = 0;
-    struct ProtoList *list = calloc(1, sizeof(struct ProtoList));
-    struct ProtoList *current_list = list;
+static struct ProtoList *proto_list_parse(struct ProtoParser *parser, const char **input, char list_mode) {
+    size_t start = parser->scratch_size;
     const char *str = skip_whitespace(*input);
 
     while (*str) {
@@ -377,73 +450,93 @@ static struct ProtoList *proto_list_parse(const char **input, char list_mode) {
                 parsing_error(str, "List open parenthesis != list close parenthesis count");
             break;
         }
-        struct ProtoNode *element = assess_and_parse_singular_object(&str);
+        struct ProtoNode *element = assess_and_parse_singular_object(parser, &str);
         str = skip_whitespace(str);
         if (*str && (*str != ')' && *str != ']' && *str != ','))
             parsing_error(str, "Unknown separator found in list");
 
         // At this point if MUST be `,` '[' or '{'
 
-        if (index >= PROTO_LIST_SEGMENT_SIZE) {
-            current_list->next = calloc(1, sizeof(struct ProtoList));
-            current_list = current_list->next;
-            index %= PROTO_LIST_SEGMENT_SIZE;
-        }
-        current_list->contents[index] = element;
-        index++;
+        scratch_push(parser, element);
 
 
         str += *str == ',';
         str = skip_whitespace(str);
     }
+
+    uint32_t size = parser->scratch_size - start;
+    struct ProtoList *list = arena_alloc(parser->arena, sizeof(struct ProtoList) + size * sizeof(struct ProtoNode *));
+    list->source = NULL;
+    list->size = size;
+    // Scratch is still NULL if nothing was ever pushed
+    if (size)
+        memcpy(list->contents, parser->scratch + start, size * sizeof(struct ProtoNode *));
+    parser->scratch_size = start;
+
     // Add one if not null
     *input = str + !!*str;
     return list;
 }
 
 struct ProtoList *parse_proto_file(const char *str) {
+    const char *text = str;
     ERROR_STRING = str;
 
+    struct ProtoParser parser = {.arena = arena_create(0)};
     // All files by default are in list mode
-    return proto_list_parse(&str, 1);
+    struct ProtoList *root = proto_list_parse(&parser, &str, 1);
+    root->source = arena_alloc(parser.arena, sizeof(struct ProtoSource));
+    *root->source = (struct ProtoSource) {.arena = parser.arena, .hash = proto_text_hash(text)};
+
+    free(parser.interned);
+    free(parser.scratch);
+    return root;
 }
 
+char *map_proto_text(const char *path, size_t *mapping_size) {
+    int fd = open(path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        SET_ERROR_STATE(ERROR_API_USAGE, "Cannot read %s: %s", path, strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        return NULL;
+    }
 
-void free_proto_node(struct ProtoNode *node) {
-    switch (node->type) {
-        case PNT_num:
-        case PNT_str:
-            break;
-        case PNT_obj:
-            free_proto_list(node->object.arguments);
-            if (node->object.attached_list)
-                free_proto_list(node->object.attached_list);
-            if (node->object.attached_dict)
-                free_proto_dict(node->object.attached_dict);
-            break;
-        default:
-            perror("Node type not supported\n");
-            exit(2);
+    // Pages past the end of a file can't be touched, so the file goes over the
+    // start of zeroed memory that is a byte longer than it.
+    size_t page = sysconf(_SC_PAGESIZE);
+    *mapping_size = (info.st_size + 1 + page - 1) & ~(page - 1);
+    char *mapping = mmap(NULL, *mapping_size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED ||
+        (info.st_size && mmap(mapping, info.st_size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)) {
+        SET_ERROR_STATE(ERROR_API_USAGE, "Cannot map %s: %s", path, strerror(errno));
+        if (mapping != MAP_FAILED)
+            munmap(mapping, *mapping_size);
+        close(fd);
+        return NULL;
     }
-    free(node);
+    close(fd);
+    return mapping;
 }
 
-void free_proto_list(struct ProtoList *list) {
-    for (int i = 0; i < PROTO_LIST_SEGMENT_SIZE && list->contents[i]; i++) {
-        free_proto_node(list->contents[i]);
-    }
-    if (list->next)
-        free_proto_list(list->next);
-    free(list);
+struct ProtoList *load_proto_file(const char *path) {
+    size_t mapping_size;
+    char *mapping = map_proto_text(path, &mapping_size);
+    if (!mapping)
+        return NULL;
+
+    struct ProtoList *root = parse_proto_file(mapping);
+    root->source->mapping = mapping;
+    root->source->mapping_size = mapping_size;
+    return root;
 }
-void free_proto_dict(struct ProtoDict *dict) {
-    for (int i = 0; i < PROTO_LIST_SEGMENT_SIZE && dict->keys[i]; i++) {
-        free_proto_node(dict->keys[i]);
-        free_proto_node(dict->values[i]);
-    }
-    if (dict->next)
-        free_proto_dict(dict->next);
-    free(dict);
+
+void free_proto_list(struct ProtoList *list) {
+    assert(list->source);
+    if (list->source->mapping)
+        munmap(list->source->mapping, list->source->mapping_size);
+    arena_free(list->source->arena);
 }
 
 static void _print_level(int level) {
@@ -456,10 +549,10 @@ void debug_print_proto_node(struct ProtoNode *node, int level) {
     switch (node->type) {
         case PNT_num:
         case PNT_str:
-            printf("%s\n", node->raw_data);
+            printf("%.*s\n", PROTO_TOKEN_ARG(node->raw));
             break;
         case PNT_obj:
-            printf("%s:\n", node->object.name);
+            printf("%.*s:\n", PROTO_TOKEN_ARG(node->object.name));
 
             _print_level(level + 1);
             printf("Args:\n");
@@ -481,22 +574,17 @@ void debug_print_proto_node(struct ProtoNode *node, int level) {
     }
 }
 void debug_print_proto_dict(const struct ProtoDict *dict, int level) {
-    for (int i = 0; i < PROTO_LIST_SEGMENT_SIZE && dict->keys[i]; i++) {
+    for (uint32_t i = 0; i < dict->size; i++) {
         _print_level(level);
         printf("Key:\n");
-        debug_print_proto_node(dict->keys[i], level + 1);
+        debug_print_proto_node(dict->entries[i].key, level + 1);
         _print_level(level);
         printf("Value:\n");
-        debug_print_proto_node(dict->values[i], level + 1);
+        debug_print_proto_node(dict->entries[i].value, level + 1);
     }
-    if (dict->next)
-        debug_print_proto_dict(dict->next, level);
 }
 void debug_print_proto_list(const struct ProtoList *list, int level) {
-    for (int i = 0; i < PROTO_LIST_SEGMENT_SIZE && list->contents[i]; i++) {
+    for (uint32_t i = 0; i < list->size; i++) {
         debug_print_proto_node(list->contents[i], level);
     }
-
-    if (list->next)
-        debug_print_proto_list(list->next, level);
 }
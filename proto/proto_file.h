@@ -50,37 +50,80 @@ features.
   Single line comments are supported, and begin with `#`
 
 --------------------------------------------------------------
+
+ Memory:
+  Everything parse_proto_file returns lives in a single arena, released
+  all at once by free_proto_list on the root list. Lists and dicts are
+  sized exactly.
+
+  Names, numbers and strings are not copied at all, they are ProtoTokens
+  pointing straight into the text of the file. Only strings with escapes
+  in them get an unescaped copy (stored once, however often it appears).
+  load_proto_file maps the file rather than reading it, so the text is
+  shared between every process that loads the same schema.
 */
-#define PROTO_LIST_SEGMENT_SIZE 64
 #include <packet_node.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "arena.h"
 #include "constants.h"
+#include "xxhash.h"
 #define MAX_PROTO_OBJ_SIZE MAX_STRING_CONST_SIZE
 
 
 enum ProtoNodeType { PNT_UNKNOWN = 0, PNT_num, PNT_str, PNT_obj };
 enum NumberVariety { NV_INVALID, NV_INT, NV_FLOAT };
 
+// Text of a token. NOT null terminated, print with "%.*s" and PROTO_TOKEN_ARG
+struct ProtoToken {
+    const char *data;
+    uint32_t size;
+};
+#define PROTO_TOKEN_ARG(TOKEN) (int) (TOKEN).size, (TOKEN).data
+
+static __always_inline bool proto_token_eq(struct ProtoToken token, const char *str) {
+    return strlen(str) == token.size && 0 == memcmp(token.data, str, token.size);
+}
+
+// Null terminated copy of a token, free() it when done
+static __always_inline char *proto_token_dup(struct ProtoToken token) { return strndup(token.data, token.size); }
+
+// What a parsed tree needs kept alive, see free_proto_list
+struct ProtoSource {
+    // Every list, dict, node, and unescaped string
+    struct Arena *arena;
+
+    // The file tokens point into, if it was mapped by load_proto_file.
+    // Otherwise the caller of parse_proto_file owns the text.
+    void *mapping;
+    size_t mapping_size;
+
+    // proto_text_hash of the text
+    uint64_t hash;
+};
+
 struct ProtoList {
-    struct ProtoNode *contents[PROTO_LIST_SEGMENT_SIZE];
+    // Only set on the root list
+    struct ProtoSource *source;
 
-    // Null unless size > PROTO_LIST_SEGMENT_SIZE
-    struct ProtoList *next;
+    uint32_t size;
+    struct ProtoNode *contents[];
 };
-struct ProtoDict {
-    struct ProtoNode *keys[PROTO_LIST_SEGMENT_SIZE];
-    struct ProtoNode *values[PROTO_LIST_SEGMENT_SIZE];
 
-    // Null unless size > PROTO_LIST_SEGMENT_SIZE
-    struct ProtoDict *next;
+struct ProtoDictEntry {
+    struct ProtoNode *key;
+    struct ProtoNode *value;
+};
+struct ProtoDict {
+    uint32_t size;
+    struct ProtoDictEntry entries[];
 };
 
 struct ProtoObject {
-    char name[MAX_PROTO_OBJ_SIZE];
+    struct ProtoToken name;
     uint64_t name_hash;
 
     struct ProtoList *arguments; // Never null
@@ -98,26 +141,42 @@ struct ResultingNumber {
 };
 
 // A proto node can NEVER contain Lists or Dicts, as these cannot be on their
-// own
+// own. Nums and strs are only allocated up to the end of their union.
 struct ProtoNode {
     enum ProtoNodeType type;
     union {
         struct {
-            char raw_data[512]; // Used in num and str
+            // Used in num and str, as written in the file (without the quotes)
+            struct ProtoToken raw;
 
             union {
                 struct ResultingNumber parsed_number;
-                char *escaped_string;
+                struct ProtoToken escaped; // Same as raw if nothing was escaped
             };
         };
         struct ProtoObject object; // Used in PNT_obj
     };
 };
 
+// Exits on syntax errors. Tokens point into str, so it must outlive the tree.
 struct ProtoList *parse_proto_file(const char *str);
-void free_proto_node(struct ProtoNode *node);
+// Maps a .proto file into memory and parses it, the mapping belongs to the tree.
+// Returns: NULL if the file cannot be read (and sets error state), exits on syntax errors
+struct ProtoList *load_proto_file(const char *path);
+// Maps a file read only, with a null terminator right after its contents. munmap it when done.
+// Returns: NULL if the file cannot be read (and sets error state)
+char *map_proto_text(const char *path, size_t *mapping_size);
+
+// Identifies the text of a proto file, like for telling whether something made from it is stale
+static __always_inline uint64_t proto_text_hash(const char *text) { return XXH64(text, strlen(text), 0); }
+
+// Frees the tree parse_proto_file (or load_proto_file) returned, every node of it. Only for the root list.
 void free_proto_list(struct ProtoList *list);
-void free_proto_dict(struct ProtoDict *dict);
+
+// Element of a list, NULL past the end
+static __always_inline struct ProtoNode *proto_list_get(const struct ProtoList *list, uint32_t index) {
+    return index < list->size ? list->contents[index] : NULL;
+}
 
 void debug_print_proto_dict(const struct ProtoDict *dict, int level);
 void debug_print_proto_list(const struct ProtoList *list, int level);
@@ -134,33 +193,23 @@ static __always_inline void assert_proto_node_object_name(struct ProtoNode *node
         fprintf(stderr, "Needed a proto node object of name \"%s\", got type %d\n", name, node->type);
         exit(2);
     }
-    if (0 != strcmp(node->object.name, name)) {
-        fprintf(stderr, "Needed a proto node object of name \"%s\", got \"%s\"\n", name, node->object.name);
+    if (!proto_token_eq(node->object.name, name)) {
+        fprintf(stderr, "Needed a proto node object of name \"%s\", got \"%.*s\"\n", name, PROTO_TOKEN_ARG(node->object.name));
         exit(2);
     }
 }
 static __always_inline struct ProtoNode *get_argument_of_type(struct ProtoNode *node, int index, enum ProtoNodeType type) {
     assert_proto_node_type(node, PNT_obj);
-    struct ProtoList *arguments = node->object.arguments;
-    while (index > PROTO_LIST_SEGMENT_SIZE) {
-        arguments = arguments->next;
-        if (arguments == NULL) {
-            debug_print_proto_node(node, 0);
-            fprintf(stderr, "Error: Proto node does not have enough arguments\n");
-            exit(2);
-        }
-        index -= PROTO_LIST_SEGMENT_SIZE;
-    }
-    struct ProtoNode *arg = arguments->contents[index];
+    struct ProtoNode *arg = proto_list_get(node->object.arguments, index);
     if (arg == NULL) {
         debug_print_proto_node(node, 0);
-        fprintf(stderr, "Error: Proto node of name \"%s\" does not have enough arguments\n", node->object.name);
+        fprintf(stderr, "Error: Proto node of name \"%.*s\" does not have enough arguments\n", PROTO_TOKEN_ARG(node->object.name));
         exit(2);
     }
     if (arg->type != type) {
         debug_print_proto_node(node, 0);
-        fprintf(stderr, "Error: Proto node of name \"%s\" has incorrect type at index %d, needed: %d, got: %d \n", node->object.name, index,
-                type, arg->type);
+        fprintf(stderr, "Error: Proto node of name \"%.*s\" has incorrect type at index %d, needed: %d, got: %d \n",
+                PROTO_TOKEN_ARG(node->object.name), index, type, arg->type);
         exit(2);
     }
     return arg;
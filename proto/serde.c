@@ -1,236 +1,674 @@
 #include "serde.h"
 
 #include <endian.h>
-#include <errno.h>
+#include <stdbool.h>
 
 #include "constants.h"
 #include "datatypes.h"
 #include "error_handling.h"
+#include "framing.h"
 #include "packet_node.h"
 
-#define MAX_PACKET_NESTING 32
-
-// Returns: non zero for error(must set error state on error)
-// unpacks and sets value of items onto the head
-static int deserialize_item(struct ProtoNode *item, PacketNode *head, PacketNode **parents, int depth, const char **buffer,
-                            const char *maxBuffer) {
-    if (item->type != PNT_obj) {
-        SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "Packets definitions cannot contain anything other than objects, got of type: %d",
-                        item->type);
-        return -1;
+// Endianness does not affect single bytes
+#define be8toh(B) (B)
+#define htobe8(B) (B)
+
+// Shared by the decoders below, which all have buffer, max_buffer and op
+#define _READ_VAR_STYLE(OUT, BITS)                                                                                                         \
+    {                                                                                                                                      \
+        uint64_t _value;                                                                                                                   \
+        enum DecodeError _error = decode_var_style(buffer, max_buffer, BITS, &_value);                                                     \
+        if (__builtin_expect(_error, 0)) {                                                                                                 \
+            SET_DECODE_ERROR(_error, plan_op_name(op), *buffer, 0, 0);                                                                     \
+            return -1;                                                                                                                     \
+        }                                                                                                                                  \
+        OUT = _value;                                                                                                                      \
     }
-    struct ProtoNode *datatype_name = item->object.arguments->contents[0];
 
-#define _FORCE_NAME()                                                                                                                      \
-    if (datatype_name == NULL || datatype_name->type != PNT_str) {                                                                         \
-        SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT,                                                                                       \
-                        "Packet datatypes MUST have their first argument be an identifiable name! Found in %s", item->object.name);        \
+int _deserialize_value(const struct PlanOp *op, const char **buffer, const char *max_buffer, union __PacketNodeData *value) {
+#define _MEM_ERROR_CHECK(NEEDED)                                                                                                           \
+    if ((size_t) (max_buffer - *buffer) < (size_t) (NEEDED)) {                                                                             \
+        SET_DECODE_ERROR(DECODE_ERROR_TRUNCATED, plan_op_name(op), *buffer, 0, 0);                                                         \
         return -1;                                                                                                                         \
     }
 
-    char *name = NULL;
-    uint64_t name_hash = 0;
-    if (datatype_name != NULL && datatype_name->type == PNT_str) {
-        name = datatype_name->raw_data;
-        name_hash = PN_str_hash(name);
+#define _CASE_PRIMITIVE(OPCODE, BITS, ELEMENT_NAME)                                                                                        \
+    case OPCODE: {                                                                                                                         \
+        _MEM_ERROR_CHECK(BITS / 8);                                                                                                        \
+        uint##BITS##_t raw;                                                                                                                \
+        memcpy(&raw, *buffer, BITS / 8);                                                                                                   \
+        *buffer += BITS / 8;                                                                                                               \
+        value->ELEMENT_NAME = be##BITS##toh(raw);                                                                                          \
+        return 0;                                                                                                                          \
+    }
+    switch (op->opcode) {
+        _CASE_PRIMITIVE(PO_BOOLEAN, 8, boolean)
+        _CASE_PRIMITIVE(PO_BYTE, 8, byte_)
+        _CASE_PRIMITIVE(PO_UBYTE, 8, Ubyte_)
+        _CASE_PRIMITIVE(PO_SHORT, 16, short_)
+        _CASE_PRIMITIVE(PO_USHORT, 16, Ushort_)
+        _CASE_PRIMITIVE(PO_INT, 32, int_)
+        _CASE_PRIMITIVE(PO_UINT, 32, Uint_)
+        _CASE_PRIMITIVE(PO_LONG, 64, long_)
+        _CASE_PRIMITIVE(PO_ULONG, 64, Ulong_)
+        case PO_UUID: {
+            _MEM_ERROR_CHECK(128 / 8);
+            uint64_t uuid_p1, uuid_p2;
+            memcpy(&uuid_p1, *buffer, 64 / 8);
+            memcpy(&uuid_p2, *buffer + 64 / 8, 64 / 8);
+            *buffer += 128 / 8;
+
+            // Most significant half comes first
+            value->uuid = (struct MC_uuid) {.uuid_high = be64toh(uuid_p1), .uuid_low = be64toh(uuid_p2)};
+            return 0;
+        }
+        case PO_VARINT: {
+            uint32_t val;
+            _READ_VAR_STYLE(val, 32);
+            value->varint = val;
+            return 0;
+        }
+        case PO_VARLONG: {
+            uint64_t val;
+            _READ_VAR_STYLE(val, 64);
+            value->varlong = val;
+            return 0;
+        }
+        default:
+            SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "Plan opcode %d is not a single value", op->opcode);
+            return -1;
     }
+#undef _CASE_PRIMITIVE
+#undef _MEM_ERROR_CHECK
+}
 
-#define _MEM_ERROR_CHECK(ADD_TO_BUFF, NAME)                                                                                                \
-    if (*buffer + (ADD_TO_BUFF) >= maxBuffer) {                                                                                            \
-        SET_ERROR_STATE(ERROR_INVALID_PACKET, "Size is too small for " NAME "\n");                                                         \
+int _deserialize_op(const struct PlanOp *op, int slot, PacketNode *head, PacketNode **parents, int depth, const char **buffer,
+                    const char *max_buffer, const struct DecodeOptions *options) {
+#define _MEM_ERROR_CHECK(NEEDED)                                                                                                           \
+    if ((size_t) (max_buffer - *buffer) < (size_t) (NEEDED)) {                                                                             \
+        SET_DECODE_ERROR(DECODE_ERROR_TRUNCATED, plan_op_name(op), *buffer, 0, 0);                                                         \
         return -1;                                                                                                                         \
     }
 
-
-// Endianness does not affect single bytes
-#define be8toh(B) (B)
-#define _CASE_PRIMITIVE(BITS, NAME, HASH)                                                                                                  \
-    case HASH: {                                                                                                                           \
-        _FORCE_NAME();                                                                                                                     \
-        _MEM_ERROR_CHECK(BITS / 8, #NAME);                                                                                                 \
-        _PNB_set_with_hash_##NAME(head, name, name_hash, be##BITS##toh(*(uint##BITS##_t *) (*buffer)));                                    \
-        *buffer += (BITS / 8);                                                                                                             \
-        break;                                                                                                                             \
-    }
-    switch (item->object.name_hash) {
-        _CASE_PRIMITIVE(8, boolean, OBJ_boolean)
-        _CASE_PRIMITIVE(8, byte, OBJ_byte)
-        _CASE_PRIMITIVE(8, ubyte, OBJ_Ubyte)
-        _CASE_PRIMITIVE(16, short, OBJ_short)
-        _CASE_PRIMITIVE(16, ushort, OBJ_Ushort)
-        _CASE_PRIMITIVE(32, int, OBJ_int)
-        _CASE_PRIMITIVE(32, uint, OBJ_Uint)
-        _CASE_PRIMITIVE(64, long, OBJ_long)
-        _CASE_PRIMITIVE(64, ulong, OBJ_Ulong)
-        case OBJ_uuid: {
-            _FORCE_NAME();
-            _MEM_ERROR_CHECK(128 / 8, "uuid");
-            uint64_t uuid_p1 = be64toh(*(uint64_t *) *buffer);
-            *buffer += 64 / 8;
-            uint64_t uuid_p2 = be64toh(*(uint64_t *) *buffer);
-            *buffer += 64 / 8;
-
-            _PNB_set_with_hash_uuid(head, name, name_hash, (struct MC_uuid) {.uuid_low = uuid_p1, .uuid_high = uuid_p2});
+    switch (op->opcode) {
+        case PO_BOOLEAN:
+        case PO_BYTE:
+        case PO_UBYTE:
+        case PO_SHORT:
+        case PO_USHORT:
+        case PO_INT:
+        case PO_UINT:
+        case PO_LONG:
+        case PO_ULONG:
+        case PO_UUID:
+        case PO_VARINT:
+        case PO_VARLONG: {
+            union __PacketNodeData value;
+            if (_deserialize_value(op, buffer, max_buffer, &value))
+                return -1;
+            size_t size = PN_value_size(op->node_type);
+            PacketNode *node = _plan_node(op, options->arena, size);
+            memcpy(node->__data, &value, size);
+            head->__data->bundle.fields[slot] = node;
             break;
         }
-        case OBJ_varint: {
-            _FORCE_NAME();
-            uint32_t val = (uint32_t) readVarStyle(buffer, maxBuffer, 32);
-            if (errno) {
-                SET_ERROR_STATE(ERROR_INVALID_PACKET, "Varint memory error");
+        case PO_STRING:
+        case PO_PREFIXED_BYTE_ARRAY:
+        case PO_REMAINING_BYTES: {
+            uint32_t size;
+            if (op->opcode == PO_REMAINING_BYTES) {
+                size = max_buffer - *buffer;
+            } else {
+                _READ_VAR_STYLE(size, 32);
+            }
+            if (op->max_length != PLAN_NO_MAX_LENGTH && size > op->max_length) {
+                SET_DECODE_ERROR(DECODE_ERROR_TOO_LONG, plan_op_name(op), *buffer, op->max_length, size);
                 return -1;
             }
-            _PNB_set_with_hash_varint(head, name, name_hash, val);
+            _MEM_ERROR_CHECK(size);
+
+            PacketNode *node = _plan_node(op, options->arena, sizeof(node->__data->view));
+            if (options->flags & DECODE_ZERO_COPY) {
+                node->flags |= PN_FLAG_VIEW;
+                node->__data->view = (struct PacketBufferView) {.data = *buffer, .size = size};
+            } else {
+                memcpy(_PN_new_contents_in(options->arena, node, size)->data, *buffer, size);
+            }
+            *buffer += size;
+            head->__data->bundle.fields[slot] = node;
             break;
         }
-        case OBJ_varlong: {
-            _FORCE_NAME();
-            uint64_t val = (uint64_t) readVarStyle(buffer, maxBuffer, 64);
-            if (errno) {
-                SET_ERROR_STATE(ERROR_INVALID_PACKET, "Varint memory error");
+        case PO_OPTIONAL:
+        case PO_OPTIONAL_BUNDLE: {
+            _MEM_ERROR_CHECK(1);
+            char is_present = **buffer;
+            (*buffer)++;
+
+            // Skip contents if non existent
+            if (!is_present)
+                break;
+
+            const struct DecodePlan *sub = plan_op_sub_plan(op);
+            if (op->opcode == PO_OPTIONAL)
+                // Shares same context
+                return _deserialize_op(sub->ops, slot, head, parents, depth, buffer, max_buffer, options);
+
+            parents[depth] = head;
+            PacketNode *contents = _deserialize_plan(parents, depth + 1, sub, buffer, max_buffer, options);
+            if (!contents)
                 return -1;
-            }
-            _PNB_set_with_hash_varlong(head, name, name_hash, val);
+            contents->full_hash = op->name_hash;
+            memcpy(contents->name, plan_op_name(op), op->name_len + 1);
+            head->__data->bundle.fields[slot] = contents;
             break;
         }
-        case OBJ_string: {
-            _FORCE_NAME();
-            uint32_t size = (uint32_t) readVarStyle(buffer, maxBuffer, 32);
-            if (errno) {
-                SET_ERROR_STATE(ERROR_INVALID_PACKET, "Varint memory error");
+        case PO_PREFIXED_ARRAY: {
+            uint32_t count;
+            _READ_VAR_STYLE(count, 32);
+            if (count > MAX_DECODED_LIST_SIZE) {
+                SET_DECODE_ERROR(DECODE_ERROR_TOO_MANY_ELEMENTS, plan_op_name(op), *buffer, count, MAX_DECODED_LIST_SIZE);
                 return -1;
             }
-            // Second string arg is for the length of the string
-            if (item->object.arguments->contents[1] != NULL) {
-                if (item->object.arguments->contents[1]->type != PNT_num) {
-                NOT_INT:
-                    SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "The string datatypes second argument CAN ONLY BE AND INT");
-                    return -1;
-                }
-                if (item->object.arguments->contents[1]->parsed_number.is_float)
-                    goto NOT_INT;
-                if (size > item->object.arguments->contents[1]->parsed_number.ll) {
-                    SET_ERROR_STATE(ERROR_INVALID_PACKET, "String of size max size %llu had size of %d",
-                                    item->object.arguments->contents[1]->parsed_number.ll, size);
+            PacketNode *list = _plan_list(op, options->arena, NT_LIST, _plan_list_capacity(count, *buffer, max_buffer));
+            const struct DecodePlan *sub = plan_op_sub_plan(op);
+
+            parents[depth] = head;
+            for (uint32_t i = 0; i < count; i++) {
+                PacketNode *element = _deserialize_plan(parents, depth + 1, sub, buffer, max_buffer, options);
+                if (!element) {
+                    PN_free(list);
                     return -1;
                 }
+                PN_list_append(list, element);
             }
-
-            struct PacketBufferContents *contents = malloc(1 + size + sizeof(struct PacketBufferContents));
-            contents->size = size;
-
-            _MEM_ERROR_CHECK(size, "string");
-
-            memcpy(contents->data, *buffer, size);
-            contents->data[size] = '\0';
-
-            *buffer += size;
-            _PNB_set_with_hash_string_raw(head, name, name_hash, contents);
+            head->__data->bundle.fields[slot] = list;
             break;
         }
-        case OBJ_prefixed_byte_array: {
-            _FORCE_NAME();
-            uint32_t size = (uint32_t) readVarStyle(buffer, maxBuffer, 32);
-            if (errno) {
-                SET_ERROR_STATE(ERROR_INVALID_PACKET, "Varint memory error");
+        case PO_PACKED_ARRAY: {
+            uint32_t count;
+            _READ_VAR_STYLE(count, 32);
+            if (count > MAX_DECODED_LIST_SIZE) {
+                SET_DECODE_ERROR(DECODE_ERROR_TOO_MANY_ELEMENTS, plan_op_name(op), *buffer, count, MAX_DECODED_LIST_SIZE);
                 return -1;
             }
-            struct PacketBufferContents *contents = malloc(size + sizeof(struct PacketBufferContents));
-            contents->size = size;
-
-            _MEM_ERROR_CHECK(size, "prefixed byte array");
-
-            memcpy(contents->data, *buffer, size);
-            *buffer += size;
-            _PNB_set_with_hash_byte_array_raw(head, name, name_hash, contents);
+            const struct PlanOp *element = plan_op_sub_plan(op)->ops;
+            PacketNode *list = _plan_list(op, options->arena, element->node_type, _plan_list_capacity(count, *buffer, max_buffer));
+            for (uint32_t i = 0; i < count; i++) {
+                union __PacketNodeData value;
+                if (_deserialize_value(element, buffer, max_buffer, &value)) {
+                    PN_free(list);
+                    return -1;
+                }
+                PN_packed_list_append(list, &value);
+            }
+            head->__data->bundle.fields[slot] = list;
             break;
         }
-        case OBJ_prefixed_optional: {
-            // Two modes exist for a prefixed option. As a modifier to a single
-            // data item, or as a container. The two are distinguished by using
-            // arguments vs an attached list
-            _MEM_ERROR_CHECK(1, "prefixed optional");
-            char is_present = **buffer;
-            (*buffer)++;
+        default:
+            SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "Unknown plan opcode: %d", op->opcode);
+            return -1;
+    }
+#undef _MEM_ERROR_CHECK
+    return 0;
+}
 
-            // Skip contents if non existent
-            if (!is_present)
-                break;
 
-            // If it has a list, assume it is a list style
-            if (item->object.attached_list) {
-                _FORCE_NAME();
+int _skip_op(const struct PlanOp *op, const char **buffer, const char *max_buffer, int depth) {
+#define _SKIP(SIZE)                                                                                                                        \
+    if ((size_t) (max_buffer - *buffer) < (size_t) (SIZE)) {                                                                               \
+        SET_DECODE_ERROR(DECODE_ERROR_TRUNCATED, plan_op_name(op), *buffer, 0, 0);                                                         \
+        return -1;                                                                                                                         \
+    }                                                                                                                                      \
+    *buffer += SIZE;
 
-                if (depth + 1 > MAX_PACKET_NESTING) {
-                    SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "Max depth reached!");
-                    return -1;
-                }
-                parents[depth] = head;
-                PacketNode *contents = _deserialize_packet(parents, depth + 1, item->object.attached_list, buffer, maxBuffer);
-                PN_rename(contents, name);
-                PNB_set(head, contents);
+    if (depth >= MAX_PACKET_NESTING) {
+        SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "Packet too deeply nested to continue. Please increase MAX_PACKET_NESTING");
+        return -1;
+    }
+    switch (op->opcode) {
+        case PO_BOOLEAN:
+        case PO_BYTE:
+        case PO_UBYTE:
+        case PO_SHORT:
+        case PO_USHORT:
+        case PO_INT:
+        case PO_UINT:
+        case PO_LONG:
+        case PO_ULONG:
+        case PO_UUID:
+            _SKIP(op->width);
+            return 0;
+        case PO_VARINT:
+        case PO_VARLONG: {
+            uint64_t ignored;
+            _READ_VAR_STYLE(ignored, op->opcode == PO_VARINT ? 32 : 64);
+            (void) ignored;
+            return 0;
+        }
+        case PO_STRING:
+        case PO_PREFIXED_BYTE_ARRAY:
+        case PO_REMAINING_BYTES: {
+            // Just the length prefix is read, and checked like the decoder does
+            uint32_t size;
+            if (op->opcode == PO_REMAINING_BYTES) {
+                size = max_buffer - *buffer;
             } else {
-                // Otherwise assume it is a singular object
-                struct ProtoNode *opt = item->object.arguments->contents[0];
-                if (NULL == opt || opt->type != PNT_obj) {
-                    SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT,
-                                    "prefixed_optional MUST, either have an attached list, or a singular object!");
+                _READ_VAR_STYLE(size, 32);
+            }
+            if (op->max_length != PLAN_NO_MAX_LENGTH && size > op->max_length) {
+                SET_DECODE_ERROR(DECODE_ERROR_TOO_LONG, plan_op_name(op), *buffer, op->max_length, size);
+                return -1;
+            }
+            _SKIP(size);
+            return 0;
+        }
+        case PO_OPTIONAL:
+        case PO_OPTIONAL_BUNDLE: {
+            _SKIP(1);
+            if (!(*buffer)[-1])
+                return 0;
+            const struct DecodePlan *sub = plan_op_sub_plan(op);
+            for (uint32_t i = 0; i < sub->op_count; i++) {
+                if (_skip_op(&sub->ops[i], buffer, max_buffer, depth + 1))
                     return -1;
+            }
+            return 0;
+        }
+        case PO_PREFIXED_ARRAY: {
+            uint32_t count;
+            _READ_VAR_STYLE(count, 32);
+            if (count > MAX_DECODED_LIST_SIZE) {
+                SET_DECODE_ERROR(DECODE_ERROR_TOO_MANY_ELEMENTS, plan_op_name(op), *buffer, count, MAX_DECODED_LIST_SIZE);
+                return -1;
+            }
+            const struct DecodePlan *sub = plan_op_sub_plan(op);
+            for (uint32_t element = 0; element < count; element++) {
+                for (uint32_t i = 0; i < sub->op_count; i++) {
+                    if (_skip_op(&sub->ops[i], buffer, max_buffer, depth + 1))
+                        return -1;
                 }
-                // Shares same context
-                if (deserialize_item(opt, head, parents, depth, buffer, maxBuffer))
-                    return -1;
             }
-
-            break;
+            return 0;
+        }
+        case PO_PACKED_ARRAY: {
+            uint32_t count;
+            _READ_VAR_STYLE(count, 32);
+            if (count > MAX_DECODED_LIST_SIZE) {
+                SET_DECODE_ERROR(DECODE_ERROR_TOO_MANY_ELEMENTS, plan_op_name(op), *buffer, count, MAX_DECODED_LIST_SIZE);
+                return -1;
+            }
+            const struct PlanOp *element = plan_op_sub_plan(op)->ops;
+            if (element->width) {
+                _SKIP((size_t) count * element->width);
+                return 0;
+            }
+            for (uint32_t i = 0; i < count; i++) {
+                uint64_t ignored;
+                _READ_VAR_STYLE(ignored, element->opcode == PO_VARINT ? 32 : 64);
+                (void) ignored;
+            }
+            return 0;
         }
         default:
-            SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "Unknown packet definition datatype: %s", item->object.name);
+            SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "Unknown plan opcode: %d", op->opcode);
             return -1;
     }
-    return 0;
+#undef _READ_VAR_STYLE
+#undef _SKIP
 }
 
+static __always_inline bool projection_has(const struct FieldProjection *projection, uint32_t slot) {
+    return slot < MAX_PROJECTION_FIELDS && (projection->fields[slot / 64] >> (slot % 64)) & 1;
+}
 
-PacketNode *_deserialize_packet(PacketNode **parents, int packet_deph, struct ProtoList *packets_def, const char **buffer,
-                                const char *max_buffer) {
+PacketNode *_deserialize_plan(PacketNode **parents, int packet_deph, const struct DecodePlan *plan, const char **buffer,
+                              const char *max_buffer, const struct DecodeOptions *options) {
     if (packet_deph >= MAX_PACKET_NESTING) {
         SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "Packet too deeply nested to continue. Please increase MAX_PACKET_NESTING");
         return NULL;
     }
-    PacketNode *head = PN_new_bundle();
+    PacketNode *head = PN_new_bundle_sized_in(options->arena, plan->op_count);
+
+    // Projections only apply to the fields of the packet itself
+    const struct FieldProjection *projection = packet_deph == 0 ? options->projection : NULL;
+    uint32_t op_count = projection ? (uint32_t) (projection->last + 1) : plan->op_count;
+
+    // Every op gets the slot of the same index, so fields can be found without
+    // searching, see PacketFieldHandle. Missing optionals leave theirs NULL.
+    head->__data->bundle.size = plan->op_count;
+    for (uint32_t i = 0; i < op_count; i++) {
+        int res;
+        if (projection && !projection_has(projection, i))
+            res = _skip_op(&plan->ops[i], buffer, max_buffer, packet_deph);
+        else
+            res = _deserialize_op(&plan->ops[i], i, head, parents, packet_deph, buffer, max_buffer, options);
+        if (res) {
+            PN_free(head);
+            return NULL;
+        }
+    }
 
+    return head;
+}
 
-PACKET_PARSE_LOOP:
-    for (int i = 0; i < PROTO_LIST_SEGMENT_SIZE && packets_def->contents[i]; i++) {
-        struct ProtoNode *element = packets_def->contents[i];
-        if (deserialize_item(element, head, parents, packet_deph, buffer, max_buffer))
-            return NULL;
+PacketNode *deserialize_packet(const struct PacketDeclaration *packet, const char *buffer, size_t size) {
+    return deserialize_packet_ex(packet, buffer, size, &(struct DecodeOptions) {0});
+}
 
+PacketNode *deserialize_packet_ex(const struct PacketDeclaration *packet, const char *buffer, size_t size,
+                                  const struct DecodeOptions *options) {
+    PacketNode *parents[MAX_PACKET_NESTING] = {0};
+    const char *max_buffer = buffer + size;
 
-        if (*buffer >= max_buffer) {
-            SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "Packet too short");
-            return NULL;
+    if (!packet->plan) {
+        SET_ERROR_STATE(ERROR_API_USAGE, "Packet declaration has not been compiled, use create_version_serde");
+        return NULL;
+    }
+
+    if (options->projection && options->projection->plan != packet->plan) {
+        SET_ERROR_STATE(ERROR_API_USAGE, "Projection was made for a different packet than \"%s\"", packet->name);
+        return NULL;
+    }
+
+    const char *start = buffer;
+    PacketNode *head = _deserialize_plan(parents, 0, packet->plan, &buffer, max_buffer, options);
+    if (head && !options->projection && buffer != max_buffer) {
+        SET_DECODE_ERROR(DECODE_ERROR_TRAILING_BYTES, NULL, buffer, max_buffer - buffer, 0);
+        PN_free(head);
+        head = NULL;
+    }
+    if (!head)
+        set_decode_error_origin(start);
+    return head;
+}
+
+
+void field_projection_init(struct FieldProjection *projection, const struct PacketDeclaration *packet) {
+    memset(projection, 0, sizeof(struct FieldProjection));
+    projection->plan = packet->plan;
+    projection->last = -1;
+}
+
+int field_projection_add_handle(struct FieldProjection *projection, PacketFieldHandle handle) {
+    if (handle.slot < 0 || (uint32_t) handle.slot >= projection->plan->op_count) {
+        SET_ERROR_STATE(ERROR_API_USAGE, "Field handle with slot %d is not part of the packet", handle.slot);
+        return -1;
+    }
+    if (handle.slot >= MAX_PROJECTION_FIELDS) {
+        SET_ERROR_STATE(ERROR_API_USAGE, "Only the first %d fields of a packet can be projected", MAX_PROJECTION_FIELDS);
+        return -1;
+    }
+    projection->fields[handle.slot / 64] |= 1ULL << (handle.slot % 64);
+    if (handle.slot > projection->last)
+        projection->last = handle.slot;
+    return 0;
+}
+
+int field_projection_add(struct FieldProjection *projection, const char *name) {
+    PacketFieldHandle handle = plan_field_handle(projection->plan, name);
+    if (handle.slot < 0)
+        return -1;
+    return field_projection_add_handle(projection, handle);
+}
+
+
+// Field of a bundle for an op, NULL if missing. Hand built bundles are not in plan
+// order, PNB_fget falls back to searching those by name.
+static __always_inline PacketNode *op_field(PacketNode *bundle, const struct PlanOp *op, int slot) {
+    return PNB_fget(bundle, (PacketFieldHandle) {.slot = slot, .name_hash = op->name_hash});
+}
+
+static int64_t plan_encoded_size(const struct DecodePlan *plan, PacketNode *bundle, int depth);
+
+// Bytes a single value op takes up on the wire
+static __always_inline int64_t value_encoded_size(const struct PlanOp *op, const union __PacketNodeData *value) {
+    if (op->opcode == PO_VARINT)
+        return varStyleSize((uint32_t) value->varint);
+    if (op->opcode == PO_VARLONG)
+        return varStyleSize((uint64_t) value->varlong);
+    return op->width;
+}
+
+// Returns: bytes the field takes up on the wire, or -1 on error (and sets error state)
+// Everything the write pass relies on is checked here.
+static int64_t op_encoded_size(const struct PlanOp *op, PacketNode *field, int depth) {
+    if (!field) {
+        SET_ERROR_STATE(ERROR_API_USAGE, "Missing field \"%s\"", plan_op_name(op));
+        return -1;
+    }
+    if (field->type != op->node_type) {
+        SET_ERROR_STATE(ERROR_API_USAGE, "Field \"%s\" has type %d, expected %d", plan_op_name(op), field->type, op->node_type);
+        return -1;
+    }
+
+    switch (op->opcode) {
+        case PO_BOOLEAN:
+        case PO_BYTE:
+        case PO_UBYTE:
+        case PO_SHORT:
+        case PO_USHORT:
+        case PO_INT:
+        case PO_UINT:
+        case PO_LONG:
+        case PO_ULONG:
+        case PO_UUID:
+        case PO_VARINT:
+        case PO_VARLONG:
+            return value_encoded_size(op, field->__data);
+        case PO_STRING:
+        case PO_PREFIXED_BYTE_ARRAY:
+        case PO_REMAINING_BYTES: {
+            size_t size;
+            PN_get_bytes(field, &size);
+            if (op->max_length != PLAN_NO_MAX_LENGTH && size > (size_t) op->max_length) {
+                SET_ERROR_STATE(ERROR_API_USAGE, "\"%s\" of max size %lld had size of %zu", plan_op_name(op), (long long) op->max_length,
+                                size);
+                return -1;
+            }
+            if (op->opcode == PO_REMAINING_BYTES)
+                return size;
+            return varStyleSize(size) + size;
+        }
+        case PO_OPTIONAL: {
+            // Present, the wrapped op shares the same field
+            int64_t size = op_encoded_size(plan_op_sub_plan(op)->ops, field, depth);
+            return size < 0 ? -1 : 1 + size;
+        }
+        case PO_OPTIONAL_BUNDLE: {
+            int64_t size = plan_encoded_size(plan_op_sub_plan(op), field, depth + 1);
+            return size < 0 ? -1 : 1 + size;
+        }
+        case PO_PREFIXED_ARRAY: {
+            const struct DecodePlan *sub = plan_op_sub_plan(op);
+            if (PN_list_is_packed(field)) {
+                SET_ERROR_STATE(ERROR_API_USAGE, "Field \"%s\" is an array of bundles, not a packed list", plan_op_name(op));
+                return -1;
+            }
+            int64_t size = varStyleSize(field->list_size);
+            for (int i = 0; i < field->list_size; i++) {
+                int64_t element = plan_encoded_size(sub, PN_list_get(field, i), depth + 1);
+                if (element < 0)
+                    return -1;
+                size += element;
+            }
+            return size;
+        }
+        case PO_PACKED_ARRAY: {
+            const struct PlanOp *element = plan_op_sub_plan(op)->ops;
+            if (field->__data->list.element_type != element->node_type) {
+                SET_ERROR_STATE(ERROR_API_USAGE, "Field \"%s\" must be a packed list of type %d", plan_op_name(op), element->node_type);
+                return -1;
+            }
+            int64_t size = varStyleSize(field->list_size);
+            if (element->width)
+                return size + (int64_t) field->list_size * element->width;
+            for (int i = 0; i < field->list_size; i++) {
+                union __PacketNodeData value = _PNL_value(field, i);
+                size += value_encoded_size(element, &value);
+            }
+            return size;
         }
+        default:
+            SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "Unknown plan opcode: %d", op->opcode);
+            return -1;
+    }
+}
+
+static int64_t plan_encoded_size(const struct DecodePlan *plan, PacketNode *bundle, int depth) {
+    if (depth >= MAX_PACKET_NESTING) {
+        SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "Packet too deeply nested to continue. Please increase MAX_PACKET_NESTING");
+        return -1;
+    }
+    if (!bundle || bundle->type != NT_BUNDLE) {
+        SET_ERROR_STATE(ERROR_API_USAGE, "Expected a bundle to encode");
+        return -1;
     }
-    if (packets_def->next) {
-        packets_def = packets_def->next;
-        goto PACKET_PARSE_LOOP;
+    int64_t size = 0;
+    for (uint32_t i = 0; i < plan->op_count; i++) {
+        const struct PlanOp *op = &plan->ops[i];
+        int64_t field_size;
+        if (op->opcode == PO_OPTIONAL || op->opcode == PO_OPTIONAL_BUNDLE) {
+            PacketNode *field = op_field(bundle, op, i);
+            field_size = field ? op_encoded_size(op, field, depth) : 1;
+        } else {
+            field_size = op_encoded_size(op, op_field(bundle, op, i), depth);
+        }
+        if (field_size < 0)
+            return -1;
+        size += field_size;
     }
+    return size;
+}
 
+static char *write_plan(const struct DecodePlan *plan, PacketNode *bundle, char *out);
 
-    return head;
+// Writes a single value op
+static __always_inline char *write_value(const struct PlanOp *op, const union __PacketNodeData *value, char *out) {
+#define _CASE_PRIMITIVE(OPCODE, BITS, ELEMENT_NAME)                                                                                        \
+    case OPCODE: {                                                                                                                         \
+        uint##BITS##_t raw = htobe##BITS(value->ELEMENT_NAME);                                                                             \
+        memcpy(out, &raw, BITS / 8);                                                                                                       \
+        return out + BITS / 8;                                                                                                             \
+    }
+    switch (op->opcode) {
+        _CASE_PRIMITIVE(PO_BOOLEAN, 8, boolean)
+        _CASE_PRIMITIVE(PO_BYTE, 8, byte_)
+        _CASE_PRIMITIVE(PO_UBYTE, 8, Ubyte_)
+        _CASE_PRIMITIVE(PO_SHORT, 16, short_)
+        _CASE_PRIMITIVE(PO_USHORT, 16, Ushort_)
+        _CASE_PRIMITIVE(PO_INT, 32, int_)
+        _CASE_PRIMITIVE(PO_UINT, 32, Uint_)
+        _CASE_PRIMITIVE(PO_LONG, 64, long_)
+        _CASE_PRIMITIVE(PO_ULONG, 64, Ulong_)
+        case PO_UUID: {
+            uint64_t halves[2] = {htobe64(value->uuid.uuid_high), htobe64(value->uuid.uuid_low)};
+            memcpy(out, halves, sizeof(halves));
+            return out + sizeof(halves);
+        }
+        case PO_VARINT:
+            return putVarStyleWide(out, (uint32_t) value->varint);
+        case PO_VARLONG:
+            return putVarStyleWide(out, (uint64_t) value->varlong);
+    }
+#undef _CASE_PRIMITIVE
+    return out;
 }
 
-PacketNode *deserialize_packet(struct ProtoList *packets_def, const char *buffer, size_t size) {
-    PacketNode *parents[MAX_PACKET_NESTING] = {0};
+// Only ever called after op_encoded_size said yes, so nothing is checked twice.
+// There is always room for a wide varint store past out, see serialize_packet.
+static char *write_op(const struct PlanOp *op, PacketNode *field, char *out) {
+    switch (op->opcode) {
+        case PO_BOOLEAN:
+        case PO_BYTE:
+        case PO_UBYTE:
+        case PO_SHORT:
+        case PO_USHORT:
+        case PO_INT:
+        case PO_UINT:
+        case PO_LONG:
+        case PO_ULONG:
+        case PO_UUID:
+        case PO_VARINT:
+        case PO_VARLONG:
+            return write_value(op, field->__data, out);
+        case PO_STRING:
+        case PO_PREFIXED_BYTE_ARRAY:
+        case PO_REMAINING_BYTES: {
+            size_t size;
+            const char *data = PN_get_bytes(field, &size);
+            if (op->opcode != PO_REMAINING_BYTES)
+                out = putVarStyleWide(out, size);
+            memcpy(out, data, size);
+            return out + size;
+        }
+        case PO_OPTIONAL:
+            *(out++) = 1;
+            return write_op(plan_op_sub_plan(op)->ops, field, out);
+        case PO_OPTIONAL_BUNDLE:
+            *(out++) = 1;
+            return write_plan(plan_op_sub_plan(op), field, out);
+        case PO_PREFIXED_ARRAY: {
+            const struct DecodePlan *sub = plan_op_sub_plan(op);
+            out = putVarStyleWide(out, field->list_size);
+            for (int i = 0; i < field->list_size; i++)
+                out = write_plan(sub, PN_list_get(field, i), out);
+            return out;
+        }
+        case PO_PACKED_ARRAY: {
+            const struct PlanOp *element = plan_op_sub_plan(op)->ops;
+            out = putVarStyleWide(out, field->list_size);
+            for (int i = 0; i < field->list_size; i++) {
+                union __PacketNodeData value = _PNL_value(field, i);
+                out = write_value(element, &value, out);
+            }
+            return out;
+        }
+    }
+    return out;
+}
 
-    return _deserialize_packet(parents, 0, packets_def, &buffer, buffer + size);
+static char *write_plan(const struct DecodePlan *plan, PacketNode *bundle, char *out) {
+    for (uint32_t i = 0; i < plan->op_count; i++) {
+        const struct PlanOp *op = &plan->ops[i];
+        PacketNode *field = op_field(bundle, op, i);
+        if (field)
+            out = write_op(op, field, out);
+        else
+            *(out++) = 0; // Absent optional
+    }
+    return out;
+}
+
+struct CombinedDataSegment *serialize_packet(const struct PacketDeclaration *packet, PacketNode *bundle) {
+    if (!packet->plan) {
+        SET_ERROR_STATE(ERROR_API_USAGE, "Packet declaration has not been compiled, use create_version_serde");
+        return NULL;
+    }
+    int64_t fields_size = plan_encoded_size(packet->plan, bundle, 0);
+    if (fields_size < 0)
+        return NULL;
+
+    size_t body_size = varStyleSize(packet->id) + fields_size;
+    if (body_size > MAX_FRAME_SIZE) {
+        SET_ERROR_STATE(ERROR_API_USAGE, "Packet \"%s\" does not fit in a frame: %zu", packet->name, body_size);
+        return NULL;
+    }
+    size_t size = varStyleSize(body_size) + body_size;
+
+    // Slack at the end, so every varint can be a single wide store
+    struct CombinedDataSegment *combined = malloc(sizeof(struct CombinedDataSegment) + size + sizeof(uint64_t));
+    combined->size = size;
+    char *out = putVarStyleWide(combined->data, body_size);
+    out = putVarStyleWide(out, packet->id);
+    out = write_plan(packet->plan, bundle, out);
+    assert(out == combined->data + size);
+
+    return combined;
 }
 
 
 NameSpaceSerde *get_namespace(VersionSerde *version, const char *name) {
-    for (int i = 0; i < MAX_NAMESPACES && version->namespaces[i]->name; i++) {
+    for (int i = 0; i < MAX_NAMESPACES && version->namespaces[i]; i++) {
         if (strcmp(version->namespaces[i]->name, name) == 0) {
             return version->namespaces[i];
         }
@@ -244,7 +682,7 @@ static char process_namespace_version_info(struct ProtoNode *key, struct ProtoNo
         SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "Expected string, got %d", key->type);
         exit_on_error();
     }
-    if (0 == strcmp(key->raw_data, "protocol_number")) {
+    if (proto_token_eq(key->escaped, "protocol_number")) {
         if (value->parsed_number.is_float) {
             SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "Protocol number must be a int");
             exit_on_error();
@@ -252,7 +690,7 @@ static char process_namespace_version_info(struct ProtoNode *key, struct ProtoNo
         state->protocol_number = value->parsed_number.ll;
         printf("Protocol number: %llu\n", value->parsed_number.ll);
     } else {
-        SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "Unexpected version info entry: %s", key->raw_data);
+        SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "Unexpected version info entry: %.*s", PROTO_TOKEN_ARG(key->escaped));
         exit_on_error();
     }
     return 0;
@@ -275,7 +713,8 @@ static char process_packet_declaration(struct ProtoNode *node, NameSpaceSerde *n
                         id->parsed_number.ll);
         exit_on_error();
     }
-    namespace->packets[id->parsed_number.ll].name = id->raw_data;
+    namespace->packets[id->parsed_number.ll].name = proto_token_dup(name->escaped);
+    namespace->packets[id->parsed_number.ll].id = id->parsed_number.ll;
     namespace->packets[id->parsed_number.ll].definition = node->object.attached_list;
 
     return 0;
@@ -290,16 +729,25 @@ static char process_enum_registration(struct ProtoNode *key, struct ProtoNode *v
         SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "Enum values must be declared using the enum(){INT : STRING} format!!");
         exit_on_error();
     }
-    uint64_t hash = PN_str_hash(key->escaped_string);
+    uint64_t hash = PN_str_hash_n(key->escaped.data, key->escaped.size);
     struct EnumRegistryEntry **write_too = &vserde->enum_registry[hash % ENUM_REGISTRY_SIZE];
     while (*write_too) {
         if ((*write_too)->name_hash == hash) {
-            SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "Duplicate enum contents in registry! %s", key->escaped_string);
+            SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "Duplicate enum contents in registry! %.*s", PROTO_TOKEN_ARG(key->escaped));
             exit_on_error();
         }
         write_too = &((*write_too)->next);
     }
+    if (!value->object.attached_dict) {
+        SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "Enum \"%.*s\" has no values", PROTO_TOKEN_ARG(key->escaped));
+        exit_on_error();
+    }
 
+    struct EnumRegistryEntry *entry = calloc(1, sizeof(struct EnumRegistryEntry));
+    entry->name = proto_token_dup(key->escaped);
+    entry->name_hash = hash;
+    entry->table = compile_enum_table(&vserde->plans, value);
+    *write_too = entry;
 
     return 0;
 }
@@ -316,13 +764,13 @@ static char process_proto_global_object(struct ProtoNode *node, struct GlobalObj
         NameSpaceSerde *namespace = calloc(sizeof(NameSpaceSerde), 1);
         struct ProtoNode *name = get_argument_of_type(node, 0, PNT_str);
 
-        int len = strlen(name->raw_data);
+        size_t len = name->escaped.size;
 
         if (len >= sizeof(namespace->name)) {
             SET_ERROR_STATE(ERROR_INVALID_PACKET_FORMAT, "Namespace too long");
             exit_on_error();
         }
-        memcpy(namespace->name, name->raw_data, len);
+        memcpy(namespace->name, name->escaped.data, len);
         proto_list_foreach(node->object.attached_list, (ListCallback) process_packet_declaration, (void **) namespace);
         state->version->namespaces[state->current_ns++] = namespace;
     }
@@ -330,15 +778,46 @@ static char process_proto_global_object(struct ProtoNode *node, struct GlobalObj
     return 0;
 }
 
-VersionSerde *create_version_serde(const char *proto_file_contents) {
+static VersionSerde *compile_version_serde(struct ProtoList *file) {
     VersionSerde *version = calloc(1, sizeof(VersionSerde));
-    version->master_proto_file = parse_proto_file(proto_file_contents);
+    version->master_proto_file = file;
+    version->source_hash = file->source->hash;
     proto_list_foreach(version->master_proto_file, (ListCallback) process_proto_global_object,
                        (void **) &((struct GlobalObjState) {
                                .version = version,
                                .current_ns = 0,
                        }));
 
+    // varint("name", enum("...")) gets its values from the registry
+    version->plans.enums = version->enum_registry;
+
+    // Plans can only be pointed to once the blob has stopped moving around
+    size_t *plan_offsets = calloc(MAX_NAMESPACES * 256, sizeof(size_t));
+    for (int ns = 0; ns < MAX_NAMESPACES && version->namespaces[ns]; ns++) {
+        for (int id = 0; id < 256; id++) {
+            struct PacketDeclaration *packet = &version->namespaces[ns]->packets[id];
+            if (packet->definition)
+                plan_offsets[ns * 256 + id] = compile_decode_plan(&version->plans, packet->definition);
+        }
+    }
+    finish_decode_plan_blob(&version->plans);
+    for (int ns = 0; ns < MAX_NAMESPACES && version->namespaces[ns]; ns++) {
+        for (int id = 0; id < 256; id++) {
+            struct PacketDeclaration *packet = &version->namespaces[ns]->packets[id];
+            if (packet->definition)
+                packet->plan = (const struct DecodePlan *) (version->plans.data + plan_offsets[ns * 256 + id]);
+        }
+    }
+    free(plan_offsets);
 
     return version;
 }
+
+VersionSerde *create_version_serde(const char *proto_file_contents) { return compile_version_serde(parse_proto_file(proto_file_contents)); }
+
+VersionSerde *load_version_serde(const char *path) {
+    struct ProtoList *file = load_proto_file(path);
+    if (!file)
+        return NULL;
+    return compile_version_serde(file);
+}
@@ -1,33 +1,112 @@
 #pragma once
 #include <stdint.h>
 #include "packet_node.h"
+#include "packet_plan.h"
 #include "proto_file.h"
 
-#define ENUM_REGISTRY_SIZE 1024
-
 struct PacketDeclaration {
     const char *name;
-    struct ProtoList *definition;
+    int id;
+    struct ProtoList *definition; // NULL when read from a cache, see version_cache.h
+
+    // Compiled form of definition, points into VersionSerde.plans
+    const struct DecodePlan *plan;
+};
+
+enum DecodeFlags {
+    // Strings and byte arrays become views into the buffer (see PN_FLAG_VIEW)
+    // instead of copies. The buffer must then outlive the tree, unless
+    // PN_materialize_tree is used on it.
+    DECODE_ZERO_COPY = 1 << 0,
 };
 
-struct EnumRegistryEntry {
-    char *name;
-    uint64_t name_hash;
+// Most top level fields a projection can pick from
+#define MAX_PROJECTION_FIELDS 256
+
+// A subset of the top level fields of a packet, see DecodeOptions.projection
+struct FieldProjection {
+    const struct DecodePlan *plan;
+    // A bit per op (slot) of plan
+    uint64_t fields[MAX_PROJECTION_FIELDS / 64];
+    // Highest selected slot, -1 if there are none
+    int last;
+};
+
+struct DecodeOptions {
+    int flags; // enum DecodeFlags
+
+    // If set, every node (and string) of the packet is allocated from here.
+    // The tree is then released with arena_reset, instead of PN_free.
+    struct Arena *arena;
 
-    // Hashmaps need this
-    struct EnumRegistryEntry *next;
+    // If set, only these fields are decoded. The others are skipped over
+    // without allocating anything, and their slot is left NULL. Decoding stops
+    // after the last selected field, so the rest of the packet is not checked.
+    const struct FieldProjection *projection;
 };
 
+// Starts out with no fields selected
+void field_projection_init(struct FieldProjection *projection, const struct PacketDeclaration *packet);
+// Returns: non zero if the field is not part of the packet, and sets error state
+int field_projection_add(struct FieldProjection *projection, const char *name);
+int field_projection_add_handle(struct FieldProjection *projection, PacketFieldHandle handle);
 
 // Assumes that you provide the correct packet deffinition,
 // the entire packet is presant, uncompressed, and unencrypted
 // see: error_handling.h for what null means
-PacketNode *deserialize_packet(struct ProtoList *packets_def, const char *buffer, size_t size);
+PacketNode *deserialize_packet(const struct PacketDeclaration *packet, const char *buffer, size_t size);
 
+// Same as deserialize_packet, with control over how the tree is built
+PacketNode *deserialize_packet_ex(const struct PacketDeclaration *packet, const char *buffer, size_t size,
+                                  const struct DecodeOptions *options);
+
+
+// Opposite of deserialize_packet. Encodes a bundle (decoded, or built with
+// PNB_set) into a full uncompressed frame: length prefix, packet id, fields.
+// The exact size is worked out first, so it is a single allocation, free() it when done.
+// Absent optionals are written as not present, any other missing field is an error.
+// see: error_handling.h for what null means
+struct CombinedDataSegment *serialize_packet(const struct PacketDeclaration *packet, PacketNode *bundle);
+
+// Creates an unattached node, named after the op that produced it
+static __always_inline PacketNode *_plan_node(const struct PlanOp *op, struct Arena *arena, size_t data_size) {
+    PacketNode *node = _PN_alloc_in(arena, data_size);
+    node->type = op->node_type;
+    node->full_hash = op->name_hash;
+    memcpy(node->name, plan_op_name(op), op->name_len + 1);
+    return node;
+}
+
+// Same as _plan_node, for a list with room for capacity elements. element_type is NT_LIST for lists of bundles.
+static __always_inline PacketNode *_plan_list(const struct PlanOp *op, struct Arena *arena, enum NodeType element_type, int capacity) {
+    PacketNode *list = _plan_node(op, arena, _PNL_data_size(_PNL_element_size(element_type), capacity));
+    return _PNL_init(list, arena, element_type, capacity);
+}
+
+// How many elements to make room for up front. Every element takes at least a
+// byte, so a bogus count can't make it reserve more than the packet has left.
+static __always_inline int _plan_list_capacity(uint32_t count, const char *buffer, const char *max_buffer) {
+    size_t left = max_buffer - buffer;
+    return count < left ? count : left;
+}
+
+// Returns: non zero for error(must set error state on error)
+// Reads a single value op (fixed width primitives, varints and varlongs). Only
+// the member of value matching op->node_type is set.
+int _deserialize_value(const struct PlanOp *op, const char **buffer, const char *max_buffer, union __PacketNodeData *value);
+
+// Returns: non zero for error(must set error state on error)
+// unpacks and sets value of items onto the head, at the given slot
+int _deserialize_op(const struct PlanOp *op, int slot, PacketNode *head, PacketNode **parents, int depth, const char **buffer,
+                    const char *max_buffer, const struct DecodeOptions *options);
+
+// Returns: non zero for error(must set error state on error)
+// Moves the buffer past a field, without decoding any of it
+int _skip_op(const struct PlanOp *op, const char **buffer, const char *max_buffer, int depth);
 
 // Simular to deserialize_packet, but allowing for multiple layers down
-PacketNode *_deserialize_packet(PacketNode **parents, int packet_deph, struct ProtoList *packets_def, const char **buffer,
-                                const char *max_buffer);
+PacketNode *_deserialize_plan(PacketNode **parents, int packet_deph, const struct DecodePlan *plan, const char **buffer,
+                              const char *max_buffer, const struct DecodeOptions *options);
 
 typedef struct {
     char name[64];
@@ -39,7 +118,9 @@ typedef struct {
 #define MAX_NAMESPACES 16
 typedef struct {
     int protocol_number;
-    struct ProtoList *master_proto_file;
+    struct ProtoList *master_proto_file; // NULL when read from a cache
+    // proto_text_hash of the proto file this was made from
+    uint64_t source_hash;
 
     // With the small amount of namespaces, it makes no sense to make them a hashmap
     // so just strcmp them!
@@ -49,11 +130,29 @@ typedef struct {
     // in the proto file.
     struct EnumRegistryEntry *enum_registry[ENUM_REGISTRY_SIZE];
 
+    // Every compiled packet definition
+    struct DecodePlanBlob plans;
+
+    // When read from a cache, the mapping of it that plans (and names) point into
+    void *cache;
+    size_t cache_size;
+
 } VersionSerde;
 
-// On error will exit the program. It can only fail if the proto file is malformed
+// On error will exit the program. It can only fail if the proto file is malformed.
+// The version keeps pointing into proto_file_contents, so it must not be freed.
 VersionSerde *create_version_serde(const char *proto_file_contents);
 
+// Same as create_version_serde, but maps the file at path instead of needing it read in
+// Returns: NULL if the file cannot be read (and sets error state)
+VersionSerde *load_version_serde(const char *path);
+
 
 // Returns NULL if not found, and sets error state
 NameSpaceSerde *get_namespace(VersionSerde *version, const char *name);
+
+// Resolves a top level field of a packet once, so it can be looked up
+// with PNB_fget (and PNB_fget_*) rather than by name.
+static inline PacketFieldHandle packet_field_handle(const struct PacketDeclaration *packet, const char *name) {
+    return plan_field_handle(packet->plan, name);
+}
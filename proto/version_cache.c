@@ -0,0 +1,267 @@
+#include "version_cache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "error_handling.h"
+
+#define CACHE_BYTE_ORDER 0x0102
+
+static size_t align8(size_t offset) { return (offset + 7) & ~(size_t) 7; }
+
+// Everything the file is made of, in order
+struct CacheLayout {
+    uint32_t namespace_count;
+    uint32_t enum_count;
+    size_t namespaces, enums, plans, strings, strings_size, size;
+};
+
+static struct CacheLayout cache_layout(const VersionSerde *version) {
+    struct CacheLayout layout = {0};
+    while (layout.namespace_count < MAX_NAMESPACES && version->namespaces[layout.namespace_count]) {
+        const NameSpaceSerde *namespace = version->namespaces[layout.namespace_count++];
+        for (int id = 0; id < 256; id++) {
+            if (namespace->packets[id].plan)
+                layout.strings_size += strlen(namespace->packets[id].name) + 1;
+        }
+    }
+    for (int i = 0; i < ENUM_REGISTRY_SIZE; i++) {
+        for (const struct EnumRegistryEntry *entry = version->enum_registry[i]; entry; entry = entry->next) {
+            layout.enum_count++;
+            layout.strings_size += strlen(entry->name) + 1;
+        }
+    }
+    layout.namespaces = sizeof(struct VersionCacheHeader);
+    layout.enums = layout.namespaces + layout.namespace_count * sizeof(struct VersionCacheNamespace);
+    layout.plans = align8(layout.enums + layout.enum_count * sizeof(struct VersionCacheEnum));
+    layout.strings = layout.plans + version->plans.size;
+    layout.size = layout.strings + layout.strings_size;
+    return layout;
+}
+
+// Returns: the offset of the copy inside of the strings
+static uint32_t cache_string(char *strings, size_t *used, const char *str) {
+    size_t len = strlen(str) + 1;
+    memcpy(strings + *used, str, len);
+    *used += len;
+    return *used - len;
+}
+
+int write_version_cache(const VersionSerde *version, const char *path) {
+    struct CacheLayout layout = cache_layout(version);
+    if (layout.strings_size > UINT32_MAX) {
+        SET_ERROR_STATE(ERROR_API_USAGE, "Version has too many names to be cached");
+        return -1;
+    }
+    char *file = calloc(1, layout.size);
+    struct VersionCacheHeader *header = (struct VersionCacheHeader *) file;
+    memcpy(header->magic, VERSION_CACHE_MAGIC, sizeof(header->magic));
+    header->format = VERSION_CACHE_FORMAT;
+    header->plan_op_size = sizeof(struct PlanOp);
+    header->byte_order = CACHE_BYTE_ORDER;
+    header->source_hash = version->source_hash;
+    header->size = layout.size;
+    header->protocol_number = version->protocol_number;
+    header->namespace_count = layout.namespace_count;
+    header->enum_count = layout.enum_count;
+    header->namespaces = layout.namespaces;
+    header->enums = layout.enums;
+    header->plans = layout.plans;
+    header->plans_size = version->plans.size;
+    header->strings = layout.strings;
+    header->strings_size = layout.strings_size;
+
+    char *strings = file + layout.strings;
+    size_t strings_used = 0;
+    struct VersionCacheNamespace *namespaces = (struct VersionCacheNamespace *) (file + layout.namespaces);
+    for (uint32_t ns = 0; ns < layout.namespace_count; ns++) {
+        const NameSpaceSerde *namespace = version->namespaces[ns];
+        memcpy(namespaces[ns].name, namespace->name, sizeof(namespaces[ns].name));
+        for (int id = 0; id < 256; id++) {
+            const struct PacketDeclaration *packet = &namespace->packets[id];
+            if (!packet->plan)
+                continue;
+            namespaces[ns].packets[id].name = cache_string(strings, &strings_used, packet->name) + 1;
+            namespaces[ns].packets[id].id = packet->id;
+            namespaces[ns].packets[id].plan = (const char *) packet->plan - version->plans.data;
+        }
+    }
+    struct VersionCacheEnum *enums = (struct VersionCacheEnum *) (file + layout.enums);
+    for (int i = 0; i < ENUM_REGISTRY_SIZE; i++) {
+        for (const struct EnumRegistryEntry *entry = version->enum_registry[i]; entry; entry = entry->next, enums++) {
+            enums->name_hash = entry->name_hash;
+            enums->table = entry->table;
+            enums->name = cache_string(strings, &strings_used, entry->name);
+        }
+    }
+    if (version->plans.size)
+        memcpy(file + layout.plans, version->plans.data, version->plans.size);
+
+    // Written next to the old cache and renamed over it, so a reader never
+    // sees half a file, and a crash leaves the old one behind
+    size_t path_len = strlen(path);
+    char *tmp_path = malloc(path_len + 32);
+    snprintf(tmp_path, path_len + 32, "%s.%d.tmp", path, (int) getpid());
+
+    int res = -1;
+    FILE *out = fopen(tmp_path, "wb");
+    if (!out) {
+        SET_ERROR_STATE(ERROR_API_USAGE, "Cannot create %s: %s", tmp_path, strerror(errno));
+    } else if (fwrite(file, 1, layout.size, out) != layout.size || fclose(out) != 0) {
+        SET_ERROR_STATE(ERROR_API_USAGE, "Cannot write %s: %s", tmp_path, strerror(errno));
+        unlink(tmp_path);
+    } else if (rename(tmp_path, path) != 0) {
+        SET_ERROR_STATE(ERROR_API_USAGE, "Cannot replace %s: %s", path, strerror(errno));
+        unlink(tmp_path);
+    } else {
+        res = 0;
+    }
+    free(tmp_path);
+    free(file);
+    return res;
+}
+
+// Returns: non zero if the header does not describe a cache this build can use for source_hash, and sets error state
+static int check_cache_header(const struct VersionCacheHeader *header, size_t file_size, uint64_t source_hash, const char *path) {
+#define _RANGE_OK(OFFSET, SIZE) ((OFFSET) <= file_size && (SIZE) <= file_size - (OFFSET))
+    if (memcmp(header->magic, VERSION_CACHE_MAGIC, sizeof(header->magic)) != 0) {
+        SET_ERROR_STATE(ERROR_API_USAGE, "%s is not a version cache", path);
+        return -1;
+    }
+    if (header->format != VERSION_CACHE_FORMAT || header->plan_op_size != sizeof(struct PlanOp) || header->byte_order != CACHE_BYTE_ORDER) {
+        SET_ERROR_STATE(ERROR_API_USAGE, "%s was written by an incompatible build", path);
+        return -1;
+    }
+    if (header->source_hash != source_hash) {
+        SET_ERROR_STATE(ERROR_API_USAGE, "%s is out of date", path);
+        return -1;
+    }
+    if (header->size != file_size || header->namespace_count > MAX_NAMESPACES || header->plans % 8 ||
+        !_RANGE_OK(header->namespaces, header->namespace_count * sizeof(struct VersionCacheNamespace)) ||
+        !_RANGE_OK(header->enums, header->enum_count * (uint64_t) sizeof(struct VersionCacheEnum)) ||
+        !_RANGE_OK(header->plans, header->plans_size) || !_RANGE_OK(header->strings, header->strings_size) ||
+        header->strings_size > UINT32_MAX ||
+        (header->strings_size && ((const char *) header)[header->strings + header->strings_size - 1])) {
+        SET_ERROR_STATE(ERROR_API_USAGE, "%s is truncated or corrupt", path);
+        return -1;
+    }
+    return 0;
+#undef _RANGE_OK
+}
+
+// Undoes everything read_version_cache set up, for when part of the cache turns out to be bad
+static void drop_version_cache(VersionSerde *version) {
+    for (int ns = 0; ns < MAX_NAMESPACES; ns++)
+        free(version->namespaces[ns]);
+    for (int i = 0; i < ENUM_REGISTRY_SIZE; i++) {
+        struct EnumRegistryEntry *entry = version->enum_registry[i];
+        while (entry) {
+            struct EnumRegistryEntry *next = entry->next;
+            free(entry);
+            entry = next;
+        }
+    }
+    munmap(version->cache, version->cache_size);
+    free(version);
+}
+
+VersionSerde *read_version_cache(const char *path, uint64_t source_hash) {
+    int fd = open(path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        SET_ERROR_STATE(ERROR_API_USAGE, "Cannot read %s: %s", path, strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        return NULL;
+    }
+    if ((size_t) info.st_size < sizeof(struct VersionCacheHeader)) {
+        SET_ERROR_STATE(ERROR_API_USAGE, "%s is truncated or corrupt", path);
+        close(fd);
+        return NULL;
+    }
+    char *mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        SET_ERROR_STATE(ERROR_API_USAGE, "Cannot map %s: %s", path, strerror(errno));
+        return NULL;
+    }
+    const struct VersionCacheHeader *header = (const struct VersionCacheHeader *) mapping;
+    if (check_cache_header(header, info.st_size, source_hash, path)) {
+        munmap(mapping, info.st_size);
+        return NULL;
+    }
+
+    VersionSerde *version = calloc(1, sizeof(VersionSerde));
+    version->cache = mapping;
+    version->cache_size = info.st_size;
+    version->protocol_number = header->protocol_number;
+    version->source_hash = header->source_hash;
+    // Read only, and never grown or freed by the blob itself
+    version->plans.data = mapping + header->plans;
+    version->plans.size = header->plans_size;
+
+    const char *strings = mapping + header->strings;
+    const struct VersionCacheNamespace *namespaces = (const struct VersionCacheNamespace *) (mapping + header->namespaces);
+    for (uint32_t ns = 0; ns < header->namespace_count; ns++) {
+        NameSpaceSerde *namespace = calloc(1, sizeof(NameSpaceSerde));
+        version->namespaces[ns] = namespace;
+        if (!memchr(namespaces[ns].name, 0, sizeof(namespaces[ns].name)))
+            goto corrupt;
+        memcpy(namespace->name, namespaces[ns].name, sizeof(namespace->name));
+        for (int id = 0; id < 256; id++) {
+            const struct VersionCachePacket *cached = &namespaces[ns].packets[id];
+            if (!cached->name)
+                continue;
+            if (cached->name - 1 >= header->strings_size || cached->plan + sizeof(struct DecodePlan) > header->plans_size)
+                goto corrupt;
+            namespace->packets[id].name = strings + cached->name - 1;
+            namespace->packets[id].id = cached->id;
+            namespace->packets[id].plan = (const struct DecodePlan *) (version->plans.data + cached->plan);
+        }
+    }
+    const struct VersionCacheEnum *enums = (const struct VersionCacheEnum *) (mapping + header->enums);
+    for (uint32_t i = 0; i < header->enum_count; i++) {
+        if (enums[i].name >= header->strings_size || enums[i].table >= header->plans_size)
+            goto corrupt;
+        struct EnumRegistryEntry *entry = calloc(1, sizeof(struct EnumRegistryEntry));
+        entry->name = strings + enums[i].name;
+        entry->name_hash = enums[i].name_hash;
+        entry->table = enums[i].table;
+        struct EnumRegistryEntry **write_too = &version->enum_registry[entry->name_hash % ENUM_REGISTRY_SIZE];
+        entry->next = *write_too;
+        *write_too = entry;
+    }
+    return version;
+
+corrupt:
+    SET_ERROR_STATE(ERROR_API_USAGE, "%s is truncated or corrupt", path);
+    drop_version_cache(version);
+    return NULL;
+}
+
+VersionSerde *load_version_serde_cached(const char *proto_path, const char *cache_path) {
+    size_t mapping_size;
+    char *text = map_proto_text(proto_path, &mapping_size);
+    if (!text)
+        return NULL;
+    uint64_t hash = proto_text_hash(text);
+    munmap(text, mapping_size);
+
+    VersionSerde *version = read_version_cache(cache_path, hash);
+    if (version)
+        return version;
+    RESET_ERROR_STATE();
+
+    // The proto file is mapped again rather than reusing the text hashed above,
+    // the cache gets the hash of whatever was actually compiled
+    version = load_version_serde(proto_path);
+    if (!version)
+        return NULL;
+    if (write_version_cache(version, cache_path))
+        RESET_ERROR_STATE();
+    return version;
+}
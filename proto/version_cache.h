@@ -0,0 +1,76 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "serde.h"
+
+/*
+  Binary cache of a compiled VersionSerde: its namespaces, packet plans, and
+  enum tables, but not the parsed proto file. Plans are already position
+  independent (see packet_plan.h), so the plan blob is written out as is,
+  and read back by mapping the file. Nothing is parsed or compiled, and the
+  read only pages are shared by every process using the same cache.
+
+  A cache remembers the proto_text_hash of the proto file it was made from,
+  and is only used for that exact text. It is also tied to the build that
+  wrote it (the layout of PlanOps, and byte order), anything else is
+  rejected and rebuilt. Past those checks a cache is trusted just like the
+  proto file itself.
+*/
+
+#define VERSION_CACHE_MAGIC "MCVCACHE"
+// Bump whenever the layout of the file, or of anything in the plan blob, changes
+#define VERSION_CACHE_FORMAT 1
+
+struct VersionCacheHeader {
+    char magic[8];
+    uint32_t format;
+    uint16_t plan_op_size; // sizeof(struct PlanOp)
+    uint16_t byte_order;   // 0x0102 in the byte order of the writer
+    uint64_t source_hash;
+    uint64_t size; // Of the whole file, catches truncated writes
+
+    int32_t protocol_number;
+    uint32_t namespace_count;
+    uint32_t enum_count;
+    uint32_t _pad;
+
+    // Offsets into the file
+    uint64_t namespaces; // namespace_count of struct VersionCacheNamespace
+    uint64_t enums;      // enum_count of struct VersionCacheEnum
+    uint64_t plans;      // Plan blob, plans_size bytes
+    uint64_t plans_size;
+    uint64_t strings; // Null terminated names, strings_size bytes
+    uint64_t strings_size;
+};
+
+struct VersionCachePacket {
+    uint32_t name; // Offset into strings, plus one. 0 if there is no packet with this id.
+    int32_t id;
+    uint64_t plan; // Offset into plans
+};
+
+struct VersionCacheNamespace {
+    char name[64];
+    struct VersionCachePacket packets[256];
+};
+
+struct VersionCacheEnum {
+    uint64_t name_hash;
+    uint64_t table; // Offset into plans
+    uint32_t name;  // Offset into strings
+    uint32_t _pad;
+};
+
+// Writes a version out, replacing whatever was at path in one go.
+// Returns: non zero on error, and sets error state
+int write_version_cache(const VersionSerde *version, const char *path);
+
+// Maps a cache, as long as it was made from the proto text with the given proto_text_hash.
+// Returns: NULL if there is no usable cache at path, and sets error state saying why
+VersionSerde *read_version_cache(const char *path, uint64_t source_hash);
+
+// Reads the cache at cache_path if it is for the current contents of proto_path,
+// otherwise loads proto_path and (re)writes the cache. Failing to write the
+// cache is not an error, the version is still returned.
+// Returns: NULL if proto_path cannot be read (and sets error state), exits if it is malformed
+VersionSerde *load_version_serde_cached(const char *proto_path, const char *cache_path);